@@ -0,0 +1,158 @@
+/*
+ * File:   Capture.cpp
+ * Capture of received datagrams and JACK events into a binary file for offline replay
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Capture.h"
+
+CCapture::CCapture (void)
+{
+    File=0;
+    NumQueues=0;
+    Written=0;
+    memset (&Lost[0], 0, sizeof(Lost));
+    memset (&Queues[0], 0, sizeof(Queues));
+}  // CCapture::CCapture
+//-----------------------------------------------------------------------------
+
+CCapture::~CCapture (void)
+{
+    Close();
+}  // CCapture::~CCapture
+//-----------------------------------------------------------------------------
+
+bool CCapture::Open (const char* FileName, unsigned int NumProducers, uint32_t SampleRate, unsigned int NumSessions, const uint16_t* ControlPorts)
+{
+    TCaptureFileHeader Header;
+    unsigned int QueueNum;
+
+    if (File) return false;
+    if ((NumProducers==0)||(NumProducers>CAPTURE_MAX_PRODUCERS)) return false;
+
+    File=fopen (FileName, "wb");
+    if (File==0)
+    {
+        fprintf (stderr, "jackrtpmidid : can not create capture file %s\n", FileName);
+        return false;
+    }
+
+    memset (&Header, 0, sizeof(Header));
+    Header.Magic=CAPTURE_MAGIC;
+    Header.Version=CAPTURE_VERSION;
+    Header.SampleRate=SampleRate;
+    Header.NumSessions=(NumSessions>CAPTURE_MAX_SESSIONS) ? CAPTURE_MAX_SESSIONS : NumSessions;
+    memcpy (&Header.ControlPorts[0], ControlPorts, Header.NumSessions*sizeof(uint16_t));
+    fwrite (&Header, sizeof(Header), 1, File);
+
+    NumQueues=NumProducers;
+    for (QueueNum=0; QueueNum<NumQueues; QueueNum++)
+        Queues[QueueNum] = new CMIDIEventQueue (CAPTURE_QUEUE_SIZE);
+    Written=0;
+    memset (&Lost[0], 0, sizeof(Lost));
+    return true;
+}  // CCapture::Open
+//-----------------------------------------------------------------------------
+
+void CCapture::Close (void)
+{
+    unsigned int QueueNum;
+    uint64_t TotalLost=0;
+
+    if (File==0) return;
+
+    Drain();
+    for (QueueNum=0; QueueNum<NumQueues; QueueNum++)
+    {
+        TotalLost+=Lost[QueueNum];
+        delete Queues[QueueNum];
+        Queues[QueueNum]=0;
+    }
+    NumQueues=0;
+    fclose (File);
+    File=0;
+
+    printf ("Capture : %llu records written, %llu lost\n", (unsigned long long)Written, (unsigned long long)TotalLost);
+}  // CCapture::Close
+//-----------------------------------------------------------------------------
+
+void CCapture::Record (unsigned int Producer, uint8_t Type, uint8_t Source, uint32_t FrameTime, const struct timespec* Kernel, const unsigned char* Data, unsigned int Size)
+{
+    TMIDIEventHeader* Event;
+    int64_t KernelNanos=0;
+
+    if (Producer>=NumQueues) return;
+
+    // Queue record : header time and flags carry the frame time and the type, data start with the kernel time
+    Event=Queues[Producer]->Reserve (sizeof(int64_t)+Size);
+    if (Event==0)
+    {
+        Lost[Producer]++;
+        return;
+    }
+    if (Kernel) KernelNanos=(int64_t)Kernel->tv_sec*1000000000LL+Kernel->tv_nsec;
+    Event->Time=FrameTime;
+    Event->Source=Source;
+    Event->Flags=Type;
+    memcpy (CMIDIEventQueue::EventData(Event), &KernelNanos, sizeof(int64_t));
+    memcpy (CMIDIEventQueue::EventData(Event)+sizeof(int64_t), Data, Size);
+    Queues[Producer]->Commit();
+}  // CCapture::Record
+//-----------------------------------------------------------------------------
+
+unsigned int CCapture::Drain (void)
+{
+    TMIDIEventHeader* Event;
+    TCaptureRecord Record;
+    unsigned int QueueNum;
+    unsigned int Count=0;
+
+    if (File==0) return 0;
+
+    for (QueueNum=0; QueueNum<NumQueues; QueueNum++)
+    {
+        while ((Event=Queues[QueueNum]->Peek())!=0)
+        {
+            memcpy (&Record.KernelNanos, CMIDIEventQueue::EventData(Event), sizeof(int64_t));
+            Record.FrameTime=Event->Time;
+            Record.Size=Event->Size-sizeof(int64_t);
+            Record.Type=Event->Flags;
+            Record.Source=Event->Source;
+            fwrite (&Record, sizeof(Record), 1, File);
+            fwrite (CMIDIEventQueue::EventData(Event)+sizeof(int64_t), Record.Size, 1, File);
+            Queues[QueueNum]->Pop();
+            Count++;
+        }
+    }
+    if (Count>0) fflush (File);
+    Written+=Count;
+    return Count;
+}  // CCapture::Drain
+//-----------------------------------------------------------------------------
@@ -0,0 +1,112 @@
+/*
+ * File:   Capture.h
+ * Capture of received datagrams and JACK events into a binary file for offline replay
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ The realtime threads store the records in one event queue per producer (one per worker and one
+ for jack_process) : nothing is written to the file by the realtime threads. A writer thread
+ drains the queues and appends the records to the file. Records are lost (and counted) when a
+ queue is full.
+
+ File format (host byte order) : a TCaptureFileHeader followed by records. Each record is a
+ TCaptureRecord followed by Size bytes (raw datagram or MIDI bytes of a JACK event).
+ Records of different producers are not sorted : tools/jackrtpmidireplay.cpp sorts them by
+ frame time before replaying the datagrams
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "MIDIEventQueue.h"
+
+#define CAPTURE_MAGIC           0x434D524A          // 'JRMC'
+#define CAPTURE_VERSION         1
+#define CAPTURE_MAX_SESSIONS    32
+
+// Size of the queue of each producer (bytes)
+#define CAPTURE_QUEUE_SIZE      (1<<20)
+
+// Largest producer number + 1 (workers + jack_process)
+#define CAPTURE_MAX_PRODUCERS   16
+
+// Record types
+#define CAPTURE_RX_DATAGRAM     1                   // Datagram read on the data socket of a session (Source = session)
+#define CAPTURE_JACK_OUT        2                   // Event written to JACK output ports by jack_process (Source = session)
+#define CAPTURE_JACK_IN         3                   // Event read from a JACK input port (Source = port in routing matrix)
+
+typedef struct {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t SampleRate;
+    uint32_t NumSessions;
+    uint16_t ControlPorts[CAPTURE_MAX_SESSIONS];    // Control port of each session when capture started
+} TCaptureFileHeader;
+
+typedef struct {
+    int64_t KernelNanos;                            // Kernel receive time (CLOCK_REALTIME), 0 if not known
+    uint32_t FrameTime;                             // JACK frame time of the datagram arrival or of the event
+    uint16_t Size;                                  // Bytes following the record
+    uint8_t Type;
+    uint8_t Source;
+} TCaptureRecord;
+
+class CCapture
+{
+public:
+    CCapture (void);
+    ~CCapture (void);
+
+    // Creates the file and the queues of NumProducers producers
+    bool Open (const char* FileName, unsigned int NumProducers, uint32_t SampleRate, unsigned int NumSessions, const uint16_t* ControlPorts);
+
+    // Writes what is left in the queues and closes the file (producers must be stopped)
+    void Close (void);
+
+    // --- Producer side (one thread per producer) ---
+
+    // Stores one record. Kernel can be 0 when the kernel time is not known
+    void Record (unsigned int Producer, uint8_t Type, uint8_t Source, uint32_t FrameTime, const struct timespec* Kernel, const unsigned char* Data, unsigned int Size);
+
+    // --- Writer thread ---
+
+    // Appends the records waiting in all queues to the file. Returns the number of records written
+    unsigned int Drain (void);
+
+    uint64_t Written;                               // Records written to the file (writer thread)
+    uint64_t Lost[CAPTURE_MAX_PRODUCERS];           // Records lost because a queue was full (producer)
+
+private:
+    FILE* File;
+    unsigned int NumQueues;
+    CMIDIEventQueue* Queues[CAPTURE_MAX_PRODUCERS];
+};
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * File:   ClockModel.cpp
+ * Model of the clock of a remote RTP-MIDI peer, built from its clock synchronization exchanges
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "ClockModel.h"
+#include "RTPMIDIPacket.h"
+
+#define NO_RTT          0xFFFFFFFF
+
+// Gains of the filter : part of the error at an exchange applied to the offset and to the rate
+#define OFFSET_GAIN     0.5
+#define RATE_GAIN       0.25
+
+static uint32_t ReadBE32 (const unsigned char* Data)
+{
+    return ((uint32_t)Data[0]<<24)|((uint32_t)Data[1]<<16)|((uint32_t)Data[2]<<8)|Data[3];
+}  // ReadBE32
+//-----------------------------------------------------------------------------
+
+static uint64_t ReadBE64 (const unsigned char* Data)
+{
+    return ((uint64_t)ReadBE32 (Data)<<32)|ReadBE32 (Data+4);
+}  // ReadBE64
+//-----------------------------------------------------------------------------
+
+CClockModel::CClockModel (void)
+{
+    Configure (48000);
+}  // CClockModel::CClockModel
+//-----------------------------------------------------------------------------
+
+void CClockModel::Configure (unsigned int Rate)
+{
+    if (Rate!=0) SampleRate=Rate;
+    Exchanges=0;
+    Rejected=0;
+    PeerSSRC=0;
+    Reset();
+}  // CClockModel::Configure
+//-----------------------------------------------------------------------------
+
+void CClockModel::Reset (void)
+{
+    unsigned int Index;
+
+    Synced=false;
+    CK0Pending=false;
+    ReplyDone=false;
+    CK0Time=0;
+    CK0Arrival=0;
+    ReplyFrame=0;
+    LastLocal=0;
+    Local64=0;
+    RefPeerTicks=0;
+    RefLocal=0;
+    Ratio=1.0;
+    SyncError=0;
+    RoundTrip=0;
+    for (Index=0; Index<CLOCK_RTT_HISTORY; Index++) RTTHistory[Index]=NO_RTT;
+    RTTIndex=0;
+    MinRTT=NO_RTT;
+}  // CClockModel::Reset
+//-----------------------------------------------------------------------------
+
+bool CClockModel::ProcessCK (const unsigned char* Packet, uint32_t ArrivalFrame)
+{
+    uint32_t SSRC;
+    uint64_t T1;
+    uint64_t T3;
+    uint64_t PeerRTT;
+    int32_t Turnaround;
+    int64_t RTT;
+
+    SSRC=ReadBE32 (&Packet[4]);
+    if (SSRC!=PeerSSRC)
+    {  // Another peer (or the same one restarted) : its clock is unknown
+        Reset();
+        PeerSSRC=SSRC;
+    }
+
+    T1=ReadBE64 (&Packet[12]);
+    switch (Packet[8])
+    {
+        case 0 :
+            CK0Pending=true;
+            ReplyDone=false;
+            CK0Time=T1;
+            CK0Arrival=ArrivalFrame;
+            return false;
+        case 2 :
+            if ((CK0Pending==false)||(T1!=CK0Time)) return false;
+            CK0Pending=false;
+            T3=ReadBE64 (&Packet[28]);
+
+            // Round trip seen by the peer includes the time we took to answer
+            PeerRTT=T3-T1;
+            if (PeerRTT>RTP_TIMESTAMP_RATE) return false;
+            Turnaround=ReplyDone ? (int32_t)(ReplyFrame-CK0Arrival) : 0;
+            if (Turnaround<0) Turnaround=0;
+            RTT=(int64_t)((PeerRTT*SampleRate)/RTP_TIMESTAMP_RATE)-Turnaround;
+            if (RTT<0) RTT=0;
+
+            AddExchange (T3, ArrivalFrame, (uint32_t)RTT);
+            return true;
+        default :
+            // CK1 only comes back when we initiate the exchange, which the RTP-MIDI handler never does as a listener
+            return false;
+    }
+}  // CClockModel::ProcessCK
+//-----------------------------------------------------------------------------
+
+void CClockModel::HandlerDone (uint32_t Frame)
+{
+    if ((CK0Pending)&&(ReplyDone==false))
+    {
+        ReplyFrame=Frame;
+        ReplyDone=true;
+    }
+}  // CClockModel::HandlerDone
+//-----------------------------------------------------------------------------
+
+void CClockModel::AddExchange (uint64_t PeerT3, uint32_t ArrivalFrame, uint32_t RTT)
+{
+    unsigned int Index;
+    double Local;
+    double Elapsed;
+    double Predicted;
+    double Error;
+    uint32_t Margin;
+
+    // Arrival times are unwrapped from the 32 bits JACK clock
+    if (Synced==false) Local64=ArrivalFrame;
+    else Local64+=(int32_t)(ArrivalFrame-LastLocal);
+    LastLocal=ArrivalFrame;
+
+    RTTHistory[RTTIndex]=RTT;
+    RTTIndex=(RTTIndex+1)%CLOCK_RTT_HISTORY;
+    MinRTT=NO_RTT;
+    for (Index=0; Index<CLOCK_RTT_HISTORY; Index++)
+        if (RTTHistory[Index]<MinRTT) MinRTT=RTTHistory[Index];
+    Exchanges++;
+
+    // CK2 left the peer at T3 and travelled for half the round trip
+    Local=(double)Local64-(double)RTT/2;
+
+    if (Synced==false)
+    {
+        RefPeerTicks=PeerT3;
+        RefLocal=Local;
+        Ratio=1.0;
+        SyncError=0;
+        RoundTrip=RTT;
+        Synced=true;
+        return;
+    }
+
+    // Exchanges delayed by the network (queues, retries) give a wrong offset
+    Margin=MinRTT/2;
+    if (Margin<SampleRate/1000) Margin=SampleRate/1000;
+    if (RTT>MinRTT+Margin)
+    {
+        Rejected++;
+        return;
+    }
+
+    Elapsed=((double)(int64_t)(PeerT3-RefPeerTicks)*SampleRate)/RTP_TIMESTAMP_RATE;
+    if (Elapsed<=0) return;
+    Predicted=RefLocal+Elapsed*Ratio;
+    Error=Local-Predicted;
+
+    if (fabs (Error)>((double)SampleRate*CLOCK_RESYNC_MS)/1000)
+    {  // Peer clock has jumped : start again from this exchange
+        Synced=false;
+        AddExchange (PeerT3, ArrivalFrame, RTT);
+        Exchanges--;
+        return;
+    }
+
+    Ratio+=(Error/Elapsed)*RATE_GAIN;
+    if (Ratio>1.0+CLOCK_MAX_DRIFT_PPM*1e-6) Ratio=1.0+CLOCK_MAX_DRIFT_PPM*1e-6;
+    if (Ratio<1.0-CLOCK_MAX_DRIFT_PPM*1e-6) Ratio=1.0-CLOCK_MAX_DRIFT_PPM*1e-6;
+
+    RefLocal=Predicted+Error*OFFSET_GAIN;
+    RefPeerTicks=PeerT3;
+    SyncError+=(fabs (Error)-SyncError)/8;
+    RoundTrip=RTT;
+}  // CClockModel::AddExchange
+//-----------------------------------------------------------------------------
+
+bool CClockModel::MapTimestamp (uint32_t Timestamp, uint32_t* Frame)
+{
+    int64_t Ticks;
+    double Local;
+
+    if (Synced==false) return false;
+
+    // RTP timestamps are the low 32 bits of the peer clock
+    Ticks=(int32_t)(Timestamp-(uint32_t)RefPeerTicks);
+    Local=RefLocal+(((double)Ticks*SampleRate)/RTP_TIMESTAMP_RATE)*Ratio;
+
+    // Back to the 32 bits JACK frame clock
+    *Frame=(uint32_t)llround (Local);
+    return true;
+}  // CClockModel::MapTimestamp
+//-----------------------------------------------------------------------------
+
+uint32_t CClockModel::GetTransitFrames (void)
+{
+    if (MinRTT==NO_RTT) return 0;
+    return MinRTT/2;
+}  // CClockModel::GetTransitFrames
+//-----------------------------------------------------------------------------
+
+uint32_t CClockModel::GetSyncErrorMicros (void)
+{
+    return (uint32_t)((SyncError*1000000)/SampleRate);
+}  // CClockModel::GetSyncErrorMicros
+//-----------------------------------------------------------------------------
+
+int32_t CClockModel::GetDriftPPB (void)
+{
+    return (int32_t)lround ((Ratio-1.0)*1e9);
+}  // CClockModel::GetDriftPPB
+//-----------------------------------------------------------------------------
+
+uint32_t CClockModel::GetRoundTripMicros (void)
+{
+    return (uint32_t)(((uint64_t)RoundTrip*1000000)/SampleRate);
+}  // CClockModel::GetRoundTripMicros
+//-----------------------------------------------------------------------------
@@ -0,0 +1,122 @@
+/*
+ * File:   ClockModel.h
+ * Model of the clock of a remote RTP-MIDI peer, built from its clock synchronization exchanges
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ The remote peer (session initiator) synchronizes its clock with CK exchanges on the data port :
+    CK0 (peer -> us) : T1 = peer time
+    CK1 (us -> peer) : T1, T2 = our time (sent by the RTP-MIDI handler)
+    CK2 (peer -> us) : T1, T2, T3 = peer time
+ CK timestamps and RTP timestamps use the same peer clock (RTP_TIMESTAMP_RATE units).
+ CK0 and CK2 are peeked with their kernel arrival time. The round trip is T3-T1 minus the time
+ we took to answer CK0, and each exchange gives the JACK frame time at which the peer clock was T3.
+ Offset and rate of the peer clock are filtered over the successive exchanges (exchanges with a
+ round trip far above the recent minimum are not used) and map RTP timestamps to JACK frames.
+ */
+
+#ifndef __CLOCKMODEL_H__
+#define __CLOCKMODEL_H__
+
+#include <stdint.h>
+
+#define CLOCK_RTT_HISTORY       8               // Exchanges used for the minimum round trip
+#define CLOCK_MAX_DRIFT_PPM     500             // Larger rate differences are clamped
+#define CLOCK_RESYNC_MS         100             // Offset error considered as a new peer clock
+
+class CClockModel
+{
+public:
+    CClockModel (void);
+
+    // Sets the JACK sample rate and forgets the peer clock
+    void Configure (unsigned int Rate);
+
+    // Forgets the peer clock (new peer or new session)
+    void Reset (void);
+
+    // Records a CK packet received from the peer. Packet points to the 36 bytes of the CK message
+    // Returns true if the packet completed an exchange which updated the model
+    bool ProcessCK (const unsigned char* Packet, uint32_t ArrivalFrame);
+
+    // Tells the model that the RTP-MIDI handler has run (and answered a CK0 if one was pending)
+    void HandlerDone (uint32_t Frame);
+
+    bool IsSynced (void)
+    {
+        return Synced;
+    }
+
+    // Computes the JACK frame time at which the peer clock was at Timestamp (RTP_TIMESTAMP_RATE units)
+    // Returns false while no exchange has been completed
+    bool MapTimestamp (uint32_t Timestamp, uint32_t* Frame);
+
+    // One way transit time estimated from the minimum round trip, in frames
+    uint32_t GetTransitFrames (void);
+
+    // Local frames per peer frame (1.0 when both clocks run at the same rate)
+    double GetRatio (void)
+    {
+        return Ratio;
+    }
+
+    // Quality indicators, exported in statistics
+    uint32_t GetSyncErrorMicros (void);         // Average error of the model at the last exchanges
+    int32_t GetDriftPPB (void);                 // Rate of the peer clock relative to JACK clock
+    uint32_t GetRoundTripMicros (void);         // Round trip of the last exchange used
+    uint32_t Exchanges;                         // Completed exchanges
+    uint32_t Rejected;                          // Exchanges not used (round trip too long)
+
+private:
+    unsigned int SampleRate;
+    bool Synced;
+    uint32_t PeerSSRC;
+
+    // Pending exchange
+    bool CK0Pending;
+    bool ReplyDone;
+    uint64_t CK0Time;                   // T1 of the pending exchange
+    uint32_t CK0Arrival;
+    uint32_t ReplyFrame;                // Frame time when the handler answered CK0
+
+    // Model : local frame = RefLocal + (peer frame - RefPeer) * Ratio
+    uint32_t LastLocal;
+    int64_t Local64;                    // Unwrapped JACK frame time (low 32 bits are the JACK clock)
+    uint64_t RefPeerTicks;              // Peer time of last exchange (RTP_TIMESTAMP_RATE units)
+    double RefLocal;
+    double Ratio;
+    double SyncError;                   // Exponential average of the error (frames)
+    uint32_t RoundTrip;                 // Frames
+
+    uint32_t RTTHistory[CLOCK_RTT_HISTORY];
+    unsigned int RTTIndex;
+    uint32_t MinRTT;
+
+    void AddExchange (uint64_t PeerT3, uint32_t ArrivalFrame, uint32_t RTT);
+};
+
+#endif
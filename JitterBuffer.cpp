@@ -0,0 +1,198 @@
+/*
+ * File:   JitterBuffer.cpp
+ * Adaptive playout delay for MIDI received from the network
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "JitterBuffer.h"
+#include "RTPMIDIPacket.h"
+
+#define NO_TRANSIT      INT64_MAX
+
+CJitterBuffer::CJitterBuffer (void)
+{
+    Enabled=false;
+    SampleRate=48000;
+    MinDelay=0;
+    MaxDelay=0;
+    ClockRatio=1.0;
+    Reset();
+}  // CJitterBuffer::CJitterBuffer
+//-----------------------------------------------------------------------------
+
+void CJitterBuffer::Configure (unsigned int Rate, unsigned int MinDelayMs, unsigned int MaxDelayMs)
+{
+    if (Rate!=0) SampleRate=Rate;
+    if (MaxDelayMs<MinDelayMs) MaxDelayMs=MinDelayMs;
+    MinDelay=(SampleRate*MinDelayMs)/1000;
+    MaxDelay=(SampleRate*MaxDelayMs)/1000;
+    Enabled=true;
+    Reset();
+}  // CJitterBuffer::Configure
+//-----------------------------------------------------------------------------
+
+void CJitterBuffer::Reset (void)
+{
+    Valid=false;
+    TargetDelay=MinDelay;
+    PeerSSRC=0;
+    LastTimestamp=0;
+    Timestamp64=0;
+    LastArrival=0;
+    Arrival64=0;
+    SenderFrames=0;
+    AnchorTimestamp=0;
+    AnchorFrames=0.0;
+    MinTransit[0]=NO_TRANSIT;
+    MinTransit[1]=NO_TRANSIT;
+    WindowStart=0;
+    WindowSamples=0;
+    memset (&Histogram[0], 0, sizeof(Histogram));
+}  // CJitterBuffer::Reset
+//-----------------------------------------------------------------------------
+
+void CJitterBuffer::SetClockRatio (double Ratio)
+{
+    // Sender time reached with the previous ratio becomes the origin of the new one : transit times measured
+    // so far stay comparable with the next ones
+    AnchorFrames+=((double)(Timestamp64-AnchorTimestamp)*SampleRate*ClockRatio)/RTP_TIMESTAMP_RATE;
+    AnchorTimestamp=Timestamp64;
+    ClockRatio=Ratio;
+}  // CJitterBuffer::SetClockRatio
+//-----------------------------------------------------------------------------
+
+void CJitterBuffer::EndWindow (void)
+{
+    unsigned int Bucket;
+    uint32_t Count=0;
+    uint32_t Limit;
+    uint32_t Desired;
+
+    if (WindowSamples>0)
+    {
+        // Jitter below which JITTER_PERCENTILE % of the packets of the window have arrived
+        Limit=(WindowSamples*JITTER_PERCENTILE+99)/100;
+        for (Bucket=0; Bucket<JITTER_BUCKETS-1; Bucket++)
+        {
+            Count+=Histogram[Bucket];
+            if (Count>=Limit) break;
+        }
+        Desired=(uint32_t)(((uint64_t)(Bucket+1)*JITTER_BUCKET_MICROS*SampleRate)/1000000);
+
+        // Shrinks by a quarter of the difference per window, so timing changes stay inaudible
+        if (Desired<TargetDelay) TargetDelay-=(TargetDelay-Desired+3)/4;
+        if (TargetDelay<MinDelay) TargetDelay=MinDelay;
+    }
+
+    MinTransit[1]=MinTransit[0];
+    MinTransit[0]=NO_TRANSIT;
+    WindowSamples=0;
+    memset (&Histogram[0], 0, sizeof(Histogram));
+}  // CJitterBuffer::EndWindow
+//-----------------------------------------------------------------------------
+
+void CJitterBuffer::PacketArrival (uint32_t SSRC, uint32_t Timestamp, uint32_t ArrivalFrame)
+{
+    int64_t Transit;
+    int64_t Base;
+    int64_t Jitter;
+    unsigned int Bucket;
+
+    if (Enabled==false) return;
+
+    if ((Valid==false)||(SSRC!=PeerSSRC))
+    {
+        Reset();
+        Valid=true;
+        PeerSSRC=SSRC;
+        LastTimestamp=Timestamp;
+        LastArrival=ArrivalFrame;
+        WindowStart=ArrivalFrame;
+    }
+
+    // Both clocks are unwrapped from their 32 bits values
+    Timestamp64+=(int32_t)(Timestamp-LastTimestamp);
+    LastTimestamp=Timestamp;
+    Arrival64+=(int32_t)(ArrivalFrame-LastArrival);
+    LastArrival=ArrivalFrame;
+
+    SenderFrames=(int64_t)(AnchorFrames+((double)(Timestamp64-AnchorTimestamp)*SampleRate*ClockRatio)/RTP_TIMESTAMP_RATE);
+    Transit=Arrival64-SenderFrames;
+
+    Base=(MinTransit[0]<MinTransit[1]) ? MinTransit[0] : MinTransit[1];
+    if ((Base!=NO_TRANSIT)&&((Transit-Base>(int64_t)SampleRate*JITTER_RESYNC_MS/1000)||(Base-Transit>(int64_t)SampleRate*JITTER_RESYNC_MS/1000)))
+    {  // Sender clock has jumped (remote restarted) : start again from this packet
+        Reset();
+        PacketArrival (SSRC, Timestamp, ArrivalFrame);
+        return;
+    }
+
+    if (Transit<MinTransit[0]) MinTransit[0]=Transit;
+    if (Transit<Base) Base=Transit;
+
+    Jitter=Transit-Base;
+    Bucket=(unsigned int)((Jitter*1000000/SampleRate)/JITTER_BUCKET_MICROS);
+    if (Bucket>=JITTER_BUCKETS) Bucket=JITTER_BUCKETS-1;
+    Histogram[Bucket]++;
+    WindowSamples++;
+
+    // A packet later than the target delay : grow at once
+    if (Jitter>(int64_t)TargetDelay)
+        TargetDelay=(Jitter>(int64_t)MaxDelay) ? MaxDelay : (uint32_t)Jitter;
+
+    if (ArrivalFrame-WindowStart>=(SampleRate*JITTER_WINDOW_MS)/1000)
+    {
+        EndWindow();
+        WindowStart=ArrivalFrame;
+    }
+}  // CJitterBuffer::PacketArrival
+//-----------------------------------------------------------------------------
+
+bool CJitterBuffer::GetPlayoutTime (unsigned int DeltaTime, uint32_t* Time)
+{
+    int64_t Base;
+    int64_t Playout;
+
+    if ((Enabled==false)||(Valid==false)) return false;
+
+    Base=(MinTransit[0]<MinTransit[1]) ? MinTransit[0] : MinTransit[1];
+    if (Base==NO_TRANSIT) return false;
+
+    Playout=SenderFrames+(((int64_t)DeltaTime*SampleRate)/RTP_TIMESTAMP_RATE)+Base+TargetDelay;
+
+    // Back to the 32 bits JACK frame clock
+    *Time=LastArrival+(uint32_t)(Playout-Arrival64);
+    return true;
+}  // CJitterBuffer::GetPlayoutTime
+//-----------------------------------------------------------------------------
+
+uint32_t CJitterBuffer::GetTargetMicros (void)
+{
+    return (uint32_t)(((uint64_t)TargetDelay*1000000)/SampleRate);
+}  // CJitterBuffer::GetTargetMicros
+//-----------------------------------------------------------------------------
@@ -0,0 +1,110 @@
+/*
+ * File:   JitterBuffer.h
+ * Adaptive playout delay for MIDI received from the network
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Events received from a session are scheduled from the RTP timestamp of their packet instead of
+ their arrival time :
+    playout time = sender time + smallest transit time seen + target delay
+ The smallest transit time (arrival - sender time) over the last two windows gives the offset
+ between the sender clock and the JACK frame clock, and follows the drift of both clocks.
+ The difference between the transit time of a packet and the smallest one is its jitter.
+ When the clock model of the session knows the rate of the sender clock, sender times are corrected
+ with it, so the smallest transit time does not move with the drift. The rate only applies to the
+ sender time elapsed since the last rate change, so a new rate never moves the transit of past packets.
+ The target delay grows at once when a packet arrives later than the target, and shrinks slowly
+ towards the 95th percentile of the jitter of the last window, inside the limits of the session.
+ */
+
+#ifndef __JITTERBUFFER_H__
+#define __JITTERBUFFER_H__
+
+#include <stdint.h>
+
+#define JITTER_WINDOW_MS        2000            // Length of a measurement window
+#define JITTER_BUCKET_MICROS    500             // Resolution of jitter histogram
+#define JITTER_BUCKETS          128             // Last bucket counts everything above
+#define JITTER_PERCENTILE       95
+#define JITTER_RESYNC_MS        5000            // Transit change considered as a new sender clock
+
+class CJitterBuffer
+{
+public:
+    CJitterBuffer (void);
+
+    // Enables the buffer with delay limits in milliseconds. Clears all measures
+    void Configure (unsigned int Rate, unsigned int MinDelayMs, unsigned int MaxDelayMs);
+
+    // Forgets the sender clock (new sender or new session)
+    void Reset (void);
+
+    bool IsEnabled (void)
+    {
+        return Enabled;
+    }
+
+    // Local frames per sender frame, given by the clock model of the session (1.0 by default)
+    void SetClockRatio (double Ratio);
+
+    // Records the arrival of a packet. Timestamp is the RTP timestamp of the packet (RTP_TIMESTAMP_RATE units)
+    void PacketArrival (uint32_t SSRC, uint32_t Timestamp, uint32_t ArrivalFrame);
+
+    // Computes the JACK frame time of an event of the last packet. DeltaTime is in RTP_TIMESTAMP_RATE units
+    // Returns false if the buffer is disabled or no packet has been received yet
+    bool GetPlayoutTime (unsigned int DeltaTime, uint32_t* Time);
+
+    // Current target delay in microseconds
+    uint32_t GetTargetMicros (void);
+
+private:
+    bool Enabled;
+    bool Valid;
+    unsigned int SampleRate;
+    uint32_t MinDelay;                  // Limits and target, in frames
+    uint32_t MaxDelay;
+    uint32_t TargetDelay;
+    double ClockRatio;
+
+    uint32_t PeerSSRC;
+    uint32_t LastTimestamp;
+    int64_t Timestamp64;                // Unwrapped RTP timestamp of last packet
+    uint32_t LastArrival;
+    int64_t Arrival64;                  // Unwrapped arrival frame of last packet
+    int64_t SenderFrames;               // Sender time of last packet, in frames (corrected by ClockRatio)
+    int64_t AnchorTimestamp;            // Unwrapped RTP timestamp of last clock ratio change
+    double AnchorFrames;                // Sender time at AnchorTimestamp, in frames
+    int64_t MinTransit[2];              // Smallest transit in current and previous window
+
+    uint32_t WindowStart;
+    uint32_t WindowSamples;
+    uint32_t Histogram[JITTER_BUCKETS];
+
+    void EndWindow (void);
+};
+
+#endif
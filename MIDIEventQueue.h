@@ -0,0 +1,210 @@
+/*
+ * File:   MIDIEventQueue.h
+ * Lock-free single producer / single consumer queue of timestamped MIDI events
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Each event is stored as a record made of a TMIDIEventHeader followed by the MIDI bytes,
+ padded to 8 bytes. A record is never split at the end of the buffer : when it does not fit,
+ a padding record fills the end of the buffer and the event is stored at the beginning.
+ The consumer can then copy the MIDI bytes with a single memcpy.
+
+ Positions are free running counters (index = position & mask). The producer publishes the
+ write position with release semantic after the records are written, the consumer reads it
+ with acquire semantic (and reciprocally for the read position)
+ */
+
+#ifndef __MIDIEVENTQUEUE_H__
+#define __MIDIEVENTQUEUE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Default queue size in bytes (must be a power of two)
+#define MIDI_EVENT_QUEUE_SIZE       65536
+
+// Record size marking the padding record at the end of the buffer
+#define EVENT_SIZE_PADDING          0xFFFF
+
+// Maximum number of MIDI bytes in one record
+#define MAX_EVENT_DATA_SIZE         0xFFF0
+
+typedef struct {
+    uint32_t Time;              // JACK frame time of the event
+    uint16_t Size;              // Number of MIDI bytes following the header
+    uint8_t Source;             // Session or port the event comes from
+    uint8_t Flags;
+} TMIDIEventHeader;
+
+class CMIDIEventQueue
+{
+public:
+    // QueueSize is rounded up to the next power of two
+    CMIDIEventQueue (unsigned int QueueSize)
+    {
+        Size=8;
+        while (Size<QueueSize) Size<<=1;
+        Mask=Size-1;
+        Buffer=new uint64_t[Size/8];
+        memset (Buffer, 0, Size);
+        WritePos.store (0);
+        ReadPos.store (0);
+        PendingWrite=0;
+    }
+
+    ~CMIDIEventQueue (void)
+    {
+        delete[] Buffer;
+    }
+
+    // --- Producer side ---
+
+    // Reserves a contiguous record for DataSize MIDI bytes. Returns 0 if the queue is full
+    // The record is not visible to the consumer before Commit is called
+    TMIDIEventHeader* Reserve (unsigned int DataSize)
+    {
+        uint32_t RecordSize;
+        uint32_t Index;
+        uint32_t ToEnd;
+        uint32_t Needed;
+        TMIDIEventHeader* Header;
+
+        if (DataSize>MAX_EVENT_DATA_SIZE) return 0;
+        RecordSize=RecordLength (DataSize);
+
+        Index=PendingWrite&Mask;
+        ToEnd=Size-Index;
+        Needed=RecordSize;
+        if (ToEnd<RecordSize) Needed+=ToEnd;            // Padding needed to keep the record contiguous
+
+        if (PendingWrite-ReadPos.load (std::memory_order_acquire)+Needed>Size) return 0;
+
+        if (ToEnd<RecordSize)
+        {
+            Header=HeaderAt (Index);
+            Header->Size=EVENT_SIZE_PADDING;
+            PendingWrite+=ToEnd;
+            Index=0;
+        }
+
+        Header=HeaderAt (Index);
+        Header->Size=(uint16_t)DataSize;
+        Header->Source=0;
+        Header->Flags=0;
+        PendingWrite+=RecordSize;
+        return Header;
+    }
+
+    // Makes all reserved records visible to the consumer
+    void Commit (void)
+    {
+        WritePos.store (PendingWrite, std::memory_order_release);
+    }
+
+    // Position of the next record to be reserved, used to cancel a group of records
+    uint32_t GetMark (void)
+    {
+        return PendingWrite;
+    }
+
+    // Forget records reserved after Mark (they must not have been committed)
+    void Rollback (uint32_t Mark)
+    {
+        PendingWrite=Mark;
+    }
+
+    // Number of bytes used in the queue, seen from the producer
+    uint32_t GetFill (void)
+    {
+        return PendingWrite-ReadPos.load (std::memory_order_relaxed);
+    }
+
+    // --- Consumer side ---
+
+    // Returns the oldest record without removing it, or 0 if queue is empty
+    TMIDIEventHeader* Peek (void)
+    {
+        uint32_t Read;
+        uint32_t Write;
+        TMIDIEventHeader* Header;
+
+        Read=ReadPos.load (std::memory_order_relaxed);
+        Write=WritePos.load (std::memory_order_acquire);
+        if (Read==Write) return 0;
+
+        Header=HeaderAt (Read&Mask);
+        if (Header->Size==EVENT_SIZE_PADDING)
+        {  // Skip padding, the record is at the beginning of the buffer
+            Read+=Size-(Read&Mask);
+            ReadPos.store (Read, std::memory_order_release);
+            if (Read==Write) return 0;
+            Header=HeaderAt (0);
+        }
+        return Header;
+    }
+
+    // Removes the record returned by Peek
+    void Pop (void)
+    {
+        uint32_t Read;
+
+        Read=ReadPos.load (std::memory_order_relaxed);
+        Read+=RecordLength (HeaderAt (Read&Mask)->Size);
+        ReadPos.store (Read, std::memory_order_release);
+    }
+
+    // Pointer to MIDI bytes of a record
+    static unsigned char* EventData (TMIDIEventHeader* Header)
+    {
+        return (unsigned char*)(Header+1);
+    }
+
+private:
+    uint64_t* Buffer;
+    uint32_t Size;
+    uint32_t Mask;
+    uint32_t PendingWrite;                                  // Producer private position
+    // Positions are kept in separate cache lines so producer and consumer do not share a line
+    unsigned char PadWrite[64];
+    std::atomic<uint32_t> WritePos;                         // Written by producer only
+    unsigned char PadRead[64];
+    std::atomic<uint32_t> ReadPos;                          // Written by consumer only
+    unsigned char PadEnd[64];
+
+    static uint32_t RecordLength (uint32_t DataSize)
+    {
+        return (sizeof(TMIDIEventHeader)+DataSize+7)&~7u;
+    }
+
+    TMIDIEventHeader* HeaderAt (uint32_t Index)
+    {
+        return (TMIDIEventHeader*)((unsigned char*)Buffer+Index);
+    }
+};
+
+#endif
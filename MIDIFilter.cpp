@@ -0,0 +1,377 @@
+/*
+ * File:   MIDIFilter.cpp
+ * Filtering and thinning of MIDI messages exchanged with RTP-MIDI sessions
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MIDIFilter.h"
+
+// Flags of a key state
+#define KEY_SENT        0x01            // LastTime and LastValue are valid
+#define KEY_PENDING     0x02            // A message is held
+
+typedef struct {
+    const char* Name;
+    uint8_t FirstStatus;
+    uint8_t LastStatus;
+} TFilterClass;
+
+// SYSEX continuation chunks start with a data byte
+static const TFilterClass FilterClasses[]={
+    {"noteoff", 0x80, 0x8F},
+    {"noteon", 0x90, 0x9F},
+    {"polypressure", 0xA0, 0xAF},
+    {"cc", 0xB0, 0xBF},
+    {"program", 0xC0, 0xCF},
+    {"chanpressure", 0xD0, 0xDF},
+    {"pitchbend", 0xE0, 0xEF},
+    {"sysex", 0xF0, 0xF0},
+    {"sysex", 0xF7, 0xF7},
+    {"sysex", 0x00, 0x7F},
+    {"mtc", 0xF1, 0xF1},
+    {"songpos", 0xF2, 0xF2},
+    {"songsel", 0xF3, 0xF3},
+    {"tune", 0xF6, 0xF6},
+    {"clock", 0xF8, 0xF8},
+    {"transport", 0xFA, 0xFC},
+    {"activesensing", 0xFE, 0xFE},
+    {"reset", 0xFF, 0xFF}
+};
+
+#define NUM_FILTER_CLASSES      (sizeof(FilterClasses)/sizeof(TFilterClass))
+
+static uint16_t FilterValue (const unsigned char* Message)
+{
+    switch (Message[0]&0xF0)
+    {
+        case 0xD0 : return Message[1];
+        case 0xE0 : return (uint16_t)(Message[1]|(Message[2]<<7));
+        default : return Message[2];
+    }
+}  // FilterValue
+//-----------------------------------------------------------------------------
+
+CMIDIFilter::CMIDIFilter (void)
+{
+    Keys=0;
+    PendingList=0;
+    SampleRate=48000;
+    Clear();
+}  // CMIDIFilter::CMIDIFilter
+//-----------------------------------------------------------------------------
+
+CMIDIFilter::~CMIDIFilter (void)
+{
+    delete[] Keys;
+    delete[] PendingList;
+}  // CMIDIFilter::~CMIDIFilter
+//-----------------------------------------------------------------------------
+
+void CMIDIFilter::Clear (void)
+{
+    Active=false;
+    memset (&Actions[0], 0, sizeof(Actions));
+    memset (&IntervalMs[0], 0, sizeof(IntervalMs));
+    memset (&Interval[0], 0, sizeof(Interval));
+    NumPending=0;
+    if (Keys) memset (Keys, 0, FILTER_KEYS*sizeof(TFilterKeyState));
+}  // CMIDIFilter::Clear
+//-----------------------------------------------------------------------------
+
+void CMIDIFilter::SetSampleRate (unsigned int Rate)
+{
+    unsigned int Index;
+
+    if (Rate!=0) SampleRate=Rate;
+    for (Index=0; Index<16; Index++) Interval[Index]=(uint32_t)(((uint64_t)IntervalMs[Index]*SampleRate)/1000);
+}  // CMIDIFilter::SetSampleRate
+//-----------------------------------------------------------------------------
+
+bool CMIDIFilter::SetClassAction (const char* Class, uint8_t Action, unsigned int Ms)
+{
+    unsigned int ClassNum;
+    unsigned int Status;
+    bool Found=false;
+
+    // Check the class first, so the filter is not modified by an invalid directive
+    for (ClassNum=0; ClassNum<NUM_FILTER_CLASSES; ClassNum++)
+    {
+        if (strcmp (FilterClasses[ClassNum].Name, Class)!=0) continue;
+        Found=true;
+        if ((Action&(FILTER_DEDUP|FILTER_THIN))==0) continue;
+        Status=FilterClasses[ClassNum].FirstStatus&0xF0;
+        if ((Status!=0xA0)&&(Status!=0xB0)&&(Status!=0xD0)&&(Status!=0xE0)) return false;
+    }
+    if (Found==false) return false;
+
+    if ((Action&(FILTER_DEDUP|FILTER_THIN))&&(Keys==0))
+    {
+        Keys=new TFilterKeyState[FILTER_KEYS];
+        memset (Keys, 0, FILTER_KEYS*sizeof(TFilterKeyState));
+        PendingList=new uint16_t[FILTER_KEYS];
+    }
+
+    for (ClassNum=0; ClassNum<NUM_FILTER_CLASSES; ClassNum++)
+    {
+        if (strcmp (FilterClasses[ClassNum].Name, Class)!=0) continue;
+        for (Status=FilterClasses[ClassNum].FirstStatus; Status<=FilterClasses[ClassNum].LastStatus; Status++)
+            Actions[Status]|=Action;
+        if (Action&FILTER_THIN) IntervalMs[FilterClasses[ClassNum].FirstStatus>>4]=Ms;
+    }
+
+    SetSampleRate (0);
+    Active=true;
+    return true;
+}  // CMIDIFilter::SetClassAction
+//-----------------------------------------------------------------------------
+
+void CMIDIFilter::RemovePending (TFilterKeyState* State)
+{
+    NumPending--;
+    if (State->PendingIndex!=NumPending)
+    {  // Last entry of the list takes the place of the removed one
+        PendingList[State->PendingIndex]=PendingList[NumPending];
+        Keys[PendingList[NumPending]].PendingIndex=State->PendingIndex;
+    }
+    State->Flags&=~KEY_PENDING;
+}  // CMIDIFilter::RemovePending
+//-----------------------------------------------------------------------------
+
+bool CMIDIFilter::Check (const unsigned char* Message, unsigned int Length, uint32_t Time)
+{
+    uint8_t Action;
+    int Key;
+    TFilterKeyState* State;
+    uint16_t Value;
+
+    Action=Actions[Message[0]];
+    if (Action==0) return true;
+    if (Action&FILTER_DROP) return false;
+
+    Key=FilterKey (Message, Length);
+    if (Key<0) return true;
+    State=&Keys[Key];
+    Value=FilterValue (Message);
+
+    if ((Action&FILTER_DEDUP)&&(State->Flags&KEY_SENT)&&(State->LastValue==Value))
+    {  // Controller comes back to the value sent : the held value is obsolete
+        if (State->Flags&KEY_PENDING) RemovePending (State);
+        return false;
+    }
+
+    // Signed difference : times of scheduled events are not always increasing
+    if ((Action&FILTER_THIN)&&(State->Flags&KEY_SENT)&&((int32_t)(Time-State->LastTime)<(int32_t)Interval[Message[0]>>4]))
+    {  // Too close to the last message sent : held until the interval has elapsed
+        if (Length>sizeof(State->Pending)) Length=sizeof(State->Pending);
+        memcpy (&State->Pending[0], Message, Length);
+        State->PendingLength=(uint8_t)Length;
+        if ((State->Flags&KEY_PENDING)==0)
+        {
+            State->PendingIndex=(uint16_t)NumPending;
+            PendingList[NumPending++]=(uint16_t)Key;
+            State->Flags|=KEY_PENDING;
+        }
+        return false;
+    }
+
+    if (State->Flags&KEY_PENDING) RemovePending (State);
+    State->LastTime=Time;
+    State->LastValue=Value;
+    State->Flags|=KEY_SENT;
+    return true;
+}  // CMIDIFilter::Check
+//-----------------------------------------------------------------------------
+
+unsigned int CMIDIFilter::FlushDue (uint32_t Now, TFilterOutput* Output, void* Instance)
+{
+    unsigned int Index=0;
+    unsigned int NumSent=0;
+    TFilterKeyState* State;
+
+    while (Index<NumPending)
+    {
+        State=&Keys[PendingList[Index]];
+        if ((int32_t)(Now-State->LastTime)<(int32_t)Interval[State->Pending[0]>>4])
+        {
+            Index++;
+            continue;
+        }
+
+        // Message is sent at the end of the interval, so the next interval starts from there
+        State->LastTime+=Interval[State->Pending[0]>>4];
+        State->LastValue=FilterValue (State->Pending);
+        RemovePending (State);          // Moves the last entry to Index
+        Output (Instance, State->Pending, State->PendingLength, State->LastTime);
+        NumSent++;
+    }
+    return NumSent;
+}  // CMIDIFilter::FlushDue
+//-----------------------------------------------------------------------------
+
+CUpdateMerger::CUpdateMerger (void)
+{
+    Generation=0;
+    memset (&Stamp[0], 0, sizeof(Stamp));
+    memset (&Last[0], 0, sizeof(Last));
+}  // CUpdateMerger::CUpdateMerger
+//-----------------------------------------------------------------------------
+
+CFilterSet::CFilterSet (void)
+{
+    InMask=0;
+    OutMask=0;
+    MergeMask=0;
+}  // CFilterSet::CFilterSet
+//-----------------------------------------------------------------------------
+
+void CFilterSet::SetSampleRate (unsigned int Rate)
+{
+    unsigned int Session;
+
+    for (Session=0; Session<MAX_SESSIONS; Session++)
+    {
+        In[Session].SetSampleRate (Rate);
+        Out[Session].SetSampleRate (Rate);
+    }
+}  // CFilterSet::SetSampleRate
+//-----------------------------------------------------------------------------
+
+bool CFilterSet::LoadFilterFile (const char* FileName, unsigned int NumSessions)
+{
+    FILE* FilterFile;
+    char Line[256];
+    char* Token;
+    char* SavePtr;
+    char Directive[16];
+    unsigned int LineNum=0;
+    unsigned int Session;
+    unsigned int FirstSession;
+    unsigned int LastSession;
+    unsigned int IntervalMs=0;
+    uint8_t Action;
+    bool FilterIn=false;
+    bool FilterOut=false;
+    bool Valid;
+
+    FilterFile=fopen (FileName, "r");
+    if (FilterFile==0)
+    {
+        fprintf (stderr, "jackrtpmidid : can not open filter file %s\n", FileName);
+        return false;
+    }
+
+    while (fgets (Line, sizeof(Line), FilterFile)!=0)
+    {
+        LineNum++;
+
+        Token=strtok_r (Line, " \t\r\n", &SavePtr);
+        if ((Token==0)||(Token[0]=='#')) continue;
+        strncpy (Directive, Token, sizeof(Directive)-1);
+        Directive[sizeof(Directive)-1]=0;
+
+        Valid=false;
+        Action=0;
+        if (strcmp (Directive, "drop")==0) Action=FILTER_DROP;
+        else if (strcmp (Directive, "dedup")==0) Action=FILTER_DEDUP;
+        else if (strcmp (Directive, "thin")==0) Action=FILTER_THIN;
+
+        // Session number or * for all sessions
+        Token=strtok_r (0, " \t\r\n", &SavePtr);
+        if ((Token)&&((Action!=0)||(strcmp (Directive, "merge")==0)))
+        {
+            Valid=true;
+            if (strcmp (Token, "*")==0)
+            {
+                FirstSession=0;
+                LastSession=NumSessions;
+            }
+            else
+            {
+                FirstSession=(unsigned int)atoi (Token);
+                if ((FirstSession==0)||(FirstSession>NumSessions)) Valid=false;
+                LastSession=FirstSession;
+                FirstSession--;
+            }
+        }
+
+        if ((Valid)&&(Action==0))
+        {  // merge
+            for (Session=FirstSession; Session<LastSession; Session++) MergeMask|=(1u<<Session);
+        }
+        else if (Valid)
+        {
+            Token=strtok_r (0, " \t\r\n", &SavePtr);
+            if (Token==0) Valid=false;
+            else
+            {
+                FilterIn=(strcmp (Token, "in")==0)||(strcmp (Token, "both")==0);
+                FilterOut=(strcmp (Token, "out")==0)||(strcmp (Token, "both")==0);
+                if ((FilterIn==false)&&(FilterOut==false)) Valid=false;
+            }
+
+            if ((Valid)&&(Action==FILTER_THIN))
+            {
+                Token=strtok_r (0, " \t\r\n", &SavePtr);
+                if (Token==0) Valid=false;
+                else IntervalMs=(unsigned int)atoi (Token);
+            }
+
+            // At least one class
+            Token=(Valid) ? strtok_r (0, " \t\r\n", &SavePtr) : 0;
+            if (Token==0) Valid=false;
+            while ((Valid)&&(Token!=0))
+            {
+                for (Session=FirstSession; (Valid)&&(Session<LastSession); Session++)
+                {
+                    if (FilterIn) Valid=In[Session].SetClassAction (Token, Action, IntervalMs);
+                    if ((Valid)&&(FilterOut)) Valid=Out[Session].SetClassAction (Token, Action, IntervalMs);
+                }
+                Token=strtok_r (0, " \t\r\n", &SavePtr);
+            }
+        }
+
+        if (Valid==false)
+        {
+            fprintf (stderr, "jackrtpmidid : invalid filter directive in %s line %u\n", FileName, LineNum);
+            fclose (FilterFile);
+            return false;
+        }
+    }
+    fclose (FilterFile);
+
+    for (Session=0; Session<NumSessions; Session++)
+    {
+        if (In[Session].IsActive()) InMask|=(1u<<Session);
+        if (Out[Session].IsActive()) OutMask|=(1u<<Session);
+    }
+    OutMask|=MergeMask;
+    return true;
+}  // CFilterSet::LoadFilterFile
+//-----------------------------------------------------------------------------
@@ -0,0 +1,205 @@
+/*
+ * File:   MIDIFilter.h
+ * Filtering and thinning of MIDI messages exchanged with RTP-MIDI sessions
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Each session has one filter per direction (in = from network to JACK, out = from JACK to network).
+ Actions are looked up from the status byte in a 256 entries table built when the filter file is read :
+    drop   : messages of the class are removed
+    dedup  : continuous messages repeating the last value sent for their controller are removed
+    thin   : continuous messages closer than an interval to the last one sent for their controller are held,
+             only the last held value is sent when the interval has elapsed
+ Continuous messages are control change (except bank select, data entry, RPN / NRPN numbers and channel
+ mode messages, which are parts of sequences), polyphonic pressure, channel pressure and pitch bend.
+ Each continuous controller has its own state, indexed by a key computed from the message.
+ merge (out only) : when several updates of a continuous controller come from the same JACK port in one
+ period, only the last one is sent.
+
+ Filter file format (one directive per line, # for comments). <session> is a session number (from 1)
+ or * for all sessions, <dir> is in, out or both :
+    drop <session> <dir> <class> [<class>...]
+    dedup <session> <dir> <class> [<class>...]
+    thin <session> <dir> <ms> <class> [<class>...]
+    merge <session>
+ Classes : noteoff noteon polypressure cc program chanpressure pitchbend sysex mtc songpos songsel tune
+ clock transport activesensing reset
+ */
+
+#ifndef __MIDIFILTER_H__
+#define __MIDIFILTER_H__
+
+#include <stdint.h>
+#include "SessionManager.h"
+
+// Actions stored in the status table
+#define FILTER_DROP             0x01
+#define FILTER_DEDUP            0x02
+#define FILTER_THIN             0x04
+
+// Keys of continuous controllers : CC 0-2047, poly pressure 2048-4095, channel pressure 4096-4111, pitch bend 4112-4127
+#define FILTER_KEYS             4128
+
+// Highest key returned by FilterKey (pitch bend, channel 16) must index the key tables
+static_assert (4112+15<FILTER_KEYS, "FILTER_KEYS too small for pitch bend keys");
+static_assert (2048+15*128+127<FILTER_KEYS, "FILTER_KEYS too small for poly pressure keys");
+
+// Flag set in TMIDIEventHeader.Flags by jack_process when a later event of the same period updates the same controller
+#define EVENT_FLAG_SUPERSEDED   0x02
+
+// Returns the key of a continuous message, or -1 if the message is not continuous
+// Messages with an invalid data byte (JACK events are not checked) have no key
+inline int FilterKey (const unsigned char* Message, unsigned int Length)
+{
+    unsigned int Channel=Message[0]&0x0F;
+
+    if ((Length>=2)&&(Message[1]>=0x80)) return -1;
+    if ((Length>=3)&&(Message[2]>=0x80)) return -1;
+
+    switch (Message[0]&0xF0)
+    {
+        case 0xA0 :
+            return (Length>=3) ? 2048+Channel*128+Message[1] : -1;
+        case 0xB0 :
+            if (Length<3) return -1;
+            if ((Message[1]==0)||(Message[1]==32)||(Message[1]==6)||(Message[1]==38)) return -1;
+            if ((Message[1]>=96)&&(Message[1]<=101)) return -1;
+            if (Message[1]>=120) return -1;
+            return Channel*128+Message[1];
+        case 0xD0 :
+            return (Length>=2) ? 4096+Channel : -1;
+        case 0xE0 :
+            return (Length>=3) ? 4112+Channel : -1;
+        default :
+            return -1;
+    }
+}
+
+// Called by FlushDue for each held message whose interval has elapsed. Time is the end of the interval
+// (frame time of the previous message of the controller + thinning interval)
+typedef void (TFilterOutput)(void* Instance, unsigned char* Data, unsigned int Size, uint32_t Time);
+
+typedef struct {
+    uint32_t LastTime;                  // Frame time of last message sent (event time, may be ahead of JACK time)
+    uint16_t LastValue;
+    uint16_t PendingIndex;              // Position in the pending list
+    uint8_t Flags;
+    uint8_t PendingLength;
+    unsigned char Pending[3];           // Last message held
+} TFilterKeyState;
+
+class CMIDIFilter
+{
+public:
+    CMIDIFilter (void);
+    ~CMIDIFilter (void);
+
+    // Lets everything pass
+    void Clear (void);
+
+    // Converts thinning intervals to frames
+    void SetSampleRate (unsigned int Rate);
+
+    // Sets the action of a class of messages. Returns false if the class is unknown or
+    // if the action can not be used for it (dedup and thin only apply to continuous messages)
+    bool SetClassAction (const char* Class, uint8_t Action, unsigned int IntervalMs);
+
+    bool IsActive (void)
+    {
+        return Active;
+    }
+
+    // Returns true if the message must be sent. Time is the frame time of the message
+    bool Check (const unsigned char* Message, unsigned int Length, uint32_t Time);
+
+    // Gives to Output the held messages whose interval ends at or before Now. Now is in the same time base as
+    // the times given to Check : a message is sent at the end of its interval, not at the time of the call
+    // Returns the number of messages given
+    unsigned int FlushDue (uint32_t Now, TFilterOutput* Output, void* Instance);
+
+private:
+    bool Active;
+    unsigned int SampleRate;
+    uint8_t Actions[256];
+    unsigned int IntervalMs[16];        // Thinning interval, indexed by status >> 4
+    uint32_t Interval[16];              // Same in frames
+    TFilterKeyState* Keys;              // Allocated when dedup or thin is used
+    uint16_t* PendingList;              // Keys with a message held
+    unsigned int NumPending;
+
+    void RemovePending (TFilterKeyState* State);
+};
+
+// Keeps the position of the last update of each continuous controller in a list of events
+class CUpdateMerger
+{
+public:
+    CUpdateMerger (void);
+
+    // Starts a new list (previous positions are forgotten)
+    void Begin (void)
+    {
+        Generation++;
+    }
+
+    void Record (int Key, unsigned int Position)
+    {
+        Stamp[Key]=Generation;
+        Last[Key]=Position;
+    }
+
+    // Returns true if a later event of the list updates the same controller
+    bool IsSuperseded (int Key, unsigned int Position)
+    {
+        return (Stamp[Key]==Generation)&&(Last[Key]!=Position);
+    }
+
+private:
+    uint32_t Generation;
+    uint32_t Stamp[FILTER_KEYS];
+    uint32_t Last[FILTER_KEYS];
+};
+
+class CFilterSet
+{
+public:
+    CFilterSet (void);
+
+    // Reads filter directives from a file. Returns false if the file can not be read or is invalid
+    bool LoadFilterFile (const char* FileName, unsigned int NumSessions);
+
+    void SetSampleRate (unsigned int Rate);
+
+    CMIDIFilter In[MAX_SESSIONS];       // From network to JACK
+    CMIDIFilter Out[MAX_SESSIONS];      // From JACK to network
+    uint32_t InMask;                    // Sessions with an active filter (bit n = session n)
+    uint32_t OutMask;                   // Sessions with an active filter or merging
+    uint32_t MergeMask;                 // Sessions receiving only the last update of a period
+    CUpdateMerger Merger;               // Used by jack_process only
+};
+
+#endif
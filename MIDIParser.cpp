@@ -0,0 +1,266 @@
+/*
+ * File:   MIDIParser.cpp
+ * MIDI 1.0 stream parser giving complete messages (one parser per source)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "MIDIParser.h"
+
+// Message sizes for status bytes 0x80 to 0xFF (F0 and F7 are handled by the parser)
+static const uint8_t MessageSizes[128]={
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,         // 8n : note off
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,         // 9n : note on
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,         // An : polyphonic pressure
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,         // Bn : control change
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,         // Cn : program change
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,         // Dn : channel pressure
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,         // En : pitch bend
+    0, 2, 3, 2, 0, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, 1          // F0 to FF : system common and realtime
+};
+
+unsigned int MIDIMessageSize (unsigned char Status)
+{
+    if (Status<0x80) return 0;
+    return MessageSizes[Status-0x80];
+}  // MIDIMessageSize
+//-----------------------------------------------------------------------------
+
+CMIDIParser::CMIDIParser (void)
+{
+    Block=0;
+    BlockSize=0;
+    Pos=0;
+    DiscardedBytes=0;
+    Reset();
+}  // CMIDIParser::CMIDIParser
+//-----------------------------------------------------------------------------
+
+void CMIDIParser::Reset (void)
+{
+    RunningStatus=0;
+    PendingCount=0;
+    PendingSize=0;
+    SysExActive=false;
+    SysExOverflow=false;
+    SysExSize=0;
+}  // CMIDIParser::Reset
+//-----------------------------------------------------------------------------
+
+void CMIDIParser::Begin (unsigned char* Data, unsigned int Size)
+{
+    Block=Data;
+    BlockSize=Size;
+    Pos=0;
+}  // CMIDIParser::Begin
+//-----------------------------------------------------------------------------
+
+// Ends the SYSEX kept in the parser. Returns false if it is discarded
+bool CMIDIParser::CompleteSysEx (unsigned char** Message, unsigned int* Size)
+{
+    SysExActive=false;
+    if (SysExOverflow)
+    {
+        DiscardedBytes+=SysExSize+1;
+        SysExOverflow=false;
+        return false;
+    }
+    SysExBuffer[SysExSize++]=0xF7;
+    *Message=&SysExBuffer[0];
+    *Size=SysExSize;
+    return true;
+}  // CMIDIParser::CompleteSysEx
+//-----------------------------------------------------------------------------
+
+bool CMIDIParser::Next (unsigned char** Message, unsigned int* Size)
+{
+    unsigned char Byte;
+    unsigned int MessageSize;
+    unsigned int End;
+    unsigned int Scan;
+    unsigned int Write;
+    unsigned int NumRealtime;
+    unsigned int Kept;
+    unsigned char Realtime[MIDI_PARSER_MAX_REALTIME];
+
+    while (Pos<BlockSize)
+    {
+        Byte=Block[Pos];
+
+        // Realtime messages can appear anywhere and do not change the parser state
+        if (Byte>=0xF8)
+        {
+            Pos++;
+            if (MessageSizes[Byte-0x80]==0)
+            {
+                DiscardedBytes++;
+                continue;
+            }
+            *Message=&Block[Pos-1];
+            *Size=1;
+            return true;
+        }
+
+        if (SysExActive)
+        {  // SYSEX continued from a previous block
+            Pos++;
+            if (Byte==0xF7)
+            {
+                if (CompleteSysEx (Message, Size)) return true;
+                continue;
+            }
+            if (Byte<0x80)
+            {
+                if (SysExSize<MIDI_PARSER_SYSEX_SIZE-1) SysExBuffer[SysExSize++]=Byte;
+                else
+                {
+                    SysExOverflow=true;
+                    DiscardedBytes++;
+                }
+                continue;
+            }
+            // Any other status byte cancels the SYSEX
+            DiscardedBytes+=SysExSize;
+            SysExActive=false;
+            SysExOverflow=false;
+            Pos--;
+            continue;
+        }
+
+        if (Byte<0x80)
+        {  // Data byte : completes the pending message, or starts a message with running status
+            Pos++;
+            if (PendingCount==0)
+            {
+                if (RunningStatus==0)
+                {
+                    DiscardedBytes++;
+                    continue;
+                }
+                Pending[0]=RunningStatus;
+                PendingCount=1;
+                PendingSize=MessageSizes[RunningStatus-0x80];
+            }
+            Pending[PendingCount++]=Byte;
+            if (PendingCount<PendingSize) continue;
+            PendingCount=0;
+            *Message=&Pending[0];
+            *Size=PendingSize;
+            return true;
+        }
+
+        // Status byte : a message not yet complete is lost
+        if (PendingCount>0)
+        {
+            DiscardedBytes+=PendingCount;
+            PendingCount=0;
+        }
+
+        if (Byte==0xF0)
+        {
+            RunningStatus=0;
+
+            // Look for the end of the SYSEX in the block
+            NumRealtime=0;
+            for (End=Pos+1; End<BlockSize; End++)
+            {
+                if (Block[End]<0x80) continue;
+                if (Block[End]>=0xF8) NumRealtime++;
+                else break;
+            }
+
+            if ((End<BlockSize)&&(Block[End]==0xF7))
+            {
+                if (NumRealtime>0)
+                {  // Realtime bytes are moved before the SYSEX : they are given first, then the SYSEX without copy
+                    Write=End;
+                    Kept=0;
+                    for (Scan=End; Scan>Pos; Scan--)
+                    {
+                        if (Block[Scan-1]>=0xF8)
+                        {
+                            if (Kept<MIDI_PARSER_MAX_REALTIME) Realtime[MIDI_PARSER_MAX_REALTIME-1-Kept++]=Block[Scan-1];
+                            else DiscardedBytes++;
+                        }
+                        else Block[--Write]=Block[Scan-1];
+                    }
+                    Pos=Write-Kept;                         // Write is now the position of F0
+                    memcpy (&Block[Pos], &Realtime[MIDI_PARSER_MAX_REALTIME-Kept], Kept);
+                    continue;
+                }
+                *Message=&Block[Pos];
+                *Size=End-Pos+1;
+                Pos=End+1;
+                return true;
+            }
+
+            // SYSEX continues in the next block, or is interrupted by a status byte in this block
+            Pos++;
+            SysExBuffer[0]=0xF0;
+            SysExSize=1;
+            SysExActive=true;
+            SysExOverflow=false;
+            continue;
+        }
+
+        MessageSize=MessageSizes[Byte-0x80];
+        if (MessageSize==0)
+        {  // F7 without SYSEX, undefined system common
+            Pos++;
+            DiscardedBytes++;
+            RunningStatus=0;
+            continue;
+        }
+
+        // Channel messages set running status, system common messages cancel it
+        RunningStatus=(Byte<0xF0) ? Byte : 0;
+
+        // Complete message in the block : given without copy
+        if (Pos+MessageSize<=BlockSize)
+        {
+            for (Scan=1; Scan<MessageSize; Scan++)
+            {
+                if (Block[Pos+Scan]>=0x80) break;
+            }
+            if (Scan==MessageSize)
+            {
+                *Message=&Block[Pos];
+                *Size=MessageSize;
+                Pos+=MessageSize;
+                return true;
+            }
+        }
+
+        // Message continues in the next block or is interrupted by another status byte
+        Pos++;
+        Pending[0]=Byte;
+        PendingCount=1;
+        PendingSize=MessageSize;
+    }
+    return false;
+}  // CMIDIParser::Next
+//-----------------------------------------------------------------------------
@@ -0,0 +1,96 @@
+/*
+ * File:   MIDIParser.h
+ * MIDI 1.0 stream parser giving complete messages (one parser per source)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Each source (RTP-MIDI session) has its own parser, so running status, a message split between
+ two blocks or a SYSEX continued in the next block never mixes with the data of another source.
+ The parser handles :
+ - running status (data bytes without status are completed with the last channel status)
+ - system realtime messages embedded in other messages or in a SYSEX : they are given before the
+   message they interrupt
+ - SYSEX continued over several blocks (kept in the parser up to MIDI_PARSER_SYSEX_SIZE bytes)
+ Incomplete messages (interrupted by another status byte), data bytes without status, undefined
+ status bytes and SYSEX too big to be continued are discarded and their bytes counted.
+
+ Messages complete in the block are given without copy (realtime bytes are moved out of a SYSEX
+ in the block itself) : only messages completed by running status or over several blocks are
+ copied in the parser.
+ */
+
+#ifndef __MIDIPARSER_H__
+#define __MIDIPARSER_H__
+
+#include <stdint.h>
+
+// Largest SYSEX which can be continued from one block to the next one
+#define MIDI_PARSER_SYSEX_SIZE      4096
+
+// Realtime bytes moved out of one SYSEX complete in a block (next ones are discarded)
+#define MIDI_PARSER_MAX_REALTIME    16
+
+// Size of a MIDI message from its status byte. 0 for SYSEX (variable size) and undefined status bytes
+unsigned int MIDIMessageSize (unsigned char Status);
+
+class CMIDIParser
+{
+public:
+    CMIDIParser (void);
+
+    // Forgets running status and any incomplete message (new peer)
+    void Reset (void);
+
+    // Starts parsing a block. The block can be modified (realtime bytes moved out of a SYSEX) and must stay
+    // valid until Next returns false
+    void Begin (unsigned char* Data, unsigned int Size);
+
+    // Gives the next complete message of the block. Returns false when the rest of the block has been parsed
+    // Message is valid until next call
+    bool Next (unsigned char** Message, unsigned int* Size);
+
+    uint64_t DiscardedBytes;            // Total bytes of incomplete or invalid messages
+
+private:
+    unsigned char* Block;
+    unsigned int BlockSize;
+    unsigned int Pos;
+
+    unsigned char RunningStatus;        // 0 : no running status
+    unsigned char Pending[3];           // Message being completed
+    unsigned int PendingCount;
+    unsigned int PendingSize;
+
+    bool SysExActive;                   // A SYSEX continues in the next blocks
+    bool SysExOverflow;                 // SYSEX is too big and will be discarded when complete
+    unsigned int SysExSize;
+    unsigned char SysExBuffer[MIDI_PARSER_SYSEX_SIZE];
+
+    bool CompleteSysEx (unsigned char** Message, unsigned int* Size);
+};
+
+#endif
@@ -0,0 +1,684 @@
+/*
+ * File:   NetUMP.cpp
+ * Network MIDI 2.0 (UDP) endpoint transporting UMP packets
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "NetUMP.h"
+#include "UMPQueue.h"
+
+// Command codes
+#define CMD_INVITATION              0x01
+#define CMD_INVITATION_AUTH         0x02
+#define CMD_INVITATION_USER_AUTH    0x03
+#define CMD_INVITATION_ACCEPTED     0x10
+#define CMD_PING                    0x20
+#define CMD_PING_REPLY              0x21
+#define CMD_RETRANSMIT_REQUEST      0x80
+#define CMD_RETRANSMIT_ERROR        0x81
+#define CMD_SESSION_RESET           0x82
+#define CMD_SESSION_RESET_REPLY     0x83
+#define CMD_NAK                     0x8F
+#define CMD_BYE                     0xF0
+#define CMD_BYE_REPLY               0xF1
+#define CMD_UMP_DATA                0xFF
+
+// Bye reasons
+#define BYE_USER_TERMINATED         0x01
+#define BYE_TIMEOUT                 0x04
+#define BYE_NOT_ESTABLISHED         0x05
+#define BYE_TOO_MANY_SESSIONS       0x40
+
+// Retransmit error reason
+#define RETRANSMIT_NOT_AVAILABLE    0x01
+
+// NAK reason
+#define NAK_NOT_SUPPORTED           0x01
+
+static const unsigned char Signature[4]={'M', 'I', 'D', 'I'};
+
+static uint32_t ReadWord (const unsigned char* Data)
+{
+    return ((uint32_t)Data[0]<<24)|((uint32_t)Data[1]<<16)|((uint32_t)Data[2]<<8)|(uint32_t)Data[3];
+}  // ReadWord
+//-----------------------------------------------------------------------------
+
+static void WriteWord (unsigned char* Data, uint32_t Word)
+{
+    Data[0]=(unsigned char)(Word>>24);
+    Data[1]=(unsigned char)(Word>>16);
+    Data[2]=(unsigned char)(Word>>8);
+    Data[3]=(unsigned char)Word;
+}  // WriteWord
+//-----------------------------------------------------------------------------
+
+static bool SameAddress (const struct sockaddr_in* A, const struct sockaddr_in* B)
+{
+    return (A->sin_addr.s_addr==B->sin_addr.s_addr)&&(A->sin_port==B->sin_port);
+}  // SameAddress
+//-----------------------------------------------------------------------------
+
+CNetUMP::CNetUMP (void)
+{
+    unsigned int MsgNum;
+
+    Socket=-1;
+    Connected=false;
+    LostCommands=0;
+    PingID=0;
+    EventWrite.store (0);
+    EventRead.store (0);
+    memset (&ClientAddress, 0, sizeof(ClientAddress));
+    EndpointName[0]=0;
+    ProductInstanceID[0]=0;
+    ResetSequences();
+
+    // recvmmsg buffers never move, only lengths are set again before each call
+    memset (&RXMessages[0], 0, sizeof(RXMessages));
+    for (MsgNum=0; MsgNum<NETUMP_RX_BATCH; MsgNum++)
+    {
+        RXVectors[MsgNum].iov_base=RXBuffers[MsgNum];
+        RXVectors[MsgNum].iov_len=NETUMP_RX_SIZE;
+        RXMessages[MsgNum].msg_hdr.msg_name=&RXAddresses[MsgNum];
+        RXMessages[MsgNum].msg_hdr.msg_iov=&RXVectors[MsgNum];
+        RXMessages[MsgNum].msg_hdr.msg_iovlen=1;
+        RXMessages[MsgNum].msg_hdr.msg_control=RXControls[MsgNum];
+    }
+}  // CNetUMP::CNetUMP
+//-----------------------------------------------------------------------------
+
+CNetUMP::~CNetUMP (void)
+{
+    Close();
+}  // CNetUMP::~CNetUMP
+//-----------------------------------------------------------------------------
+
+void CNetUMP::ResetSequences (void)
+{
+    TXSequence=0;
+    HistoryCount=0;
+    Pending=0;
+    RXSequence=0;
+    RXSynced=false;
+    RetransmitPending=false;
+    RetransmitWaitMs=0;
+    HighestSequence=0;
+    HeldValid=false;
+    SilenceMs=0;
+    PingWaitMs=0;
+    TXQueueCount=0;
+}  // CNetUMP::ResetSequences
+//-----------------------------------------------------------------------------
+
+bool CNetUMP::Open (unsigned short LocalPort, const char* Name, const char* InstanceID)
+{
+    struct sockaddr_in LocalAddress;
+    int One=1;
+
+    strncpy (EndpointName, Name, NETUMP_NAME_LENGTH-1);
+    EndpointName[NETUMP_NAME_LENGTH-1]=0;
+    strncpy (ProductInstanceID, InstanceID, NETUMP_NAME_LENGTH-1);
+    ProductInstanceID[NETUMP_NAME_LENGTH-1]=0;
+
+    Socket=socket (AF_INET, SOCK_DGRAM, 0);
+    if (Socket==-1) return false;
+
+    memset (&LocalAddress, 0, sizeof(LocalAddress));
+    LocalAddress.sin_family=AF_INET;
+    LocalAddress.sin_addr.s_addr=htonl (INADDR_ANY);
+    LocalAddress.sin_port=htons (LocalPort);
+    if (bind (Socket, (struct sockaddr*)&LocalAddress, sizeof(LocalAddress))!=0)
+    {
+        close (Socket);
+        Socket=-1;
+        return false;
+    }
+
+    // Socket is read until empty by the realtime thread
+    fcntl (Socket, F_SETFL, fcntl (Socket, F_GETFL, 0)|O_NONBLOCK);
+
+    // Kernel receive time of each datagram is given with the data (not fatal if refused)
+    setsockopt (Socket, SOL_SOCKET, SO_TIMESTAMPNS, &One, sizeof(One));
+    return true;
+}  // CNetUMP::Open
+//-----------------------------------------------------------------------------
+
+void CNetUMP::Close (void)
+{
+    if (Socket==-1) return;
+    if (Connected)
+    {
+        Disconnect (BYE_USER_TERMINATED);
+        printf ("NetUMP session closed\n");
+    }
+    close (Socket);
+    Socket=-1;
+}  // CNetUMP::Close
+//-----------------------------------------------------------------------------
+
+void CNetUMP::PostEvent (uint8_t Type, const struct sockaddr_in* Client)
+{
+    uint32_t Write;
+    TNetUMPEvent* Event;
+
+    Write=EventWrite.load (std::memory_order_relaxed);
+    if (Write-EventRead.load (std::memory_order_acquire)>=NETUMP_EVENTS) return;
+    Event=&Events[Write&(NETUMP_EVENTS-1)];
+    Event->Type=Type;
+    Event->Address=Client->sin_addr;
+    Event->Port=Client->sin_port;
+    EventWrite.store (Write+1, std::memory_order_release);
+}  // CNetUMP::PostEvent
+//-----------------------------------------------------------------------------
+
+bool CNetUMP::GetEvent (TNetUMPEvent* Event)
+{
+    uint32_t Read;
+
+    Read=EventRead.load (std::memory_order_relaxed);
+    if (Read==EventWrite.load (std::memory_order_acquire)) return false;
+    *Event=Events[Read&(NETUMP_EVENTS-1)];
+    EventRead.store (Read+1, std::memory_order_release);
+    return true;
+}  // CNetUMP::GetEvent
+//-----------------------------------------------------------------------------
+
+// Writes a command packet in TXBuffer at Offset. Payload is in host order. Returns the offset after the command
+unsigned int CNetUMP::AddCommand (unsigned int Offset, unsigned char Code, uint16_t SpecificData, const uint32_t* Payload, unsigned int NumWords)
+{
+    unsigned int WordNum;
+
+    TXBuffer[Offset]=Code;
+    TXBuffer[Offset+1]=(unsigned char)NumWords;
+    TXBuffer[Offset+2]=(unsigned char)(SpecificData>>8);
+    TXBuffer[Offset+3]=(unsigned char)SpecificData;
+    Offset+=4;
+    for (WordNum=0; WordNum<NumWords; WordNum++)
+    {
+        WriteWord (&TXBuffer[Offset], Payload[WordNum]);
+        Offset+=4;
+    }
+    return Offset;
+}  // CNetUMP::AddCommand
+//-----------------------------------------------------------------------------
+
+void CNetUMP::SendCommand (const struct sockaddr_in* To, unsigned char Code, uint16_t SpecificData, const uint32_t* Payload, unsigned int NumWords)
+{
+    unsigned int Size;
+
+    memcpy (&TXBuffer[0], Signature, 4);
+    Size=AddCommand (4, Code, SpecificData, Payload, NumWords);
+    sendto (Socket, TXBuffer, Size, 0, (const struct sockaddr*)To, sizeof(struct sockaddr_in));
+}  // CNetUMP::SendCommand
+//-----------------------------------------------------------------------------
+
+void CNetUMP::SendBye (const struct sockaddr_in* To, unsigned char Reason)
+{
+    SendCommand (To, CMD_BYE, (uint16_t)(Reason<<8), 0, 0);
+}  // CNetUMP::SendBye
+//-----------------------------------------------------------------------------
+
+void CNetUMP::Disconnect (unsigned char Reason)
+{
+    SendBye (&ClientAddress, Reason);
+    Connected=false;
+    ResetSequences();
+    if (Reason!=BYE_USER_TERMINATED) PostEvent (NETUMP_EVENT_CLOSED, &ClientAddress);
+}  // CNetUMP::Disconnect
+//-----------------------------------------------------------------------------
+
+void CNetUMP::AcceptInvitation (const struct sockaddr_in* From)
+{
+    uint32_t Payload[2*NETUMP_NAME_LENGTH/4];
+    unsigned int NameWords;
+    unsigned int IDWords;
+    unsigned char Text[NETUMP_NAME_LENGTH];
+    unsigned int WordNum;
+
+    ClientAddress=*From;
+    if (Connected==false) PostEvent (NETUMP_EVENT_OPENED, From);
+    Connected=true;
+    ResetSequences();
+
+    // Endpoint name and product instance ID are UTF-8 strings padded with zeros to a whole number of words
+    // (both strings are already limited to NETUMP_NAME_LENGTH-1 characters by Open)
+    memset (Text, 0, sizeof(Text));
+    memcpy (Text, EndpointName, strlen (EndpointName));
+    NameWords=(strlen (EndpointName)+3)/4;
+    for (WordNum=0; WordNum<NameWords; WordNum++) Payload[WordNum]=ReadWord (&Text[4*WordNum]);
+
+    memset (Text, 0, sizeof(Text));
+    memcpy (Text, ProductInstanceID, strlen (ProductInstanceID));
+    IDWords=(strlen (ProductInstanceID)+3)/4;
+    for (WordNum=0; WordNum<IDWords; WordNum++) Payload[NameWords+WordNum]=ReadWord (&Text[4*WordNum]);
+
+    SendCommand (&ClientAddress, CMD_INVITATION_ACCEPTED, (uint16_t)(NameWords<<8), Payload, NameWords+IDWords);
+}  // CNetUMP::AcceptInvitation
+//-----------------------------------------------------------------------------
+
+void CNetUMP::Retransmit (uint16_t FirstSequence, unsigned int Count)
+{
+    TNetUMPDataCommand* Command;
+    uint32_t Payload;
+    unsigned int Size;
+    uint16_t Oldest;
+
+    // Requested commands must still be in the history
+    Oldest=(uint16_t)(TXSequence-HistoryCount);
+    if ((HistoryCount==0)||((uint16_t)(FirstSequence-Oldest)>=HistoryCount))
+    {
+        Payload=(uint32_t)FirstSequence<<16;
+        SendCommand (&ClientAddress, CMD_RETRANSMIT_ERROR, RETRANSMIT_NOT_AVAILABLE<<8, &Payload, 1);
+        return;
+    }
+
+    // Count 0 means all the commands from FirstSequence
+    if ((Count==0)||(Count>(uint16_t)(TXSequence-FirstSequence))) Count=(uint16_t)(TXSequence-FirstSequence);
+
+    memcpy (&TXBuffer[0], Signature, 4);
+    Size=4;
+    while (Count>0)
+    {
+        Command=&History[FirstSequence&(NETUMP_HISTORY-1)];
+        if (Size+4+4*Command->NumWords>NETUMP_MAX_PACKET)
+        {
+            QueuePacket (Size);
+            Size=4;
+        }
+        TXBuffer[Size]=CMD_UMP_DATA;
+        TXBuffer[Size+1]=(unsigned char)Command->NumWords;
+        TXBuffer[Size+2]=(unsigned char)(Command->Sequence>>8);
+        TXBuffer[Size+3]=(unsigned char)Command->Sequence;
+        memcpy (&TXBuffer[Size+4], Command->Words, 4*Command->NumWords);
+        Size+=4+4*Command->NumWords;
+        FirstSequence++;
+        Count--;
+    }
+    if (Size>4) QueuePacket (Size);
+    SendQueued();
+}  // CNetUMP::Retransmit
+//-----------------------------------------------------------------------------
+
+void CNetUMP::QueuePacket (unsigned int Size)
+{
+    if (TXQueueCount>=NETUMP_TX_BATCH) SendQueued();
+    memcpy (TXQueue[TXQueueCount], TXBuffer, Size);
+    TXQueueSizes[TXQueueCount]=Size;
+    TXQueueCount++;
+}  // CNetUMP::QueuePacket
+//-----------------------------------------------------------------------------
+
+void CNetUMP::SendQueued (void)
+{
+    struct mmsghdr Messages[NETUMP_TX_BATCH];
+    struct iovec Vectors[NETUMP_TX_BATCH];
+    unsigned int MsgNum;
+    unsigned int NumSent;
+    int Ret;
+
+    if ((TXQueueCount==0)||(Socket==-1)) return;
+
+    memset (&Messages[0], 0, sizeof(Messages));
+    for (MsgNum=0; MsgNum<TXQueueCount; MsgNum++)
+    {
+        Vectors[MsgNum].iov_base=TXQueue[MsgNum];
+        Vectors[MsgNum].iov_len=TXQueueSizes[MsgNum];
+        Messages[MsgNum].msg_hdr.msg_name=&ClientAddress;
+        Messages[MsgNum].msg_hdr.msg_namelen=sizeof(ClientAddress);
+        Messages[MsgNum].msg_hdr.msg_iov=&Vectors[MsgNum];
+        Messages[MsgNum].msg_hdr.msg_iovlen=1;
+    }
+
+    // sendmmsg stops at the first datagram refused : the others are tried again, a full socket buffer drops them
+    NumSent=0;
+    while (NumSent<TXQueueCount)
+    {
+        Ret=sendmmsg (Socket, &Messages[NumSent], TXQueueCount-NumSent, MSG_DONTWAIT);
+        if (Ret<=0) break;
+        NumSent+=(unsigned int)Ret;
+    }
+    TXQueueCount=0;
+}  // CNetUMP::SendQueued
+//-----------------------------------------------------------------------------
+
+// Gives the UMP packets of a data command to Callback
+void CNetUMP::DeliverData (const unsigned char* Payload, unsigned int NumWords, const struct timespec* Arrival, TUMPReceiveCallback* Callback, void* Instance)
+{
+    uint32_t Words[UMP_MAX_WORDS];
+    unsigned int WordNum;
+    unsigned int PacketWords;
+    unsigned int Index;
+
+    // Utility messages (NOOP, jitter reduction timestamps) belong to the transport and are not delivered
+    WordNum=0;
+    while (WordNum<NumWords)
+    {
+        Words[0]=ReadWord (&Payload[4*WordNum]);
+        PacketWords=UMPWordCount (Words[0]);
+        if (WordNum+PacketWords>NumWords) break;
+        for (Index=1; Index<PacketWords; Index++) Words[Index]=ReadWord (&Payload[4*(WordNum+Index)]);
+        if ((Words[0]>>28)!=0) Callback (Instance, Words, Arrival);
+        WordNum+=PacketWords;
+    }
+}  // CNetUMP::DeliverData
+//-----------------------------------------------------------------------------
+
+// Missing commands did not come back in time (or the client can not resend them) : they are counted as lost and
+// the command held is delivered. Commands dropped while waiting are asked once more
+void CNetUMP::AcceptGap (TUMPReceiveCallback* Callback, void* Instance)
+{
+    uint32_t RequestPayload;
+
+    if (RetransmitPending==false) return;
+
+    if (HeldValid==false)
+    {
+        LostCommands+=(uint16_t)(HighestSequence+1-RXSequence);
+        RXSequence=HighestSequence+1;
+        RetransmitPending=false;
+        return;
+    }
+
+    LostCommands+=(uint16_t)(HeldSequence-RXSequence);
+    RXSequence=HeldSequence+1;
+    HeldValid=false;
+    DeliverData (HeldPayload, HeldWords, &HeldArrival, Callback, Instance);
+
+    if ((int16_t)(HighestSequence-RXSequence)>=0)
+    {
+        RequestPayload=(uint32_t)(uint16_t)(HighestSequence+1-RXSequence)<<16;
+        SendCommand (&ClientAddress, CMD_RETRANSMIT_REQUEST, RXSequence, &RequestPayload, 1);
+        RetransmitWaitMs=0;
+    }
+    else RetransmitPending=false;
+}  // CNetUMP::AcceptGap
+//-----------------------------------------------------------------------------
+
+void CNetUMP::ReceiveData (uint16_t Sequence, const unsigned char* Payload, unsigned int NumWords, const struct timespec* Arrival, TUMPReceiveCallback* Callback, void* Instance)
+{
+    int16_t Distance;
+    uint32_t RequestPayload;
+
+    if (RXSynced==false)
+    {
+        RXSequence=Sequence;
+        RXSynced=true;
+    }
+
+    Distance=(int16_t)(Sequence-RXSequence);
+    if (Distance<0) return;                 // Already received (forward error correction)
+    if (Distance>0)
+    {
+        if (RetransmitPending==false)
+        {  // Commands are missing : ask for them, and hold this one until they arrive
+            RequestPayload=(uint32_t)Distance<<16;
+            SendCommand (&ClientAddress, CMD_RETRANSMIT_REQUEST, RXSequence, &RequestPayload, 1);
+            RetransmitPending=true;
+            RetransmitWaitMs=0;
+            HighestSequence=Sequence;
+        }
+        else if ((int16_t)(Sequence-HighestSequence)>0) HighestSequence=Sequence;
+
+        // Only the first command after the gap is held. Next ones come again by forward error correction or are
+        // asked again when the wait ends
+        if ((HeldValid==false)&&(NumWords<=NETUMP_MAX_RX_WORDS))
+        {
+            HeldValid=true;
+            HeldSequence=Sequence;
+            HeldWords=NumWords;
+            memcpy (HeldPayload, Payload, 4*NumWords);
+            HeldArrival=*Arrival;
+        }
+        return;
+    }
+
+    DeliverData (Payload, NumWords, Arrival, Callback, Instance);
+    RXSequence=Sequence+1;
+
+    if ((HeldValid)&&(HeldSequence==RXSequence))
+    {  // Gap is filled
+        DeliverData (HeldPayload, HeldWords, &HeldArrival, Callback, Instance);
+        RXSequence=HeldSequence+1;
+        HeldValid=false;
+    }
+    if ((RetransmitPending)&&((int16_t)(RXSequence-HighestSequence)>0)) RetransmitPending=false;
+}  // CNetUMP::ReceiveData
+//-----------------------------------------------------------------------------
+
+void CNetUMP::ProcessDatagram (const unsigned char* Data, unsigned int Size, const struct sockaddr_in* From, const struct timespec* Arrival, TUMPReceiveCallback* Callback, void* Instance)
+{
+    unsigned int Offset;
+    unsigned char Code;
+    unsigned int NumWords;
+    uint16_t SpecificData;
+    bool FromClient;
+    uint32_t Reply;
+
+    if ((Size<8)||(memcmp (Data, Signature, 4)!=0)) return;
+
+    FromClient=Connected&&SameAddress (From, &ClientAddress);
+    if (FromClient)
+    {
+        SilenceMs=0;
+        PingWaitMs=0;
+    }
+
+    Offset=4;
+    while (Offset+4<=Size)
+    {
+        Code=Data[Offset];
+        NumWords=Data[Offset+1];
+        SpecificData=(uint16_t)((Data[Offset+2]<<8)|Data[Offset+3]);
+        if (Offset+4+4*NumWords>Size) break;         // Truncated command
+
+        switch (Code)
+        {
+            case CMD_INVITATION :
+            case CMD_INVITATION_AUTH :
+            case CMD_INVITATION_USER_AUTH :
+                // Only one client : a new client is refused while the session is open
+                if ((Connected==false)||(FromClient)) AcceptInvitation (From);
+                else SendBye (From, BYE_TOO_MANY_SESSIONS);
+                FromClient=Connected&&SameAddress (From, &ClientAddress);
+                break;
+            case CMD_PING :
+                if (NumWords>=1)
+                {
+                    Reply=ReadWord (&Data[Offset+4]);
+                    SendCommand (From, CMD_PING_REPLY, 0, &Reply, 1);
+                }
+                break;
+            case CMD_PING_REPLY :
+                break;
+            case CMD_UMP_DATA :
+                if (FromClient) ReceiveData (SpecificData, &Data[Offset+4], NumWords, Arrival, Callback, Instance);
+                else SendBye (From, BYE_NOT_ESTABLISHED);
+                break;
+            case CMD_RETRANSMIT_REQUEST :
+                if ((FromClient)&&(NumWords>=1)) Retransmit (SpecificData, ReadWord (&Data[Offset+4])>>16);
+                break;
+            case CMD_RETRANSMIT_ERROR :
+                // Client can not resend the missing commands : command held is delivered at once
+                if (FromClient) AcceptGap (Callback, Instance);
+                break;
+            case CMD_SESSION_RESET :
+                if (FromClient)
+                {
+                    ResetSequences();
+                    SendCommand (From, CMD_SESSION_RESET_REPLY, 0, 0, 0);
+                }
+                break;
+            case CMD_BYE :
+                SendCommand (From, CMD_BYE_REPLY, 0, 0, 0);
+                if (FromClient)
+                {
+                    Connected=false;
+                    ResetSequences();
+                    FromClient=false;
+                    PostEvent (NETUMP_EVENT_BYE, &ClientAddress);
+                }
+                break;
+            case CMD_SESSION_RESET_REPLY :
+            case CMD_BYE_REPLY :
+            case CMD_NAK :
+                break;
+            default :
+                Reply=ReadWord (&Data[Offset]);
+                SendCommand (From, CMD_NAK, (uint16_t)(NAK_NOT_SUPPORTED<<8), &Reply, 1);
+                break;
+        }
+        Offset+=4+4*NumWords;
+    }
+}  // CNetUMP::ProcessDatagram
+//-----------------------------------------------------------------------------
+
+void CNetUMP::ProcessIncoming (TUMPReceiveCallback* Callback, void* Instance)
+{
+    int NumReceived;
+    int MsgNum;
+    struct cmsghdr* Control;
+    struct timespec Arrival;
+
+    if (Socket==-1) return;
+
+    do
+    {
+        // Lengths are overwritten by each call
+        for (MsgNum=0; MsgNum<NETUMP_RX_BATCH; MsgNum++)
+        {
+            RXMessages[MsgNum].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+            RXMessages[MsgNum].msg_hdr.msg_controllen=sizeof(RXControls[MsgNum]);
+            RXMessages[MsgNum].msg_hdr.msg_flags=0;
+        }
+
+        NumReceived=recvmmsg (Socket, RXMessages, NETUMP_RX_BATCH, MSG_DONTWAIT, 0);
+        if (NumReceived<=0) return;
+
+        for (MsgNum=0; MsgNum<NumReceived; MsgNum++)
+        {
+            Arrival.tv_sec=0;
+            Arrival.tv_nsec=0;
+            for (Control=CMSG_FIRSTHDR (&RXMessages[MsgNum].msg_hdr); Control!=0; Control=CMSG_NXTHDR (&RXMessages[MsgNum].msg_hdr, Control))
+            {
+                if ((Control->cmsg_level==SOL_SOCKET)&&(Control->cmsg_type==SCM_TIMESTAMPNS))
+                    memcpy (&Arrival, CMSG_DATA (Control), sizeof(Arrival));
+            }
+
+            ProcessDatagram (RXBuffers[MsgNum], RXMessages[MsgNum].msg_len, &RXAddresses[MsgNum], &Arrival, Callback, Instance);
+        }
+    } while (NumReceived==NETUMP_RX_BATCH);            // A partial batch means the socket is empty
+}  // CNetUMP::ProcessIncoming
+//-----------------------------------------------------------------------------
+
+void CNetUMP::RunTimers (unsigned int ElapsedMs, TUMPReceiveCallback* Callback, void* Instance)
+{
+    if (Connected==false) return;
+
+    SilenceMs+=ElapsedMs;
+    PingWaitMs+=ElapsedMs;
+    if (RetransmitPending)
+    {
+        RetransmitWaitMs+=ElapsedMs;
+        if (RetransmitWaitMs>=NETUMP_RETRANSMIT_MS) AcceptGap (Callback, Instance);
+    }
+
+    if (SilenceMs>=NETUMP_TIMEOUT_MS)
+    {
+        Disconnect (BYE_TIMEOUT);
+        return;
+    }
+
+    if ((SilenceMs>=NETUMP_PING_MS)&&(PingWaitMs>=NETUMP_PING_MS))
+    {
+        PingID++;
+        SendCommand (&ClientAddress, CMD_PING, 0, &PingID, 1);
+        PingWaitMs=0;
+    }
+}  // CNetUMP::RunTimers
+//-----------------------------------------------------------------------------
+
+bool CNetUMP::AppendUMP (const uint32_t* Words)
+{
+    unsigned int NumWords;
+    unsigned int WordNum;
+
+    if (Connected==false) return false;
+
+    NumWords=UMPWordCount (Words[0]);
+    if ((Pending!=0)&&(Pending->NumWords+NumWords>NETUMP_MAX_DATA_WORDS)) Flush();
+
+    if (Pending==0)
+    {  // New data command, stored in the history so it can be repeated and retransmitted
+        Pending=&History[TXSequence&(NETUMP_HISTORY-1)];
+        Pending->Sequence=TXSequence;
+        Pending->NumWords=0;
+    }
+
+    for (WordNum=0; WordNum<NumWords; WordNum++)
+        Pending->Words[Pending->NumWords+WordNum]=htonl (Words[WordNum]);
+    Pending->NumWords+=NumWords;
+    return true;
+}  // CNetUMP::AppendUMP
+//-----------------------------------------------------------------------------
+
+void CNetUMP::Flush (void)
+{
+    TNetUMPDataCommand* Command;
+    unsigned int Size;
+    unsigned int NumCommands;
+    unsigned int CommandNum;
+
+    if ((Pending==0)||(Connected==false)) return;
+
+    TXSequence++;
+    if (HistoryCount<NETUMP_HISTORY-1) HistoryCount++;           // Slot of the next command is not part of the history
+
+    // Previous commands are sent first, so the client gets them in sequence order
+    NumCommands=(HistoryCount<NETUMP_FEC_COMMANDS+1) ? HistoryCount : NETUMP_FEC_COMMANDS+1;
+    memcpy (&TXBuffer[0], Signature, 4);
+    Size=4;
+    for (CommandNum=NumCommands; CommandNum>0; CommandNum--)
+    {
+        Command=&History[(uint16_t)(TXSequence-CommandNum)&(NETUMP_HISTORY-1)];
+        if (Size+4+4*Command->NumWords>NETUMP_MAX_PACKET) continue;
+        TXBuffer[Size]=CMD_UMP_DATA;
+        TXBuffer[Size+1]=(unsigned char)Command->NumWords;
+        TXBuffer[Size+2]=(unsigned char)(Command->Sequence>>8);
+        TXBuffer[Size+3]=(unsigned char)Command->Sequence;
+        memcpy (&TXBuffer[Size+4], Command->Words, 4*Command->NumWords);
+        Size+=4+4*Command->NumWords;
+    }
+    QueuePacket (Size);
+    Pending=0;
+}  // CNetUMP::Flush
+//-----------------------------------------------------------------------------
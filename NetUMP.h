@@ -0,0 +1,194 @@
+/*
+ * File:   NetUMP.h
+ * Network MIDI 2.0 (UDP) endpoint transporting UMP packets
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Host side of a Network MIDI 2.0 UDP session : the endpoint waits for an invitation and accepts
+ one client at a time. Each UDP packet starts with the "MIDI" signature followed by command
+ packets : 8 bits command code, payload length in 32 bits words, 16 bits command specific data
+ and the payload. All words are big endian on the network.
+ UMP data commands are numbered. Each packet sent also carries the previous data commands
+ (forward error correction), and the last sent commands are kept to answer retransmit requests.
+ When a command is missing in the received sequence, a retransmit is requested and the command
+ which revealed the gap is held. The held command is delivered as soon as the gap is filled, or
+ when the missing commands do not arrive in time (they are then counted as lost).
+ No authentication and no discovery : the endpoint must be declared by hand in the client
+ */
+
+#ifndef __NETUMP_H__
+#define __NETUMP_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define NETUMP_MAX_PACKET       1400            // Size of UDP packets sent (bytes)
+#define NETUMP_MAX_DATA_WORDS   64              // Largest UMP payload of one data command sent
+#define NETUMP_MAX_RX_WORDS     255             // Largest payload of a received data command (8 bits length)
+#define NETUMP_FEC_COMMANDS     2               // Previous data commands repeated in each packet
+#define NETUMP_HISTORY          32              // Data commands kept for retransmission (power of two)
+#define NETUMP_NAME_LENGTH      64
+
+#define NETUMP_PING_MS          5000            // Silence before the client is pinged
+#define NETUMP_TIMEOUT_MS       20000           // Silence before the session is closed
+#define NETUMP_RETRANSMIT_MS    100             // Time given to the client to retransmit missing commands
+
+#define NETUMP_RX_BATCH         8               // Datagrams read by one recvmmsg call
+#define NETUMP_TX_BATCH         8               // Data packets sent by one sendmmsg call
+#define NETUMP_RX_SIZE          2048
+
+// Session state changes, posted by the realtime thread and reported by a normal priority thread
+#define NETUMP_EVENT_OPENED     1
+#define NETUMP_EVENT_CLOSED     2               // Closed by the endpoint (client silent)
+#define NETUMP_EVENT_BYE        3               // Closed by the client
+#define NETUMP_EVENTS           8               // Events waiting to be reported (power of two)
+
+typedef struct {
+    uint8_t Type;
+    struct in_addr Address;                     // Client
+    uint16_t Port;                              // Network order
+} TNetUMPEvent;
+
+// Called for each UMP packet received (words in host order, 1 to 4 words)
+// Arrival is the kernel receive time of the datagram (CLOCK_REALTIME), zero if the kernel did not give it
+typedef void (TUMPReceiveCallback)(void* Instance, const uint32_t* Words, const struct timespec* Arrival);
+
+typedef struct {
+    uint16_t Sequence;
+    uint16_t NumWords;
+    uint32_t Words[NETUMP_MAX_DATA_WORDS];      // Network order
+} TNetUMPDataCommand;
+
+class CNetUMP
+{
+public:
+    CNetUMP (void);
+    ~CNetUMP (void);
+
+    // Creates the UDP socket. Returns false if the socket can not be created or bound
+    bool Open (unsigned short LocalPort, const char* EndpointName, const char* ProductInstanceID);
+
+    // Sends a bye to the client and closes the socket
+    void Close (void);
+
+    int GetSocket (void)
+    {
+        return Socket;
+    }
+
+    bool IsConnected (void)
+    {
+        return Connected;
+    }
+
+    // Reads all packets waiting on the socket (by batches of NETUMP_RX_BATCH) and gives UMP packets received
+    // from the client to Callback
+    void ProcessIncoming (TUMPReceiveCallback* Callback, void* Instance);
+
+    // Advances ping, timeout and retransmit timers. A command held during a retransmit is given to Callback
+    // when the wait ends
+    void RunTimers (unsigned int ElapsedMs, TUMPReceiveCallback* Callback, void* Instance);
+
+    // Adds a UMP packet to the data command being built. The command is sent when full or when Flush is called
+    // Returns false if no client is connected
+    bool AppendUMP (const uint32_t* Words);
+
+    // Queues the data command being built. Queued packets are sent by SendQueued
+    void Flush (void);
+
+    // Sends all queued data packets with one system call
+    void SendQueued (void);
+
+    // Gives the next session state change (normal priority thread). Returns false if there is none
+    bool GetEvent (TNetUMPEvent* Event);
+
+    uint32_t LostCommands;                      // Data commands never received from the client
+
+private:
+    int Socket;
+    bool Connected;
+    struct sockaddr_in ClientAddress;
+    char EndpointName[NETUMP_NAME_LENGTH];
+    char ProductInstanceID[NETUMP_NAME_LENGTH];
+
+    uint16_t TXSequence;                        // Sequence number of next data command sent
+    TNetUMPDataCommand History[NETUMP_HISTORY]; // Last data commands sent (index = sequence & mask)
+    uint32_t HistoryCount;                      // Number of valid commands in History
+    TNetUMPDataCommand* Pending;                // Data command being built (in History)
+
+    uint16_t RXSequence;                        // Sequence number of next data command expected
+    bool RXSynced;
+    bool RetransmitPending;
+    unsigned int RetransmitWaitMs;
+    uint16_t HighestSequence;                   // Highest sequence number received during a retransmit
+    bool HeldValid;                             // A command received after a gap waits for the missing commands
+    uint16_t HeldSequence;
+    unsigned int HeldWords;
+    unsigned char HeldPayload[4*NETUMP_MAX_RX_WORDS];
+    struct timespec HeldArrival;
+    unsigned int SilenceMs;                     // Time since last packet from the client
+    unsigned int PingWaitMs;                    // Time since last ping sent
+    uint32_t PingID;
+
+    unsigned char TXBuffer[NETUMP_MAX_PACKET];
+
+    // State changes are not printed by the realtime thread : they wait in this ring (dropped when full)
+    TNetUMPEvent Events[NETUMP_EVENTS];
+    std::atomic<uint32_t> EventWrite;
+    std::atomic<uint32_t> EventRead;
+
+    // Data packets waiting for SendQueued
+    unsigned char TXQueue[NETUMP_TX_BATCH][NETUMP_MAX_PACKET];
+    unsigned int TXQueueSizes[NETUMP_TX_BATCH];
+    unsigned int TXQueueCount;
+
+    // recvmmsg buffers, one set per datagram of a batch
+    unsigned char RXBuffers[NETUMP_RX_BATCH][NETUMP_RX_SIZE];
+    struct sockaddr_in RXAddresses[NETUMP_RX_BATCH];
+    unsigned char RXControls[NETUMP_RX_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+    struct iovec RXVectors[NETUMP_RX_BATCH];
+    struct mmsghdr RXMessages[NETUMP_RX_BATCH];
+
+    void ResetSequences (void);
+    void PostEvent (uint8_t Type, const struct sockaddr_in* Client);
+    unsigned int AddCommand (unsigned int Offset, unsigned char Code, uint16_t SpecificData, const uint32_t* Payload, unsigned int NumWords);
+    void SendCommand (const struct sockaddr_in* To, unsigned char Code, uint16_t SpecificData, const uint32_t* Payload, unsigned int NumWords);
+    void SendBye (const struct sockaddr_in* To, unsigned char Reason);
+    void AcceptInvitation (const struct sockaddr_in* From);
+    void Disconnect (unsigned char Reason);
+    void Retransmit (uint16_t FirstSequence, unsigned int Count);
+    void QueuePacket (unsigned int Size);
+    void ProcessDatagram (const unsigned char* Data, unsigned int Size, const struct sockaddr_in* From, const struct timespec* Arrival, TUMPReceiveCallback* Callback, void* Instance);
+    void DeliverData (const unsigned char* Payload, unsigned int NumWords, const struct timespec* Arrival, TUMPReceiveCallback* Callback, void* Instance);
+    void AcceptGap (TUMPReceiveCallback* Callback, void* Instance);
+    void ReceiveData (uint16_t Sequence, const unsigned char* Payload, unsigned int NumWords, const struct timespec* Arrival, TUMPReceiveCallback* Callback, void* Instance);
+};
+
+#endif
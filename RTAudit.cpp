@@ -0,0 +1,249 @@
+/*
+ * File:   RTAudit.cpp
+ * Audit of calls forbidden in realtime threads (debug builds with __RT_AUDIT__)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef __RT_AUDIT__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "RTAudit.h"
+#include "RTSetup.h"
+
+// glibc allocator entry points, used to forward allocations without dlsym
+extern "C" void* __libc_malloc (size_t Size);
+extern "C" void* __libc_calloc (size_t Count, size_t Size);
+extern "C" void* __libc_realloc (void* Block, size_t Size);
+extern "C" void __libc_free (void* Block);
+
+typedef int (TVFPrintf)(FILE*, const char*, va_list);
+typedef int (TFPuts)(const char*, FILE*);
+typedef int (TPuts)(const char*);
+typedef FILE* (TFOpen)(const char*, const char*);
+typedef int (TMutexLock)(pthread_mutex_t*);
+typedef int (TNanoSleep)(const struct timespec*, struct timespec*);
+typedef int (TUSleep)(useconds_t);
+
+static TVFPrintf* RealVFPrintf=0;
+static TFPuts* RealFPuts=0;
+static TPuts* RealPuts=0;
+static TFOpen* RealFOpen=0;
+static TMutexLock* RealMutexLock=0;
+static TNanoSleep* RealNanoSleep=0;
+static TUSleep* RealUSleep=0;
+
+typedef struct {
+    std::atomic<bool> Ready;
+    const char* Function;
+    unsigned int Context;
+    int NumFrames;
+    void* Frames[AUDIT_MAX_FRAMES];
+} TAuditRecord;
+
+static TAuditRecord Records[AUDIT_MAX_RECORDS];
+static std::atomic<uint64_t> Violations (0);
+static unsigned int RecordsPrinted=0;
+static __thread bool InAudit=false;
+
+// Resolves a function of the next library defining it (libc)
+static void* FindReal (void** Pointer, const char* Name)
+{
+    if (*Pointer==0) *Pointer=dlsym (RTLD_NEXT, Name);
+    return *Pointer;
+}  // FindReal
+//-----------------------------------------------------------------------------
+
+// Records a violation if the calling thread is a realtime thread
+static void AuditCall (const char* Function, bool SleepCall)
+{
+    unsigned int Context;
+    uint64_t Index;
+    TAuditRecord* Record;
+
+    Context=GetRealtimeContext();
+    if (Context==RT_CONTEXT_NONE) return;
+    if (IsAllocationCheckArmed()==false) return;
+    if ((SleepCall)&&(Context!=RT_CONTEXT_JACK)) return;
+    if (InAudit) return;                    // Call made by the audit itself
+
+    InAudit=true;
+    Index=Violations.fetch_add (1, std::memory_order_relaxed);
+    if (Index<AUDIT_MAX_RECORDS)
+    {
+        Record=&Records[Index];
+        Record->Function=Function;
+        Record->Context=Context;
+        Record->NumFrames=backtrace (Record->Frames, AUDIT_MAX_FRAMES);
+        Record->Ready.store (true, std::memory_order_release);
+    }
+    InAudit=false;
+}  // AuditCall
+//-----------------------------------------------------------------------------
+
+void StartAudit (void)
+{
+    void* Frames[2];
+
+    FindReal ((void**)&RealVFPrintf, "vfprintf");
+    FindReal ((void**)&RealFPuts, "fputs");
+    FindReal ((void**)&RealPuts, "puts");
+    FindReal ((void**)&RealFOpen, "fopen");
+    FindReal ((void**)&RealMutexLock, "pthread_mutex_lock");
+    FindReal ((void**)&RealNanoSleep, "nanosleep");
+    FindReal ((void**)&RealUSleep, "usleep");
+
+    // First call of backtrace loads the unwinder (allocates) : done here, not in a realtime thread
+    backtrace (Frames, 2);
+}  // StartAudit
+//-----------------------------------------------------------------------------
+
+void PrintAuditReport (void)
+{
+    TAuditRecord* Record;
+
+    while (RecordsPrinted<AUDIT_MAX_RECORDS)
+    {
+        Record=&Records[RecordsPrinted];
+        if (Record->Ready.load (std::memory_order_acquire)==false) break;
+
+        fprintf (stderr, "jackrtpmidid : realtime audit : %s called from %s thread\n", Record->Function,
+                 (Record->Context==RT_CONTEXT_JACK) ? "JACK process" : "RTP-MIDI");
+        backtrace_symbols_fd (Record->Frames, Record->NumFrames, 2);
+        RecordsPrinted++;
+        if (RecordsPrinted==AUDIT_MAX_RECORDS)
+            fprintf (stderr, "jackrtpmidid : realtime audit : next violations are only counted\n");
+    }
+}  // PrintAuditReport
+//-----------------------------------------------------------------------------
+
+uint64_t GetAuditViolations (void)
+{
+    return Violations.load (std::memory_order_relaxed);
+}  // GetAuditViolations
+//-----------------------------------------------------------------------------
+
+// --- Interposed functions ---
+
+extern "C" void* malloc (size_t Size) noexcept
+{
+    AuditCall ("malloc", false);
+    return __libc_malloc (Size);
+}
+
+extern "C" void* calloc (size_t Count, size_t Size) noexcept
+{
+    AuditCall ("calloc", false);
+    return __libc_calloc (Count, Size);
+}
+
+extern "C" void* realloc (void* Block, size_t Size) noexcept
+{
+    AuditCall ("realloc", false);
+    return __libc_realloc (Block, Size);
+}
+
+extern "C" void free (void* Block) noexcept
+{
+    if (Block) AuditCall ("free", false);
+    __libc_free (Block);
+}
+
+extern "C" int printf (const char* Format, ...)
+{
+    va_list Args;
+    int Result;
+
+    AuditCall ("printf", false);
+    va_start (Args, Format);
+    Result=((TVFPrintf*)FindReal ((void**)&RealVFPrintf, "vfprintf"))(stdout, Format, Args);
+    va_end (Args);
+    return Result;
+}
+
+extern "C" int fprintf (FILE* Stream, const char* Format, ...)
+{
+    va_list Args;
+    int Result;
+
+    AuditCall ("fprintf", false);
+    va_start (Args, Format);
+    Result=((TVFPrintf*)FindReal ((void**)&RealVFPrintf, "vfprintf"))(Stream, Format, Args);
+    va_end (Args);
+    return Result;
+}
+
+extern "C" int vfprintf (FILE* Stream, const char* Format, va_list Args)
+{
+    AuditCall ("vfprintf", false);
+    return ((TVFPrintf*)FindReal ((void**)&RealVFPrintf, "vfprintf"))(Stream, Format, Args);
+}
+
+extern "C" int puts (const char* Text)
+{
+    AuditCall ("puts", false);
+    return ((TPuts*)FindReal ((void**)&RealPuts, "puts"))(Text);
+}
+
+extern "C" int fputs (const char* Text, FILE* Stream)
+{
+    AuditCall ("fputs", false);
+    return ((TFPuts*)FindReal ((void**)&RealFPuts, "fputs"))(Text, Stream);
+}
+
+extern "C" FILE* fopen (const char* Path, const char* Mode)
+{
+    AuditCall ("fopen", false);
+    return ((TFOpen*)FindReal ((void**)&RealFOpen, "fopen"))(Path, Mode);
+}
+
+extern "C" int pthread_mutex_lock (pthread_mutex_t* Mutex) noexcept
+{
+    AuditCall ("pthread_mutex_lock", false);
+    return ((TMutexLock*)FindReal ((void**)&RealMutexLock, "pthread_mutex_lock"))(Mutex);
+}
+
+extern "C" int nanosleep (const struct timespec* Request, struct timespec* Remain)
+{
+    AuditCall ("nanosleep", true);
+    return ((TNanoSleep*)FindReal ((void**)&RealNanoSleep, "nanosleep"))(Request, Remain);
+}
+
+extern "C" int usleep (useconds_t Micros)
+{
+    AuditCall ("usleep", true);
+    return ((TUSleep*)FindReal ((void**)&RealUSleep, "usleep"))(Micros);
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * File:   RTAudit.h
+ * Audit of calls forbidden in realtime threads (debug builds with __RT_AUDIT__)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ When the program is built with __RT_AUDIT__ defined (and linked with -rdynamic to get function
+ names), malloc / calloc / realloc / free, stdio output, fopen, mutex locks and sleeps are
+ interposed. A call made by a realtime thread (see EnterRealtimeContext) after the check is
+ armed is a violation : it is counted, and the call stack of the first violations is recorded
+ without allocation. The main thread prints the recorded violations.
+ Sleeps are only violations in the JACK process thread (the RTP-MIDI thread sleeps in polling mode).
+ Without __RT_AUDIT__, the functions below do nothing.
+ */
+
+#ifndef __RTAUDIT_H__
+#define __RTAUDIT_H__
+
+#include <stdint.h>
+
+#ifdef __RT_AUDIT__
+
+// Number of violations recorded with their call stack
+#define AUDIT_MAX_RECORDS       64
+#define AUDIT_MAX_FRAMES        24
+
+// Resolves the interposed functions. Must be called at startup, before realtime threads are created
+void StartAudit (void);
+
+// Prints the violations recorded since the previous call (main thread only)
+void PrintAuditReport (void);
+
+// Number of violations since the check was armed
+uint64_t GetAuditViolations (void);
+
+#else
+
+static inline void StartAudit (void) {}
+static inline void PrintAuditReport (void) {}
+static inline uint64_t GetAuditViolations (void) { return 0; }
+
+#endif
+
+#endif
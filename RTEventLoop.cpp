@@ -0,0 +1,347 @@
+/*
+ * File:   RTEventLoop.cpp
+ * Event driven wait loop for the RTP-MIDI realtime thread
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "RTEventLoop.h"
+
+// Tags stored in epoll event data to identify the descriptor
+#define TAG_DEADLINE    0xFFFFFFFC
+#define TAG_UMP         0xFFFFFFFD
+#define TAG_TIMER       0xFFFFFFFE
+#define TAG_OUTBOUND    0xFFFFFFFF
+
+// Number of descriptors read from epoll in one call (2 sockets per session + NetUMP socket + timers + eventfd)
+#define MAX_EPOLL_EVENTS    (2*MAX_LOOP_SESSIONS+4)
+
+CRTEventLoop::CRTEventLoop (void)
+{
+    unsigned int Session;
+
+    EpollFD=-1;
+    TimerFD=-1;
+    EventFD=-1;
+    DeadlineFD=-1;
+    DeadlineArmed.store (false);
+    TickPeriodNanos=0;
+    NextTickNanos=0;
+
+    for (Session=0; Session<MAX_LOOP_SESSIONS; Session++)
+    {
+        SessionSockets[Session][0]=-1;
+        SessionSockets[Session][1]=-1;
+    }
+}  // CRTEventLoop::CRTEventLoop
+//-----------------------------------------------------------------------------
+
+CRTEventLoop::~CRTEventLoop (void)
+{
+    // Sockets belong to the RTP-MIDI handlers, we only close our own descriptors
+    if (DeadlineFD!=-1) close (DeadlineFD);
+    if (EventFD!=-1) close (EventFD);
+    if (TimerFD!=-1) close (TimerFD);
+    if (EpollFD!=-1) close (EpollFD);
+}  // CRTEventLoop::~CRTEventLoop
+//-----------------------------------------------------------------------------
+
+bool CRTEventLoop::WatchSocket (int Socket, unsigned int Tag)
+{
+    struct epoll_event Event;
+
+    memset (&Event, 0, sizeof(Event));
+    Event.events=EPOLLIN;
+    Event.data.u32=Tag;
+    return (epoll_ctl (EpollFD, EPOLL_CTL_ADD, Socket, &Event)==0);
+}  // CRTEventLoop::WatchSocket
+//-----------------------------------------------------------------------------
+
+// Returns CLOCK_MONOTONIC time in nanoseconds
+static uint64_t MonotonicNanos (void)
+{
+    struct timespec Now;
+
+    clock_gettime (CLOCK_MONOTONIC, &Now);
+    return ((uint64_t)Now.tv_sec*1000000000ull)+(uint64_t)Now.tv_nsec;
+}  // MonotonicNanos
+//-----------------------------------------------------------------------------
+
+bool CRTEventLoop::Init (unsigned int TickPeriodMicros)
+{
+    struct itimerspec TimerSpec;
+
+    EpollFD=epoll_create1 (EPOLL_CLOEXEC);
+    if (EpollFD==-1) return false;
+
+    TimerFD=timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if (TimerFD==-1) return false;
+
+    EventFD=eventfd (0, EFD_NONBLOCK|EFD_CLOEXEC);
+    if (EventFD==-1) return false;
+
+    // One shot timer armed by SignalOutboundAt
+    DeadlineFD=timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if (DeadlineFD==-1) return false;
+
+    // Timer is armed on an absolute time grid, so the lateness of each wake up can be measured
+    TickPeriodNanos=(uint64_t)TickPeriodMicros*1000;
+    NextTickNanos=MonotonicNanos()+TickPeriodNanos;
+    TimerSpec.it_interval.tv_sec=TickPeriodMicros/1000000;
+    TimerSpec.it_interval.tv_nsec=(TickPeriodMicros%1000000)*1000;
+    TimerSpec.it_value.tv_sec=NextTickNanos/1000000000ull;
+    TimerSpec.it_value.tv_nsec=NextTickNanos%1000000000ull;
+    if (timerfd_settime (TimerFD, TFD_TIMER_ABSTIME, &TimerSpec, NULL)!=0) return false;
+
+    if (WatchSocket (TimerFD, TAG_TIMER)==false) return false;
+    if (WatchSocket (EventFD, TAG_OUTBOUND)==false) return false;
+    if (WatchSocket (DeadlineFD, TAG_DEADLINE)==false) return false;
+
+    return true;
+}  // CRTEventLoop::Init
+//-----------------------------------------------------------------------------
+
+bool CRTEventLoop::AddSession (unsigned int SessionIndex, unsigned short LocalCtrlPort, unsigned short LocalDataPort)
+{
+    int CtrlSocket, DataSocket;
+    int One=1;
+
+    if (SessionIndex>=MAX_LOOP_SESSIONS) return false;
+    if (EpollFD==-1) return false;
+
+    CtrlSocket=FindUDPSocket (LocalCtrlPort);
+    DataSocket=FindUDPSocket (LocalDataPort);
+    if ((CtrlSocket==-1)||(DataSocket==-1)) return false;
+
+    if (WatchSocket (CtrlSocket, SessionIndex)==false) return false;
+    if (WatchSocket (DataSocket, SessionIndex)==false)
+    {
+        epoll_ctl (EpollFD, EPOLL_CTL_DEL, CtrlSocket, NULL);
+        return false;
+    }
+
+    SessionSockets[SessionIndex][0]=CtrlSocket;
+    SessionSockets[SessionIndex][1]=DataSocket;
+
+    // Kernel receive time of RTP packets is read when they are peeked (the handler itself ignores it)
+    setsockopt (DataSocket, SOL_SOCKET, SO_TIMESTAMPNS, &One, sizeof(One));
+    return true;
+}  // CRTEventLoop::AddSession
+//-----------------------------------------------------------------------------
+
+bool CRTEventLoop::AddUMPSocket (int Socket)
+{
+    if ((EpollFD==-1)||(Socket==-1)) return false;
+    return WatchSocket (Socket, TAG_UMP);
+}  // CRTEventLoop::AddUMPSocket
+//-----------------------------------------------------------------------------
+
+void CRTEventLoop::RemoveSession (unsigned int SessionIndex)
+{
+    unsigned int SocketNum;
+
+    if (SessionIndex>=MAX_LOOP_SESSIONS) return;
+
+    for (SocketNum=0; SocketNum<2; SocketNum++)
+    {
+        if (SessionSockets[SessionIndex][SocketNum]!=-1)
+        {
+            epoll_ctl (EpollFD, EPOLL_CTL_DEL, SessionSockets[SessionIndex][SocketNum], NULL);
+            SessionSockets[SessionIndex][SocketNum]=-1;
+        }
+    }
+}  // CRTEventLoop::RemoveSession
+//-----------------------------------------------------------------------------
+
+void CRTEventLoop::PauseSession (unsigned int SessionIndex, bool Paused)
+{
+    struct epoll_event Event;
+    unsigned int SocketNum;
+
+    if (SessionIndex>=MAX_LOOP_SESSIONS) return;
+
+    memset (&Event, 0, sizeof(Event));
+    if (Paused==false) Event.events=EPOLLIN;
+    Event.data.u32=SessionIndex;
+    for (SocketNum=0; SocketNum<2; SocketNum++)
+    {
+        if (SessionSockets[SessionIndex][SocketNum]!=-1)
+            epoll_ctl (EpollFD, EPOLL_CTL_MOD, SessionSockets[SessionIndex][SocketNum], &Event);
+    }
+}  // CRTEventLoop::PauseSession
+//-----------------------------------------------------------------------------
+
+bool CRTEventLoop::Wait (TRTLoopEvents* Events)
+{
+    struct epoll_event EpollEvents[MAX_EPOLL_EVENTS];
+    int NumEvents;
+    int EventNum;
+    uint64_t Counter;
+    uint64_t Now;
+    unsigned int Tag;
+
+    Events->ReadyMask=0;
+    Events->NumTicks=0;
+    Events->OutboundPending=false;
+    Events->WakeLatencyMicros=0;
+    Events->UMPReady=false;
+
+    // The timer is always armed, so the wait never lasts more than one tick
+    NumEvents=epoll_wait (EpollFD, &EpollEvents[0], MAX_EPOLL_EVENTS, -1);
+    if (NumEvents<0) return false;          // EINTR included : caller loops anyway
+
+    for (EventNum=0; EventNum<NumEvents; EventNum++)
+    {
+        Tag=EpollEvents[EventNum].data.u32;
+        if (Tag==TAG_TIMER)
+        {
+            if (read (TimerFD, &Counter, sizeof(Counter))==sizeof(Counter))
+            {
+                Events->NumTicks=(unsigned int)Counter;
+                // Latest expiry is NextTick+(Counter-1)*Period
+                NextTickNanos+=Counter*TickPeriodNanos;
+                Now=MonotonicNanos();
+                if (Now+TickPeriodNanos>NextTickNanos)
+                    Events->WakeLatencyMicros=(unsigned int)((Now+TickPeriodNanos-NextTickNanos)/1000);
+            }
+        }
+        else if (Tag==TAG_OUTBOUND)
+        {
+            if (read (EventFD, &Counter, sizeof(Counter))==sizeof(Counter))
+                Events->OutboundPending=true;
+        }
+        else if (Tag==TAG_DEADLINE)
+        {
+            if (read (DeadlineFD, &Counter, sizeof(Counter))==sizeof(Counter))
+            {
+                // Cleared before the caller sends, so data committed after this point arms a new deadline
+                DeadlineArmed.store (false, std::memory_order_release);
+                Events->OutboundPending=true;
+            }
+        }
+        else if (Tag==TAG_UMP)
+        {
+            Events->UMPReady=true;
+        }
+        else if (Tag<MAX_LOOP_SESSIONS)
+        {
+            Events->ReadyMask|=(1u<<Tag);
+        }
+    }
+
+    return true;
+}  // CRTEventLoop::Wait
+//-----------------------------------------------------------------------------
+
+void CRTEventLoop::SignalOutbound (void)
+{
+    uint64_t One=1;
+    ssize_t Written;
+
+    if (EventFD==-1) return;
+    // Non blocking : if the counter is already high, the loop is already going to wake up
+    Written=write (EventFD, &One, sizeof(One));
+    (void)Written;
+}  // CRTEventLoop::SignalOutbound
+//-----------------------------------------------------------------------------
+
+void CRTEventLoop::SignalOutboundAt (uint64_t DeadlineNanos)
+{
+    struct itimerspec TimerSpec;
+
+    if (DeadlineFD==-1)
+    {
+        SignalOutbound();
+        return;
+    }
+
+    // Data committed before an earlier deadline is sent with it
+    if (DeadlineArmed.exchange (true, std::memory_order_acq_rel)) return;
+
+    // An absolute time already passed makes the timer expire immediately
+    memset (&TimerSpec, 0, sizeof(TimerSpec));
+    TimerSpec.it_value.tv_sec=DeadlineNanos/1000000000ull;
+    TimerSpec.it_value.tv_nsec=DeadlineNanos%1000000000ull;
+    if (timerfd_settime (DeadlineFD, TFD_TIMER_ABSTIME, &TimerSpec, NULL)!=0)
+    {
+        DeadlineArmed.store (false, std::memory_order_release);
+        SignalOutbound();
+    }
+}  // CRTEventLoop::SignalOutboundAt
+//-----------------------------------------------------------------------------
+
+int FindUDPSocket (unsigned short LocalPort)
+{
+    DIR* FDDir;
+    struct dirent* Entry;
+    int FD;
+    int Found=-1;
+    int SockType;
+    socklen_t OptLen;
+    struct sockaddr_in Address;
+    socklen_t AddrLen;
+
+    // RTP-MIDI handlers do not expose their sockets, so we look for them in our own descriptor table
+    FDDir=opendir ("/proc/self/fd");
+    if (FDDir==0) return -1;
+
+    while ((Entry=readdir (FDDir))!=0)
+    {
+        if (Entry->d_name[0]=='.') continue;
+        FD=atoi (Entry->d_name);
+        if (FD==dirfd (FDDir)) continue;
+
+        OptLen=sizeof(SockType);
+        if (getsockopt (FD, SOL_SOCKET, SO_TYPE, &SockType, &OptLen)!=0) continue;  // Not a socket
+        if (SockType!=SOCK_DGRAM) continue;
+
+        AddrLen=sizeof(Address);
+        if (getsockname (FD, (struct sockaddr*)&Address, &AddrLen)!=0) continue;
+        if (Address.sin_family!=AF_INET) continue;
+
+        if (ntohs (Address.sin_port)==LocalPort)
+        {
+            Found=FD;
+            break;
+        }
+    }
+
+    closedir (FDDir);
+    return Found;
+}  // FindUDPSocket
+//-----------------------------------------------------------------------------
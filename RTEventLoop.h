@@ -0,0 +1,113 @@
+/*
+ * File:   RTEventLoop.h
+ * Event driven wait loop for the RTP-MIDI realtime thread
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __RTEVENTLOOP_H__
+#define __RTEVENTLOOP_H__
+
+#include <stdint.h>
+#include <atomic>
+
+// Maximum number of RTP-MIDI sessions that can be watched by the loop (one bit per session in ReadyMask)
+#define MAX_LOOP_SESSIONS       32
+
+// Period of the timer driving RunSession timers (the RTP-MIDI library counts its timeouts in calls)
+#define SESSION_TICK_MICROS     1000
+
+typedef struct {
+    unsigned int ReadyMask;         // Bit n set when a socket of session n has data waiting
+    unsigned int NumTicks;          // Number of timer periods elapsed since previous wait
+    bool OutboundPending;           // jack_process has queued data for the network (or its send deadline is reached)
+    unsigned int WakeLatencyMicros; // Time between timer expiry and end of wait (valid if NumTicks>0)
+    bool UMPReady;                  // NetUMP socket has data waiting
+} TRTLoopEvents;
+
+class CRTEventLoop
+{
+public:
+    CRTEventLoop (void);
+    ~CRTEventLoop (void);
+
+    // Creates epoll, timer and event descriptors. Returns false if one of them can not be created
+    bool Init (unsigned int TickPeriodMicros);
+
+    // Watch the control and data sockets bound to the given local ports for session number SessionIndex
+    // Returns false if the sockets can not be found : the session is then only serviced by the timer
+    bool AddSession (unsigned int SessionIndex, unsigned short LocalCtrlPort, unsigned short LocalDataPort);
+
+    // Watch the socket of the NetUMP endpoint
+    bool AddUMPSocket (int Socket);
+
+    // Remove the sockets of a session from the watch list
+    void RemoveSession (unsigned int SessionIndex);
+
+    // Stop (or start again) reporting the sockets of a session in ReadyMask. Sockets stay in the watch list
+    void PauseSession (unsigned int SessionIndex, bool Paused);
+
+    // Block until a socket is readable, the timer expires or outbound data is signalled
+    // Returns false if waiting failed (Events is then cleared)
+    bool Wait (TRTLoopEvents* Events);
+
+    // Wake up the loop. Can be called from JACK process callback (non blocking, no allocation)
+    void SignalOutbound (void);
+
+    // Wake up the loop at a CLOCK_MONOTONIC time (now if the time is already passed). Can be called from JACK
+    // process callback. If a deadline is already pending, it is kept (data is sent at the earliest deadline)
+    void SignalOutboundAt (uint64_t DeadlineNanos);
+
+    // True from SignalOutboundAt until the wake up at the deadline
+    bool DeadlinePending (void)
+    {
+        return DeadlineArmed.load (std::memory_order_acquire);
+    }
+
+    // Data socket of a session, or -1 if the session is not watched
+    int GetDataSocket (unsigned int SessionIndex)
+    {
+        if (SessionIndex>=MAX_LOOP_SESSIONS) return -1;
+        return SessionSockets[SessionIndex][1];
+    }
+
+private:
+    int EpollFD;
+    int TimerFD;
+    int EventFD;
+    int DeadlineFD;
+    std::atomic<bool> DeadlineArmed;
+    int SessionSockets[MAX_LOOP_SESSIONS][2];
+    uint64_t TickPeriodNanos;
+    uint64_t NextTickNanos;         // CLOCK_MONOTONIC time of next timer expiry
+
+    bool WatchSocket (int Socket, unsigned int Tag);
+};
+
+// Search among the process file descriptors the UDP socket bound to LocalPort
+// Returns -1 if no socket is found
+int FindUDPSocket (unsigned short LocalPort);
+
+#endif
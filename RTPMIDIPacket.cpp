@@ -0,0 +1,122 @@
+/*
+ * File:   RTPMIDIPacket.cpp
+ * RTP-MIDI command list builder (delta-times and running status)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "RTPMIDIPacket.h"
+
+CRTPMIDIPacket::CRTPMIDIPacket (void)
+{
+    SampleRate=48000;
+    OriginSet=false;
+    Origin=0;
+    Clear();
+}  // CRTPMIDIPacket::CRTPMIDIPacket
+//-----------------------------------------------------------------------------
+
+void CRTPMIDIPacket::SetSampleRate (unsigned int Rate)
+{
+    if (Rate!=0) SampleRate=Rate;
+}  // CRTPMIDIPacket::SetSampleRate
+//-----------------------------------------------------------------------------
+
+void CRTPMIDIPacket::SetOrigin (uint32_t Frame)
+{
+    Origin=Frame;
+    OriginSet=true;
+}  // CRTPMIDIPacket::SetOrigin
+//-----------------------------------------------------------------------------
+
+void CRTPMIDIPacket::Clear (void)
+{
+    Size=0;
+    ListOrigin=0;
+    TicksInList=0;
+    RunningStatus=0;
+}  // CRTPMIDIPacket::Clear
+//-----------------------------------------------------------------------------
+
+bool CRTPMIDIPacket::Append (uint32_t Time, const unsigned char* Message, unsigned int Length, bool Continuation, bool Continues)
+{
+    int32_t Frames;
+    uint32_t Ticks;
+    uint32_t Delta=0;
+    unsigned char Status;
+
+    if (Length==0) return true;
+    if (Size+Length+RTP_MIDI_COMMAND_OVERHEAD>RTP_MIDI_MAX_LIST) return false;
+
+    if (Size==0)
+    {
+        ListOrigin=Time;
+        if ((OriginSet)&&((int32_t)(Time-Origin)>0)) ListOrigin=Origin;
+        TicksInList=0;
+    }
+
+    // Delta-times are computed from the origin of the list, so rounding errors do not accumulate
+    Frames=(int32_t)(Time-ListOrigin);
+    if (Frames<0) Frames=0;
+    Ticks=(uint32_t)(((uint64_t)Frames*RTP_TIMESTAMP_RATE)/SampleRate);
+    if (Ticks>TicksInList) Delta=Ticks-TicksInList;
+    TicksInList+=Delta;
+
+    // Delta-time : 1 to 4 bytes, 7 bits per byte, bit 7 set on all bytes but the last
+    if (Delta>0x0FFFFFFF) Delta=0x0FFFFFFF;
+    if (Delta>=0x200000) Data[Size++]=0x80|(Delta>>21);
+    if (Delta>=0x4000) Data[Size++]=0x80|((Delta>>14)&0x7F);
+    if (Delta>=0x80) Data[Size++]=0x80|((Delta>>7)&0x7F);
+    Data[Size++]=Delta&0x7F;
+
+    Status=Message[0];
+    if (Continuation)
+    {
+        Data[Size++]=0xF7;
+        RunningStatus=0;
+    }
+    else if ((Status>=0x80)&&(Status<0xF0))
+    {  // Channel message : status byte is omitted when it is the same as previous one
+        if (Status==RunningStatus)
+        {
+            Message++;
+            Length--;
+        }
+        RunningStatus=Status;
+    }
+    else if (Status<0xF8)
+    {  // SYSEX and system common messages cancel running status (realtime messages do not)
+        RunningStatus=0;
+    }
+
+    memcpy (&Data[Size], Message, Length);
+    Size+=Length;
+    if (Continues) Data[Size++]=0xF0;
+
+    return true;
+}  // CRTPMIDIPacket::Append
+//-----------------------------------------------------------------------------
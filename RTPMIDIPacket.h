@@ -0,0 +1,92 @@
+/*
+ * File:   RTPMIDIPacket.h
+ * RTP-MIDI command list builder (delta-times and running status)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Builds the MIDI command list of one RTP-MIDI packet (RFC6295) from several MIDI events.
+ Each command is preceded by its delta-time (RTP timestamp units, relative to the previous
+ command) and channel messages use running status when possible.
+ The delta-time of the first command is counted from the origin of the packet : the frame time
+ represented by the RTP timestamp of the packet. Events from successive packets then keep their
+ spacing, whatever the time at which each packet is sent.
+ Without origin (or for an event older than the origin) the first delta-time is null.
+ The first command always includes its status byte.
+ */
+
+#ifndef __RTPMIDIPACKET_H__
+#define __RTPMIDIPACKET_H__
+
+#include <stdint.h>
+
+// Clock rate of RTP-MIDI timestamps and delta-times (100us units)
+#define RTP_TIMESTAMP_RATE      10000
+
+// Largest MIDI command list sent in one packet (keeps the packet in a single Ethernet / Wi-Fi frame)
+#define RTP_MIDI_MAX_LIST       1024
+
+// Longest delta-time encoding + F7 prefix + F0 suffix
+#define RTP_MIDI_COMMAND_OVERHEAD   6
+
+class CRTPMIDIPacket
+{
+public:
+    CRTPMIDIPacket (void);
+
+    // Sample rate of the event times given to Append
+    void SetSampleRate (unsigned int Rate);
+
+    // Frame time represented by the RTP timestamp of the next packets. Kept until next call
+    void SetOrigin (uint32_t Frame);
+
+    // Starts a new command list
+    void Clear (void);
+
+    bool IsEmpty (void)
+    {
+        return Size==0;
+    }
+
+    // Appends a MIDI message or a SYSEX segment. Time is in frames and must not decrease within a list
+    // Continuation : data are the continuation of a SYSEX (F7 is added before them)
+    // Continues : the SYSEX continues in next segment (F0 is added after the data)
+    // Returns false if the list has not enough room left (the list is not modified)
+    bool Append (uint32_t Time, const unsigned char* Message, unsigned int Length, bool Continuation, bool Continues);
+
+    unsigned int Size;                  // Number of bytes in Data
+    unsigned char Data[RTP_MIDI_MAX_LIST];
+
+private:
+    unsigned int SampleRate;
+    bool OriginSet;
+    uint32_t Origin;                    // Given by SetOrigin
+    uint32_t ListOrigin;                // Frame time from which the delta-times of the list are counted
+    uint32_t TicksInList;               // Sum of the delta-times already in the list
+    unsigned char RunningStatus;        // 0 when next channel message must include its status byte
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * File:   RTSetup.cpp
+ * CPU affinity, memory locking and allocation checks for realtime threads
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <new>
+
+#include "RTSetup.h"
+
+static __thread unsigned int RealtimeContext=RT_CONTEXT_NONE;
+static std::atomic<bool> CheckArmed (false);
+static std::atomic<uint64_t> RealtimeAllocations (0);
+
+bool ParseCPUList (const char* List, cpu_set_t* CPUSet)
+{
+    char* End;
+    long First;
+    long Last;
+
+    CPU_ZERO (CPUSet);
+    while (*List!=0)
+    {
+        First=strtol (List, &End, 10);
+        if ((End==List)||(First<0)||(First>=CPU_SETSIZE)) return false;
+        Last=First;
+        List=End;
+        if (*List=='-')
+        {
+            List++;
+            Last=strtol (List, &End, 10);
+            if ((End==List)||(Last<First)||(Last>=CPU_SETSIZE)) return false;
+            List=End;
+        }
+        for (; First<=Last; First++) CPU_SET (First, CPUSet);
+
+        if (*List==',') List++;
+        else if (*List!=0) return false;
+    }
+    return CPU_COUNT (CPUSet)>0;
+}  // ParseCPUList
+//-----------------------------------------------------------------------------
+
+bool PinCurrentThread (const cpu_set_t* CPUSet)
+{
+    return pthread_setaffinity_np (pthread_self(), sizeof(cpu_set_t), CPUSet)==0;
+}  // PinCurrentThread
+//-----------------------------------------------------------------------------
+
+bool LockProcessMemory (void)
+{
+    // Freed memory stays in the process (no trimming, no separate mapping for big blocks)
+    mallopt (M_TRIM_THRESHOLD, -1);
+    mallopt (M_MMAP_MAX, 0);
+
+    return mlockall (MCL_CURRENT|MCL_FUTURE)==0;
+}  // LockProcessMemory
+//-----------------------------------------------------------------------------
+
+void PrefaultStack (void)
+{
+    unsigned char Dummy[RT_STACK_PREFAULT];
+
+    memset (Dummy, 0, sizeof(Dummy));
+    // Keeps the compiler from removing the array
+    __asm__ __volatile__ ("" : : "r" (Dummy) : "memory");
+}  // PrefaultStack
+//-----------------------------------------------------------------------------
+
+void EnterRealtimeContext (unsigned int Context)
+{
+    RealtimeContext=Context;
+}  // EnterRealtimeContext
+//-----------------------------------------------------------------------------
+
+unsigned int GetRealtimeContext (void)
+{
+    return RealtimeContext;
+}  // GetRealtimeContext
+//-----------------------------------------------------------------------------
+
+void ArmAllocationCheck (void)
+{
+    RealtimeAllocations.store (0);
+    CheckArmed.store (true);
+}  // ArmAllocationCheck
+//-----------------------------------------------------------------------------
+
+bool IsAllocationCheckArmed (void)
+{
+    return CheckArmed.load (std::memory_order_relaxed);
+}  // IsAllocationCheckArmed
+//-----------------------------------------------------------------------------
+
+uint64_t GetRealtimeAllocations (void)
+{
+    return RealtimeAllocations.load (std::memory_order_relaxed);
+}  // GetRealtimeAllocations
+//-----------------------------------------------------------------------------
+
+uint64_t GetThreadPageFaults (void)
+{
+    struct rusage Usage;
+
+    if (getrusage (RUSAGE_THREAD, &Usage)!=0) return 0;
+    return (uint64_t)Usage.ru_minflt+(uint64_t)Usage.ru_majflt;
+}  // GetThreadPageFaults
+//-----------------------------------------------------------------------------
+
+// Global allocation operators : count allocations made by realtime threads
+static void* CountedAlloc (size_t Size)
+{
+    void* Block;
+
+    if ((RealtimeContext!=RT_CONTEXT_NONE)&&(CheckArmed.load (std::memory_order_relaxed)))
+        RealtimeAllocations.fetch_add (1, std::memory_order_relaxed);
+
+    Block=malloc (Size ? Size : 1);
+    if (Block==0) throw std::bad_alloc();
+    return Block;
+}  // CountedAlloc
+//-----------------------------------------------------------------------------
+
+void* operator new (size_t Size)
+{
+    return CountedAlloc (Size);
+}
+//-----------------------------------------------------------------------------
+
+void* operator new[] (size_t Size)
+{
+    return CountedAlloc (Size);
+}
+//-----------------------------------------------------------------------------
+
+void operator delete (void* Block) noexcept
+{
+    free (Block);
+}
+//-----------------------------------------------------------------------------
+
+void operator delete[] (void* Block) noexcept
+{
+    free (Block);
+}
+//-----------------------------------------------------------------------------
+
+// Sized forms are used by C++14 compilers : they must release through free too
+void operator delete (void* Block, size_t Size) noexcept
+{
+    (void)Size;
+    free (Block);
+}
+//-----------------------------------------------------------------------------
+
+void operator delete[] (void* Block, size_t Size) noexcept
+{
+    (void)Size;
+    free (Block);
+}
+//-----------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+/*
+ * File:   RTSetup.h
+ * CPU affinity, memory locking and allocation checks for realtime threads
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Memory is locked with mlockall (current and future mappings), and malloc is told to never give
+ memory back to the system, so a buffer freed and allocated again does not fault.
+ Threads doing realtime work (RTP-MIDI thread, JACK process thread) declare themselves with
+ EnterRealtimeContext (also used by the realtime audit, see RTAudit.h). Once the check is armed (after JACK activation), any C++ allocation
+ made by these threads is counted, so allocations in the realtime path can be detected.
+ */
+
+#ifndef __RTSETUP_H__
+#define __RTSETUP_H__
+
+#include <stdint.h>
+#include <sched.h>
+
+// Stack touched by a realtime thread when it starts (bytes)
+#define RT_STACK_PREFAULT       (128*1024)
+
+// Realtime contexts of threads
+#define RT_CONTEXT_NONE         0
+#define RT_CONTEXT_JACK         1               // JACK process thread
+#define RT_CONTEXT_SESSIONS     2               // RTP-MIDI thread
+
+// Parses a list of CPU numbers and ranges ("3", "2,3", "0-1"). Returns false if the list is invalid
+bool ParseCPUList (const char* List, cpu_set_t* CPUSet);
+
+// Pins the calling thread on the CPUs of the set. Returns false on error
+bool PinCurrentThread (const cpu_set_t* CPUSet);
+
+// Locks all current and future memory of the process. Returns false if memory can not be locked
+bool LockProcessMemory (void);
+
+// Touches the stack of the calling thread, so the pages are mapped before realtime work starts
+void PrefaultStack (void);
+
+// Declares the calling thread as a realtime thread for the allocation check
+void EnterRealtimeContext (unsigned int Context);
+
+// Realtime context of the calling thread (RT_CONTEXT_NONE for other threads)
+unsigned int GetRealtimeContext (void);
+
+// Starts counting allocations made by realtime threads
+void ArmAllocationCheck (void);
+
+bool IsAllocationCheckArmed (void);
+
+// Number of allocations made by realtime threads since the check was armed
+uint64_t GetRealtimeAllocations (void);
+
+// Minor and major page faults of the calling thread since it started
+uint64_t GetThreadPageFaults (void);
+
+#endif
@@ -0,0 +1,462 @@
+/*
+ * File:   RecoveryJournal.cpp
+ * Recovery from lost RTP-MIDI packets (RFC6295 recovery journal)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "RecoveryJournal.h"
+
+// Table of contents of a channel journal
+#define CHAPTER_P       0x80
+#define CHAPTER_C       0x40
+#define CHAPTER_M       0x20
+#define CHAPTER_W       0x10
+#define CHAPTER_N       0x08
+
+#define NOTE_IS_ON(Table, Channel, Note)    ((Table[Channel][(Note)>>5]&(1u<<((Note)&31)))!=0)
+#define SET_NOTE_ON(Table, Channel, Note)   Table[Channel][(Note)>>5]|=(1u<<((Note)&31))
+#define SET_NOTE_OFF(Table, Channel, Note)  Table[Channel][(Note)>>5]&=~(1u<<((Note)&31))
+
+CRecoveryJournal::CRecoveryJournal (void)
+{
+    LostPackets=0;
+    Reset();
+}  // CRecoveryJournal::CRecoveryJournal
+//-----------------------------------------------------------------------------
+
+void CRecoveryJournal::Reset (void)
+{
+    SeqValid=false;
+    ExpectedSeq=0;
+    PeerSSRC=0;
+    memset (&NotesOn[0][0], 0, sizeof(NotesOn));
+    memset (&Controllers[0][0], 0xFF, sizeof(Controllers));
+    memset (&Programs[0], 0xFF, sizeof(Programs));
+    memset (&PitchBend[0], 0xFF, sizeof(PitchBend));
+}  // CRecoveryJournal::Reset
+//-----------------------------------------------------------------------------
+
+void CRecoveryJournal::TrackCommand (const unsigned char* Data, unsigned int Size)
+{
+    unsigned int Channel;
+
+    if ((Size<2)||(Data[0]<0x80)||(Data[0]>=0xF0)) return;
+    Channel=Data[0]&0x0F;
+
+    switch (Data[0]&0xF0)
+    {
+        case 0x80 :
+            SET_NOTE_OFF (NotesOn, Channel, Data[1]&0x7F);
+            break;
+        case 0x90 :
+            if (Size<3) break;
+            if (Data[2]!=0) SET_NOTE_ON (NotesOn, Channel, Data[1]&0x7F);
+            else SET_NOTE_OFF (NotesOn, Channel, Data[1]&0x7F);
+            break;
+        case 0xB0 :
+            if (Size<3) break;
+            Controllers[Channel][Data[1]&0x7F]=Data[2]&0x7F;
+            if ((Data[1]==120)||(Data[1]==123))
+                memset (&NotesOn[Channel][0], 0, sizeof(NotesOn[Channel]));
+            break;
+        case 0xC0 :
+            Programs[Channel]=Data[1]&0x7F;
+            break;
+        case 0xE0 :
+            if (Size<3) break;
+            PitchBend[Channel]=(Data[1]&0x7F)|((Data[2]&0x7F)<<7);
+            break;
+    }
+}  // CRecoveryJournal::TrackCommand
+//-----------------------------------------------------------------------------
+
+void CRecoveryJournal::Emit (unsigned char Status, unsigned char Data1, unsigned char Data2, TJournalOutput* Output, void* Instance)
+{
+    unsigned char Message[3];
+    unsigned int Size;
+
+    Message[0]=Status;
+    Message[1]=Data1;
+    Message[2]=Data2;
+    Size=((Status&0xF0)==0xC0) ? 2 : 3;
+
+    TrackCommand (Message, Size);
+    Output (Instance, Message, Size);
+}  // CRecoveryJournal::Emit
+//-----------------------------------------------------------------------------
+
+unsigned int CRecoveryJournal::ProcessPacket (const unsigned char* Packet, unsigned int Size, TJournalOutput* Output, void* Instance)
+{
+    uint16_t Seq;
+    uint32_t SSRC;
+    int16_t Gap;
+    unsigned int Pos;
+    unsigned int Length;
+    unsigned char Header;
+
+    // RTP version 2 only (Apple session commands start with FF FF)
+    if ((Size<13)||((Packet[0]&0xC0)!=0x80)) return 0;
+
+    Seq=(Packet[2]<<8)|Packet[3];
+    SSRC=((uint32_t)Packet[8]<<24)|((uint32_t)Packet[9]<<16)|((uint32_t)Packet[10]<<8)|(uint32_t)Packet[11];
+
+    if ((SeqValid==false)||(SSRC!=PeerSSRC))
+    {  // First packet from this sender : nothing to compare with
+        if ((SeqValid)&&(SSRC!=PeerSSRC)) Reset();
+        SeqValid=true;
+        PeerSSRC=SSRC;
+        ExpectedSeq=Seq+1;
+        return 0;
+    }
+
+    Gap=(int16_t)(Seq-ExpectedSeq);
+    if (Gap<0) return 0;                    // Late or duplicated packet, or packet already checked
+    ExpectedSeq=Seq+1;
+    if (Gap==0) return 0;
+    LostPackets+=Gap;
+
+    // MIDI command section header : B J Z P LEN (4 or 12 bits)
+    Pos=12+(Packet[0]&0x0F)*4;              // CSRC list
+    if (Pos>=Size) return 0;
+    Header=Packet[Pos];
+    Length=Header&0x0F;
+    Pos++;
+    if (Header&0x80)
+    {
+        if (Pos>=Size) return 0;
+        Length=(Length<<8)|Packet[Pos];
+        Pos++;
+    }
+    if ((Header&0x40)==0) return 0;         // No journal in this packet
+    Pos+=Length;
+    if (Pos>=Size) return 0;
+
+    return ParseJournal (&Packet[Pos], Size-Pos, Output, Instance);
+}  // CRecoveryJournal::ProcessPacket
+//-----------------------------------------------------------------------------
+
+bool CRecoveryJournal::NeedsJournal (const unsigned char* Packet, unsigned int Size) const
+{
+    uint16_t Seq;
+    uint32_t SSRC;
+
+    // Same checks as ProcessPacket : the journal is read only when packets have been lost
+    if ((Size<12)||((Packet[0]&0xC0)!=0x80)) return false;
+    if (SeqValid==false) return false;
+
+    Seq=(Packet[2]<<8)|Packet[3];
+    SSRC=((uint32_t)Packet[8]<<24)|((uint32_t)Packet[9]<<16)|((uint32_t)Packet[10]<<8)|(uint32_t)Packet[11];
+    if (SSRC!=PeerSSRC) return false;
+    return (int16_t)(Seq-ExpectedSeq)>0;
+}  // CRecoveryJournal::NeedsJournal
+//-----------------------------------------------------------------------------
+
+unsigned int CRecoveryJournal::ParseJournal (const unsigned char* Journal, unsigned int Size, TJournalOutput* Output, void* Instance)
+{
+    unsigned int Pos=3;
+    unsigned int NumChannels;
+    unsigned int ChannelNum;
+    unsigned int Length;
+    unsigned int NumRepairs=0;
+
+    // Journal header : S Y A H TOTCHAN(4) + checkpoint sequence number
+    if (Size<3) return 0;
+    NumChannels=(Journal[0]&0x0F)+1;
+
+    if (Journal[0]&0x40)
+    {  // System journal : skipped (its length includes its header)
+        if (Pos+2>Size) return 0;
+        Length=((Journal[Pos]&0x03)<<8)|Journal[Pos+1];
+        if (Length<2) return 0;
+        Pos+=Length;
+    }
+    if ((Journal[0]&0x20)==0) return 0;     // No channel journal
+
+    for (ChannelNum=0; ChannelNum<NumChannels; ChannelNum++)
+    {
+        // Channel journal header : S CHAN(4) H LENGTH(10) + table of contents
+        if (Pos+3>Size) break;
+        Length=((Journal[Pos]&0x03)<<8)|Journal[Pos+1];
+        if ((Length<3)||(Pos+Length>Size)) break;
+        NumRepairs+=RecoverChannel ((Journal[Pos]>>3)&0x0F, Journal[Pos+2], &Journal[Pos+3], Length-3, Output, Instance);
+        Pos+=Length;
+    }
+    return NumRepairs;
+}  // CRecoveryJournal::ParseJournal
+//-----------------------------------------------------------------------------
+
+unsigned int CRecoveryJournal::RecoverChannel (unsigned int Channel, uint8_t TOC, const unsigned char* Chapters, unsigned int Size, TJournalOutput* Output, void* Instance)
+{
+    unsigned int Pos=0;
+    unsigned int NumRepairs=0;
+    unsigned int Count;
+    unsigned int Length;
+    unsigned int Low, High;
+    unsigned int Octet, Bit;
+    unsigned char Number, Value;
+    uint16_t Bend;
+
+    // Chapter P : program change
+    if (TOC&CHAPTER_P)
+    {
+        if (Pos+3>Size) return NumRepairs;
+        Value=Chapters[Pos]&0x7F;
+        if (Value!=Programs[Channel])
+        {
+            Emit (0xC0|Channel, Value, 0, Output, Instance);
+            NumRepairs++;
+        }
+        Pos+=3;
+    }
+
+    // Chapter C : controllers (only the value format is used, toggle and count formats are skipped)
+    if (TOC&CHAPTER_C)
+    {
+        if (Pos+1>Size) return NumRepairs;
+        Count=(Chapters[Pos]&0x7F)+1;
+        Pos++;
+        while (Count>0)
+        {
+            if (Pos+2>Size) return NumRepairs;
+            Number=Chapters[Pos]&0x7F;
+            Value=Chapters[Pos+1]&0x7F;
+            if (((Chapters[Pos+1]&0x80)==0)&&(Controllers[Channel][Number]!=Value))
+            {
+                Emit (0xB0|Channel, Number, Value, Output, Instance);
+                NumRepairs++;
+            }
+            Pos+=2;
+            Count--;
+        }
+    }
+
+    // Chapter M : parameter system, skipped (its length includes its header)
+    if (TOC&CHAPTER_M)
+    {
+        if (Pos+2>Size) return NumRepairs;
+        Length=((Chapters[Pos]&0x03)<<8)|Chapters[Pos+1];
+        if (Length<2) return NumRepairs;
+        Pos+=Length;
+    }
+
+    // Chapter W : pitch wheel
+    if (TOC&CHAPTER_W)
+    {
+        if (Pos+2>Size) return NumRepairs;
+        Bend=(Chapters[Pos]&0x7F)|((Chapters[Pos+1]&0x7F)<<7);
+        if (Bend!=PitchBend[Channel])
+        {
+            Emit (0xE0|Channel, Bend&0x7F, Bend>>7, Output, Instance);
+            NumRepairs++;
+        }
+        Pos+=2;
+    }
+
+    // Chapter N : note on logs, then bitmap of the notes released since the checkpoint
+    if (TOC&CHAPTER_N)
+    {
+        if (Pos+2>Size) return NumRepairs;
+        Count=Chapters[Pos]&0x7F;
+        Low=Chapters[Pos+1]>>4;
+        High=Chapters[Pos+1]&0x0F;
+        if ((Count==127)&&(Low==15)&&(High==0)) Count=128;
+        Pos+=2;
+
+        while (Count>0)
+        {
+            if (Pos+2>Size) return NumRepairs;
+            Number=Chapters[Pos]&0x7F;
+            Value=Chapters[Pos+1]&0x7F;
+            // Y bit : sender recommends to play the note if its note on has been lost
+            if ((Value!=0)&&(Chapters[Pos+1]&0x80)&&(NOTE_IS_ON (NotesOn, Channel, Number)==false))
+            {
+                Emit (0x90|Channel, Number, Value, Output, Instance);
+                NumRepairs++;
+            }
+            Pos+=2;
+            Count--;
+        }
+
+        if (Low<=High)
+        {
+            for (Octet=Low; Octet<=High; Octet++)
+            {
+                if (Pos>=Size) return NumRepairs;
+                for (Bit=0; Bit<8; Bit++)
+                {
+                    // MSB codes the lowest note of the octet
+                    Number=(Octet*8)+Bit;
+                    if ((Chapters[Pos]&(0x80>>Bit))&&(NOTE_IS_ON (NotesOn, Channel, Number)))
+                    {
+                        Emit (0x80|Channel, Number, 0x40, Output, Instance);
+                        NumRepairs++;
+                    }
+                }
+                Pos++;
+            }
+        }
+    }
+
+    // Chapters E, T and A do not change what is heard after a loss : ignored
+    return NumRepairs;
+}  // CRecoveryJournal::RecoverChannel
+//-----------------------------------------------------------------------------
+
+CReleaseGuard::CReleaseGuard (void)
+{
+    RepeatInterval=960;                     // 20ms at 48kHz
+    Reset();
+}  // CReleaseGuard::CReleaseGuard
+//-----------------------------------------------------------------------------
+
+void CReleaseGuard::Reset (void)
+{
+    memset (&NotesOn[0][0], 0, sizeof(NotesOn));
+    NumPending=0;
+}  // CReleaseGuard::Reset
+//-----------------------------------------------------------------------------
+
+void CReleaseGuard::SetRepeatInterval (uint32_t Frames)
+{
+    if (Frames!=0) RepeatInterval=Frames;
+}  // CReleaseGuard::SetRepeatInterval
+//-----------------------------------------------------------------------------
+
+void CReleaseGuard::AddRelease (unsigned char Status, unsigned char Data1, uint32_t Time)
+{
+    unsigned int Index;
+    TPendingRelease* Release;
+
+    for (Index=0; Index<NumPending; Index++)
+    {
+        if ((Pending[Index].Message[0]==Status)&&(Pending[Index].Message[1]==Data1)) break;
+    }
+
+    if (Index==NumPending)
+    {
+        if (NumPending==MAX_PENDING_RELEASES)
+        {  // Table full : oldest release is dropped
+            memmove (&Pending[0], &Pending[1], (MAX_PENDING_RELEASES-1)*sizeof(TPendingRelease));
+            Index=MAX_PENDING_RELEASES-1;
+        }
+        else NumPending++;
+    }
+
+    Release=&Pending[Index];
+    Release->Message[0]=Status;
+    Release->Message[1]=Data1;
+    Release->Message[2]=((Status&0xF0)==0x80) ? 0x40 : 0x00;
+    Release->Remaining=RELEASE_REPEATS;
+    Release->NextTime=Time+RepeatInterval;
+}  // CReleaseGuard::AddRelease
+//-----------------------------------------------------------------------------
+
+void CReleaseGuard::CancelRelease (unsigned char Status, unsigned char Data1)
+{
+    unsigned int Index;
+
+    for (Index=0; Index<NumPending; Index++)
+    {
+        if ((Pending[Index].Message[0]==Status)&&(Pending[Index].Message[1]==Data1))
+        {
+            Pending[Index]=Pending[NumPending-1];
+            NumPending--;
+            return;
+        }
+    }
+}  // CReleaseGuard::CancelRelease
+//-----------------------------------------------------------------------------
+
+void CReleaseGuard::TrackCommand (const unsigned char* Data, unsigned int Size, uint32_t Time)
+{
+    unsigned int Channel;
+    unsigned char Note;
+
+    if ((Size<3)||(Data[0]<0x80)||(Data[0]>=0xF0)) return;
+    Channel=Data[0]&0x0F;
+    Note=Data[1]&0x7F;
+
+    if (((Data[0]&0xF0)==0x90)&&(Data[2]!=0))
+    {  // A new note on must never be followed by the repeat of an older note off
+        SET_NOTE_ON (NotesOn, Channel, Note);
+        CancelRelease (0x80|Channel, Note);
+    }
+    else if (((Data[0]&0xF0)==0x80)||((Data[0]&0xF0)==0x90))
+    {  // Note off, or note on with null velocity
+        if (NOTE_IS_ON (NotesOn, Channel, Note))
+        {
+            SET_NOTE_OFF (NotesOn, Channel, Note);
+            AddRelease (0x80|Channel, Note, Time);
+        }
+    }
+    else if ((Data[0]&0xF0)==0xB0)
+    {
+        if (Data[1]==64)
+        {  // Sustain pedal
+            if (Data[2]<64) AddRelease (Data[0], 64, Time);
+            else CancelRelease (Data[0], 64);
+        }
+        else if ((Data[1]==120)||(Data[1]==123))
+        {  // All sound off / all notes off
+            memset (&NotesOn[Channel][0], 0, sizeof(NotesOn[Channel]));
+            AddRelease (Data[0], Data[1], Time);
+        }
+    }
+}  // CReleaseGuard::TrackCommand
+//-----------------------------------------------------------------------------
+
+bool CReleaseGuard::AppendDue (CRTPMIDIPacket* Packet, uint32_t Time)
+{
+    unsigned int Index=0;
+    bool Appended=false;
+    TPendingRelease* Release;
+
+    while (Index<NumPending)
+    {
+        Release=&Pending[Index];
+        if ((int32_t)(Time-Release->NextTime)<0)
+        {
+            Index++;
+            continue;
+        }
+
+        if (Packet->Append (Time, &Release->Message[0], 3, false, false)==false) break;
+        Appended=true;
+
+        Release->Remaining--;
+        Release->NextTime=Time+RepeatInterval;
+        if (Release->Remaining==0)
+        {
+            Pending[Index]=Pending[NumPending-1];
+            NumPending--;
+        }
+        else Index++;
+    }
+    return Appended;
+}  // CReleaseGuard::AppendDue
+//-----------------------------------------------------------------------------
@@ -0,0 +1,133 @@
+/*
+ * File:   RecoveryJournal.h
+ * Recovery from lost RTP-MIDI packets (RFC6295 recovery journal)
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Receiving side : CRecoveryJournal keeps the MIDI state delivered to JACK for one session and
+ checks the sequence number of each packet before the RTP-MIDI handler processes it. When
+ packets have been lost, the recovery journal of the packet (chapters P, C, W and N of the
+ channel journals) is compared with the state and the missing commands (note off, controllers,
+ program change, pitch bend, and note on when the sender recommends it) are generated.
+
+ Sending side : the RTP-MIDI handler writes the MIDI command section header itself and can not
+ carry a journal. CReleaseGuard keeps a per-channel table of the notes sent and repeats note
+ off, sustain release and all notes/sound off in the following packets, so a lost packet can
+ not leave a stuck note on the remote device.
+
+ All state is kept in fixed size arrays : nothing is allocated by the realtime thread.
+ */
+
+#ifndef __RECOVERYJOURNAL_H__
+#define __RECOVERYJOURNAL_H__
+
+#include <stdint.h>
+#include "RTPMIDIPacket.h"
+
+// Releases waiting to be repeated for one session (oldest is dropped when full)
+#define MAX_PENDING_RELEASES    64
+
+// Number of times a release is repeated after the original message
+#define RELEASE_REPEATS         3
+
+// Called for each command generated from a journal
+typedef void (TJournalOutput)(void* Instance, unsigned char* Data, unsigned int Size);
+
+class CRecoveryJournal
+{
+public:
+    CRecoveryJournal (void);
+
+    // Forgets MIDI state and sequence numbers (new remote device)
+    void Reset (void);
+
+    // Updates the state with a MIDI message delivered to JACK
+    void TrackCommand (const unsigned char* Data, unsigned int Size);
+
+    // Checks a received RTP packet (before its commands are delivered) and repairs the state from its journal
+    // if packets have been lost. Returns the number of commands generated
+    unsigned int ProcessPacket (const unsigned char* Packet, unsigned int Size, TJournalOutput* Output, void* Instance);
+
+    // Returns true if ProcessPacket needs the whole packet (journal) and not only its RTP header
+    bool NeedsJournal (const unsigned char* Packet, unsigned int Size) const;
+
+    uint32_t LostPackets;               // Total gaps seen in sequence numbers
+
+private:
+    bool SeqValid;
+    uint16_t ExpectedSeq;
+    uint32_t PeerSSRC;
+
+    // MIDI state (0xFF / 0xFFFF : unknown)
+    uint32_t NotesOn[16][4];
+    uint8_t Controllers[16][128];
+    uint8_t Programs[16];
+    uint16_t PitchBend[16];
+
+    unsigned int ParseJournal (const unsigned char* Journal, unsigned int Size, TJournalOutput* Output, void* Instance);
+    unsigned int RecoverChannel (unsigned int Channel, uint8_t TOC, const unsigned char* Chapters, unsigned int Size, TJournalOutput* Output, void* Instance);
+    void Emit (unsigned char Status, unsigned char Data1, unsigned char Data2, TJournalOutput* Output, void* Instance);
+};
+
+typedef struct {
+    uint8_t Message[3];
+    uint8_t Remaining;                  // Repeats left
+    uint32_t NextTime;                  // Frame time of next repeat
+} TPendingRelease;
+
+class CReleaseGuard
+{
+public:
+    CReleaseGuard (void);
+
+    void Reset (void);
+
+    // Frames between two repeats of a release
+    void SetRepeatInterval (uint32_t Frames);
+
+    // Updates the table with a MIDI message sent to the session at frame time Time
+    void TrackCommand (const unsigned char* Data, unsigned int Size, uint32_t Time);
+
+    bool HasPending (void)
+    {
+        return NumPending>0;
+    }
+
+    // Appends to Packet the releases to be repeated at frame time Time. Returns true if the packet has been changed
+    bool AppendDue (CRTPMIDIPacket* Packet, uint32_t Time);
+
+private:
+    uint32_t NotesOn[16][4];
+    TPendingRelease Pending[MAX_PENDING_RELEASES];
+    unsigned int NumPending;
+    uint32_t RepeatInterval;
+
+    void AddRelease (unsigned char Status, unsigned char Data1, uint32_t Time);
+    void CancelRelease (unsigned char Status, unsigned char Data1);
+};
+
+#endif
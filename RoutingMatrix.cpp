@@ -0,0 +1,156 @@
+/*
+ * File:   RoutingMatrix.cpp
+ * Routing between RTP-MIDI sessions and JACK ports, with MIDI channel filters
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RoutingMatrix.h"
+
+CRoutingMatrix::CRoutingMatrix (void)
+{
+    SetDefaultRoutes (0, false);
+}  // CRoutingMatrix::CRoutingMatrix
+//-----------------------------------------------------------------------------
+
+void CRoutingMatrix::SetDefaultRoutes (unsigned int NumSessions, bool MultiPort)
+{
+    unsigned int Session;
+
+    memset (&SessionToPorts[0], 0, sizeof(SessionToPorts));
+    memset (&PortToSessions[0], 0, sizeof(PortToSessions));
+
+    for (Session=0; Session<MAX_SESSIONS; Session++)
+    {
+        SessionChannels[Session]=ALL_CHANNELS;
+        if (Session>=NumSessions) continue;
+
+        SessionToPorts[Session]=1;                  // Common output port
+        PortToSessions[0]|=(1u<<Session);           // Common input port
+        if (MultiPort)
+        {
+            SessionToPorts[Session]|=(1ull<<(Session+1));
+            PortToSessions[Session+1]=(1u<<Session);
+        }
+    }
+}  // CRoutingMatrix::SetDefaultRoutes
+//-----------------------------------------------------------------------------
+
+bool CRoutingMatrix::LoadRoutingFile (const char* FileName, unsigned int NumSessions, bool MultiPort)
+{
+    FILE* RouteFile;
+    char Line[256];
+    char* Token;
+    char* SavePtr;
+    char Directive[16];
+    unsigned int LineNum=0;
+    unsigned int First;
+    unsigned int Value;
+    unsigned int NumPorts;
+    uint64_t PortMask;
+    uint32_t SessionMask;
+    uint16_t ChannelMask;
+    bool Valid;
+
+    SetDefaultRoutes (NumSessions, MultiPort);
+    NumPorts=MultiPort ? NumSessions+1 : 1;
+
+    RouteFile=fopen (FileName, "r");
+    if (RouteFile==0)
+    {
+        fprintf (stderr, "jackrtpmidid : can not open routing file %s\n", FileName);
+        return false;
+    }
+
+    while (fgets (Line, sizeof(Line), RouteFile)!=0)
+    {
+        LineNum++;
+
+        Token=strtok_r (Line, " \t\r\n", &SavePtr);
+        if ((Token==0)||(Token[0]=='#')) continue;
+        strncpy (Directive, Token, sizeof(Directive)-1);
+        Directive[sizeof(Directive)-1]=0;
+
+        // First number is the session (or port for 'out'), next ones the list
+        Valid=false;
+        Token=strtok_r (0, " \t\r\n", &SavePtr);
+        if (Token)
+        {
+            First=(unsigned int)atoi (Token);
+            PortMask=0;
+            SessionMask=0;
+            ChannelMask=0;
+            Valid=true;
+
+            while ((Token=strtok_r (0, " \t\r\n", &SavePtr))!=0)
+            {
+                Value=(unsigned int)atoi (Token);
+                if (strcmp (Directive, "in")==0)
+                {
+                    if (Value>=NumPorts) Valid=false;
+                    else PortMask|=(1ull<<Value);
+                }
+                else if (strcmp (Directive, "out")==0)
+                {
+                    if ((Value==0)||(Value>NumSessions)) Valid=false;
+                    else SessionMask|=(1u<<(Value-1));
+                }
+                else if (strcmp (Directive, "channels")==0)
+                {
+                    if ((Value==0)||(Value>16)) Valid=false;
+                    else ChannelMask|=(1u<<(Value-1));
+                }
+                else Valid=false;
+            }
+
+            if (Valid)
+            {
+                if (strcmp (Directive, "out")==0)
+                {
+                    if (First>=NumPorts) Valid=false;
+                    else PortToSessions[First]=SessionMask;
+                }
+                else if ((First==0)||(First>NumSessions)) Valid=false;
+                else if (strcmp (Directive, "in")==0) SessionToPorts[First-1]=PortMask;
+                else SessionChannels[First-1]=ChannelMask;
+            }
+        }
+
+        if (Valid==false)
+        {
+            fprintf (stderr, "jackrtpmidid : invalid routing directive in %s line %u\n", FileName, LineNum);
+            fclose (RouteFile);
+            return false;
+        }
+    }
+
+    fclose (RouteFile);
+    return true;
+}  // CRoutingMatrix::LoadRoutingFile
+//-----------------------------------------------------------------------------
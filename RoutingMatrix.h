@@ -0,0 +1,88 @@
+/*
+ * File:   RoutingMatrix.h
+ * Routing between RTP-MIDI sessions and JACK ports, with MIDI channel filters
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ JACK ports are numbered : 0 = common port (rtpmidi_in / rtpmidi_out), n = port of session n
+ (rtpmidi_in_n / rtpmidi_out_n, only with -multiport). Sessions are numbered from 1 in the file.
+
+ Routing file format (one directive per line, # for comments) :
+    in <session> <port> [<port>...]             events from session go to these JACK output ports
+    out <port> <session> [<session>...]         events from JACK input port go to these sessions
+    channels <session> <channel> [<channel>...] MIDI channels (1-16) accepted from and to the session
+ A directive replaces the default route of its session or port
+ */
+
+#ifndef __ROUTINGMATRIX_H__
+#define __ROUTINGMATRIX_H__
+
+#include <stdint.h>
+#include "SessionManager.h"
+
+// Common port + one port per session
+#define MAX_ROUTE_PORTS         (MAX_SESSIONS+1)
+
+#define ALL_CHANNELS            0xFFFF
+
+class CRoutingMatrix
+{
+public:
+    CRoutingMatrix (void);
+
+    // Default routing : all sessions to common port (and to their own port with MultiPort), common port to all sessions
+    void SetDefaultRoutes (unsigned int NumSessions, bool MultiPort);
+
+    // Reads routing directives from a file. Returns false if the file can not be read or is invalid
+    bool LoadRoutingFile (const char* FileName, unsigned int NumSessions, bool MultiPort);
+
+    // JACK output ports receiving the events of a session (bit n = port n)
+    uint64_t GetSessionPorts (unsigned int Session)
+    {
+        return SessionToPorts[Session];
+    }
+
+    // Sessions receiving the events of a JACK input port (bit n = session n)
+    uint32_t GetPortSessions (unsigned int Port)
+    {
+        return PortToSessions[Port];
+    }
+
+    // Returns true if the MIDI message starting with Status can be exchanged with the session
+    bool ChannelAllowed (unsigned int Session, unsigned char Status)
+    {
+        if ((Status<0x80)||(Status>=0xF0)) return true;         // Only channel messages are filtered
+        return (SessionChannels[Session]&(1u<<(Status&0x0F)))!=0;
+    }
+
+private:
+    uint64_t SessionToPorts[MAX_SESSIONS];
+    uint32_t PortToSessions[MAX_ROUTE_PORTS];
+    uint16_t SessionChannels[MAX_SESSIONS];
+};
+
+#endif
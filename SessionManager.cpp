@@ -0,0 +1,222 @@
+/*
+ * File:   SessionManager.cpp
+ * Pool of RTP-MIDI sessions created from command line or configuration file
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SessionManager.h"
+
+// Size of SYSEX reassembly buffer in RTP-MIDI handlers (largest SYSEX that can be received)
+#define SYSEX_IN_SIZE           65536
+
+CSessionManager::CSessionManager (void)
+{
+    NumSessions=0;
+    OpenedMask.store (0);
+    memset (&Sessions[0], 0, sizeof(Sessions));
+    SetJitterLimits (false, 0, 0);
+}  // CSessionManager::CSessionManager
+//-----------------------------------------------------------------------------
+
+CSessionManager::~CSessionManager (void)
+{
+    CloseSessions();
+}  // CSessionManager::~CSessionManager
+//-----------------------------------------------------------------------------
+
+void CSessionManager::SetJitterLimits (bool Enabled, unsigned int MinMs, unsigned int MaxMs)
+{
+    JitterEnabled=Enabled;
+    JitterMinMs=MinMs;
+    JitterMaxMs=(MaxMs<MinMs) ? MinMs : MaxMs;
+}  // CSessionManager::SetJitterLimits
+//-----------------------------------------------------------------------------
+
+bool CSessionManager::AddSession (const char* Name, unsigned short ControlPort)
+{
+    TSessionSlot* Slot;
+
+    if (NumSessions>=MAX_SESSIONS) return false;
+
+    Slot=&Sessions[NumSessions];
+    Slot->Handler=0;
+    Slot->Index=NumSessions;
+    snprintf (Slot->Name, sizeof(Slot->Name), "%s", Name);
+    Slot->ControlPort=ControlPort;
+    Slot->DataPort=ControlPort+1;
+    Slot->TXSYSEXActive=false;
+    Slot->JitterEnabled=JitterEnabled;
+    Slot->JitterMinMs=JitterMinMs;
+    Slot->JitterMaxMs=JitterMaxMs;
+
+    NumSessions++;
+    return true;
+}  // CSessionManager::AddSession
+//-----------------------------------------------------------------------------
+
+bool CSessionManager::AddDefaultSessions (unsigned int NumToAdd, unsigned short BasePort)
+{
+    unsigned int SessionNum;
+    char Name[SESSION_NAME_LENGTH];
+
+    for (SessionNum=0; SessionNum<NumToAdd; SessionNum++)
+    {
+        snprintf (Name, SESSION_NAME_LENGTH, "Zynthian RTP-MIDI %u", NumSessions+1);
+        if (AddSession (Name, BasePort+2*SessionNum)==false) return false;
+    }
+    return true;
+}  // CSessionManager::AddDefaultSessions
+//-----------------------------------------------------------------------------
+
+bool CSessionManager::LoadConfigFile (const char* FileName)
+{
+    FILE* ConfigFile;
+    char Line[256];
+    char Name[SESSION_NAME_LENGTH];
+    unsigned int Port;
+    unsigned int MinMs;
+    unsigned int MaxMs;
+    unsigned int LineNum=0;
+    bool Result=true;
+
+    ConfigFile=fopen (FileName, "r");
+    if (ConfigFile==0)
+    {
+        fprintf (stderr, "jackrtpmidid : can not open configuration file %s\n", FileName);
+        return false;
+    }
+
+    while (fgets (Line, sizeof(Line), ConfigFile)!=0)
+    {
+        LineNum++;
+        if ((Line[0]=='#')||(Line[0]=='\r')||(Line[0]=='\n')||(Line[0]==0)) continue;
+
+        if (strncmp (Line, "jitter", 6)==0)
+        {
+            if (sscanf (Line, "jitter %u %u", &MinMs, &MaxMs)==2) SetJitterLimits (true, MinMs, MaxMs);
+            else if (strncmp (Line, "jitter off", 10)==0) SetJitterLimits (false, 0, 0);
+            else
+            {
+                fprintf (stderr, "jackrtpmidid : invalid jitter definition in %s line %u\n", FileName, LineNum);
+                Result=false;
+                break;
+            }
+            continue;
+        }
+
+        if ((sscanf (Line, "%u %63[^\r\n]", &Port, Name)!=2)||(Port==0)||(Port>65534))
+        {
+            fprintf (stderr, "jackrtpmidid : invalid session definition in %s line %u\n", FileName, LineNum);
+            Result=false;
+            break;
+        }
+
+        if (AddSession (Name, (unsigned short)Port)==false)
+        {
+            fprintf (stderr, "jackrtpmidid : too many sessions in %s (max %u)\n", FileName, MAX_SESSIONS);
+            Result=false;
+            break;
+        }
+    }
+
+    fclose (ConfigFile);
+    return Result;
+}  // CSessionManager::LoadConfigFile
+//-----------------------------------------------------------------------------
+
+bool CSessionManager::OpenSession (unsigned int SessionNum, TSessionDataCallback* Callback, CRTEventLoop* Loop)
+{
+    TSessionSlot* Slot;
+    int Ret;
+
+    if (SessionNum>=NumSessions) return false;
+    Slot=&Sessions[SessionNum];
+
+    // Each handler gets its slot as instance, so the callback knows where data come from
+    Slot->Handler = new CRTP_MIDI (SYSEX_IN_SIZE, Callback, Slot);
+    if (Slot->Handler==0) return false;
+
+    Slot->Handler->setSessionName (Slot->Name);
+    Ret=Slot->Handler->InitiateSession (0, Slot->ControlPort, Slot->DataPort, Slot->ControlPort, Slot->DataPort, false);
+    if (Ret==-1) fprintf (stderr, "jackrtpmidid : can not create control socket for session %u\n", SessionNum+1);
+    else if (Ret==-2) fprintf (stderr, "jackrtpmidid : can not create data socket for session %u\n", SessionNum+1);
+    if (Ret!=0)
+    {
+        delete Slot->Handler;
+        Slot->Handler = 0;
+        return false;
+    }
+
+    if (Loop)
+    {
+        if (Loop->AddSession (SessionNum, Slot->ControlPort, Slot->DataPort)==false)
+            fprintf (stderr, "jackrtpmidid : sockets for session %u not found, session is polled\n", SessionNum+1);
+    }
+    return true;
+}  // CSessionManager::OpenSession
+//-----------------------------------------------------------------------------
+
+void CSessionManager::CloseSession (unsigned int SessionNum, CRTEventLoop* Loop)
+{
+    if (SessionNum>=MAX_SESSIONS) return;
+    if (Sessions[SessionNum].Handler==0) return;
+
+    printf ("Closing RTP-MIDI handler for session %u...\n", SessionNum+1);
+    if (Loop) Loop->RemoveSession (SessionNum);
+    Sessions[SessionNum].Handler->CloseSession();
+    delete Sessions[SessionNum].Handler;
+    Sessions[SessionNum].Handler=0;
+}  // CSessionManager::CloseSession
+//-----------------------------------------------------------------------------
+
+void CSessionManager::CloseSessions (void)
+{
+    unsigned int SessionNum;
+
+    OpenedMask.store (0);
+    for (SessionNum=0; SessionNum<NumSessions; SessionNum++)
+        CloseSession (SessionNum, 0);
+}  // CSessionManager::CloseSessions
+//-----------------------------------------------------------------------------
+
+void CSessionManager::RunSessions (unsigned int Mask)
+{
+    unsigned int SessionNum;
+
+    // Only sessions with pending work are visited
+    Mask&=OpenedMask.load (std::memory_order_relaxed);
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        Sessions[SessionNum].Handler->RunSession();
+    }
+}  // CSessionManager::RunSessions
+//-----------------------------------------------------------------------------
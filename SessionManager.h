@@ -0,0 +1,109 @@
+/*
+ * File:   SessionManager.h
+ * Pool of RTP-MIDI sessions created from command line or configuration file
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Configuration file format : one session per line
+    <control port> <session name>
+ The data port is the control port + 1. Empty lines and lines starting with # are ignored
+ A line 'jitter <min ms> <max ms>' enables the jitter buffer for the sessions declared after it,
+ 'jitter off' disables it for the next sessions
+ */
+
+#ifndef __SESSIONMANAGER_H__
+#define __SESSIONMANAGER_H__
+
+#include <stdint.h>
+#include <atomic>
+#include "RTP_MIDI.h"
+#include "RTEventLoop.h"
+
+#define MAX_SESSIONS            MAX_LOOP_SESSIONS
+#define SESSION_NAME_LENGTH     64
+
+// Default configuration : two sessions on 5004/5005 and 5006/5007
+#define DEFAULT_NUM_SESSIONS    2
+#define DEFAULT_BASE_PORT       5004
+
+// Callback called by RTP-MIDI handlers (Instance is the TSessionSlot of the handler)
+typedef void (TSessionDataCallback)(void* Instance, unsigned int DataSize, unsigned char* DataBlock, unsigned int DeltaTime);
+
+typedef struct {
+    CRTP_MIDI* Handler;                 // 0 if session is not opened
+    unsigned int Index;                 // Position in the pool (also used as source number in event records)
+    char Name[SESSION_NAME_LENGTH];
+    unsigned short ControlPort;
+    unsigned short DataPort;
+    bool TXSYSEXActive;                 // A segmented SYSEX is being sent to this session (worker of the session only)
+    bool JitterEnabled;                 // Received events are scheduled by the jitter buffer
+    unsigned int JitterMinMs;           // Limits of jitter buffer delay
+    unsigned int JitterMaxMs;
+} TSessionSlot;
+
+class CSessionManager
+{
+public:
+    CSessionManager (void);
+    ~CSessionManager (void);
+
+    // Jitter buffer settings given to the sessions declared after this call
+    void SetJitterLimits (bool Enabled, unsigned int MinMs, unsigned int MaxMs);
+
+    // Declares a session. Returns false if the pool is full
+    bool AddSession (const char* Name, unsigned short ControlPort);
+
+    // Declares NumSessions sessions with default names on consecutive port pairs
+    bool AddDefaultSessions (unsigned int NumSessions, unsigned short BasePort);
+
+    // Reads sessions from a configuration file. Returns false if file can not be read or is invalid
+    bool LoadConfigFile (const char* FileName);
+
+    // Creates the handler of one session and registers its sockets in the event loop (Loop can be 0)
+    // OpenedMask is not changed : the caller decides when the session is serviced
+    bool OpenSession (unsigned int SessionNum, TSessionDataCallback* Callback, CRTEventLoop* Loop);
+
+    // Closes and deletes the handler of one session. The session must not be in OpenedMask anymore
+    void CloseSession (unsigned int SessionNum, CRTEventLoop* Loop);
+
+    // Closes and deletes all handlers
+    void CloseSessions (void);
+
+    // Runs the sessions selected in Mask (bit n = session n)
+    void RunSessions (unsigned int Mask);
+
+    unsigned int NumSessions;           // Number of sessions declared
+    std::atomic<uint32_t> OpenedMask;   // Bit n set when session n is serviced by the realtime thread
+    TSessionSlot Sessions[MAX_SESSIONS];
+
+private:
+    bool JitterEnabled;
+    unsigned int JitterMinMs;
+    unsigned int JitterMaxMs;
+};
+
+#endif
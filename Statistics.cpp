@@ -0,0 +1,156 @@
+/*
+ * File:   Statistics.cpp
+ * Traffic, overflow and latency counters shared with monitoring tools
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "Statistics.h"
+#include "SessionManager.h"
+
+#if MAX_SESSIONS>STATS_MAX_SESSIONS
+#error STATS_MAX_SESSIONS must be increased
+#endif
+
+CStatistics::CStatistics (void)
+{
+    Block=0;
+    Shared=false;
+}  // CStatistics::CStatistics
+//-----------------------------------------------------------------------------
+
+CStatistics::~CStatistics (void)
+{
+    if (Block==0) return;
+
+    if (Shared)
+    {
+        munmap (Block, sizeof(TStatsBlock));
+        shm_unlink (STATS_SHM_NAME);
+    }
+    else
+    {
+        delete Block;
+    }
+    Block=0;
+}  // CStatistics::~CStatistics
+//-----------------------------------------------------------------------------
+
+bool CStatistics::Open (uint32_t QueueSize)
+{
+    int ShmFD;
+    void* Memory;
+
+    if (Block) return Shared;
+
+    ShmFD=shm_open (STATS_SHM_NAME, O_CREAT|O_RDWR|O_TRUNC, 0644);
+    if (ShmFD!=-1)
+    {
+        if (ftruncate (ShmFD, sizeof(TStatsBlock))==0)
+        {
+            Memory=mmap (0, sizeof(TStatsBlock), PROT_READ|PROT_WRITE, MAP_SHARED, ShmFD, 0);
+            if (Memory!=MAP_FAILED)
+            {
+                // Counters are lock free atomics : they can be used directly in the mapped segment
+                Block=(TStatsBlock*)Memory;
+                Shared=true;
+            }
+        }
+        close (ShmFD);
+        if (Shared==false) shm_unlink (STATS_SHM_NAME);
+    }
+
+    if (Block==0)
+    {
+        fprintf (stderr, "jackrtpmidid : can not create shared memory for statistics\n");
+        Block=new TStatsBlock;
+    }
+
+    memset ((void*)Block, 0, sizeof(TStatsBlock));
+    Block->QueueSize=QueueSize;
+    Block->Version=STATS_VERSION;
+    // Magic is written last, so readers never see a block being initialized
+    std::atomic_thread_fence (std::memory_order_release);
+    Block->Magic=STATS_MAGIC;
+
+    return Shared;
+}  // CStatistics::Open
+//-----------------------------------------------------------------------------
+
+void CStatistics::SetSession (unsigned int Session, const char* Name, bool Opened)
+{
+    if ((Block==0)||(Session>=STATS_MAX_SESSIONS)) return;
+
+    strncpy (Block->Sessions[Session].Name, Name, STATS_NAME_LENGTH-1);
+    Block->Sessions[Session].Name[STATS_NAME_LENGTH-1]=0;
+    Block->Sessions[Session].Opened.store (Opened ? 1 : 0, std::memory_order_relaxed);
+    if (Session>=Block->NumSessions) Block->NumSessions=Session+1;
+}  // CStatistics::SetSession
+//-----------------------------------------------------------------------------
+
+static void ResetTraffic (TTrafficCounters* Counters)
+{
+    Counters->Messages.store (0, std::memory_order_relaxed);
+    Counters->Bytes.store (0, std::memory_order_relaxed);
+    Counters->Drops.store (0, std::memory_order_relaxed);
+    Counters->SysExRejects.store (0, std::memory_order_relaxed);
+    Counters->Filtered.store (0, std::memory_order_relaxed);
+}  // ResetTraffic
+//-----------------------------------------------------------------------------
+
+void CStatistics::ResetSession (unsigned int Session)
+{
+    TSessionStats* Counters;
+
+    if ((Block==0)||(Session>=STATS_MAX_SESSIONS)) return;
+
+    Counters=&Block->Sessions[Session];
+    ResetTraffic (&Counters->FromNetwork);
+    ResetTraffic (&Counters->ToNetwork);
+    Counters->PacketsSent.store (0, std::memory_order_relaxed);
+    Counters->PacketsLost.store (0, std::memory_order_relaxed);
+    Counters->JournalRepairs.store (0, std::memory_order_relaxed);
+    Counters->ParserDiscards.store (0, std::memory_order_relaxed);
+    Counters->JitterDelayMicros.store (0, std::memory_order_relaxed);
+    Counters->ClockExchanges.store (0, std::memory_order_relaxed);
+    Counters->ClockRejected.store (0, std::memory_order_relaxed);
+    Counters->ClockErrorMicros.store (0, std::memory_order_relaxed);
+    Counters->ClockDriftPPB.store (0, std::memory_order_relaxed);
+    Counters->ClockRoundTripMicros.store (0, std::memory_order_relaxed);
+}  // CStatistics::ResetSession
+//-----------------------------------------------------------------------------
+
+void CStatistics::SetNumSessions (unsigned int NumSessions)
+{
+    if (Block==0) return;
+    Block->NumSessions=(NumSessions>STATS_MAX_SESSIONS) ? STATS_MAX_SESSIONS : NumSessions;
+}  // CStatistics::SetNumSessions
+//-----------------------------------------------------------------------------
@@ -0,0 +1,178 @@
+/*
+ * File:   Statistics.h
+ * Traffic, overflow and latency counters shared with monitoring tools
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Counters are stored in a POSIX shared memory segment (STATS_SHM_NAME) which can be read at any
+ time by monitoring tools (see tools/jackrtpmidistat.cpp) without any lock in the daemon.
+ Each counter has a single writer thread, so it is updated with a relaxed load and store
+ (no locked instruction in the realtime paths). Readers may see a value one update old.
+ */
+
+#ifndef __STATISTICS_H__
+#define __STATISTICS_H__
+
+#include <stdint.h>
+#include <atomic>
+
+#define STATS_SHM_NAME          "/jackrtpmidid_stats"
+#define STATS_MAGIC             0x5354524A          // 'JRTS'
+#define STATS_VERSION           9
+
+// Must be at least MAX_SESSIONS (checked in Statistics.cpp)
+#define STATS_MAX_SESSIONS      32
+#define STATS_NAME_LENGTH       64
+
+// Latency histogram : bucket n counts latencies from 2^(n-1) to 2^n-1 microseconds (bucket 0 : < 1us)
+// The last bucket counts everything above
+#define STATS_LATENCY_BUCKETS   16
+
+typedef struct {
+    std::atomic<uint64_t> Messages;
+    std::atomic<uint64_t> Bytes;
+    std::atomic<uint64_t> Drops;                // Messages lost because a queue was full
+    std::atomic<uint64_t> SysExRejects;         // SYSEX lost because the queue or the chunk pool was full
+    std::atomic<uint64_t> Filtered;             // Messages removed or held by filters
+} TTrafficCounters;
+
+typedef struct {
+    char Name[STATS_NAME_LENGTH];
+    std::atomic<uint32_t> Opened;
+    TTrafficCounters FromNetwork;               // Received from RTP-MIDI, queued to JACK (realtime thread)
+    TTrafficCounters ToNetwork;                 // Sent to RTP-MIDI (realtime thread)
+    std::atomic<uint64_t> PacketsSent;
+    std::atomic<uint64_t> PacketsLost;          // Gaps in received sequence numbers
+    std::atomic<uint64_t> JournalRepairs;       // Commands generated from recovery journals
+    std::atomic<uint64_t> ParserDiscards;       // Received bytes not forming a valid MIDI message
+    std::atomic<uint32_t> JitterDelayMicros;    // Current delay of jitter buffer (0 when disabled)
+    std::atomic<uint32_t> ClockExchanges;       // Clock synchronization exchanges completed by the peer
+    std::atomic<uint32_t> ClockRejected;        // Exchanges not used (round trip too long)
+    std::atomic<uint32_t> ClockErrorMicros;     // Average error of the peer clock model
+    std::atomic<int32_t> ClockDriftPPB;         // Rate of the peer clock relative to JACK clock
+    std::atomic<uint32_t> ClockRoundTripMicros; // Round trip of the last exchange used
+} TSessionStats;
+
+typedef struct {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t NumSessions;
+    uint32_t QueueSize;                         // Size of event queues in bytes
+    TTrafficCounters FromJACK;                  // Read from JACK input ports (jack_process)
+    std::atomic<uint32_t> MaxFillToJACK;        // Highest fill of the RTP-MIDI -> JACK queue (bytes)
+    std::atomic<uint32_t> MaxFillToNetwork;     // Highest fill of the JACK -> RTP-MIDI queue (bytes)
+    std::atomic<uint64_t> Xruns;                // Reported by JACK
+    std::atomic<uint64_t> RTAllocations;        // Allocations made by realtime threads after activation
+    std::atomic<uint64_t> RTPageFaults;         // Page faults of RTP-MIDI thread since it started
+    std::atomic<uint64_t> RTAuditViolations;    // Forbidden calls in realtime threads (audit builds only)
+    std::atomic<uint64_t> WakeLatency[STATS_LATENCY_BUCKETS];   // Timer expiry to start of work in realtime thread
+    int32_t TXDeadlineMicros;                   // Send deadline after JACK period start (-1 : sent when jack_process has run)
+    std::atomic<uint32_t> JACKPeriodMicros;     // Duration of the JACK period
+    std::atomic<uint64_t> TXLatency[STATS_LATENCY_BUCKETS];     // Start of JACK period to end of sending of its packets
+    std::atomic<uint32_t> MaxTXLatencyMicros;
+    std::atomic<uint64_t> TXLate;               // Sendings more than one period after their deadline
+    TSessionStats Sessions[STATS_MAX_SESSIONS];
+} TStatsBlock;
+
+// Adds Value to a counter. Must only be called by the thread owning the counter
+inline void StatsAdd (std::atomic<uint64_t>& Counter, uint64_t Value)
+{
+    Counter.store (Counter.load (std::memory_order_relaxed)+Value, std::memory_order_relaxed);
+}
+
+// Keeps the highest value seen. Must only be called by the thread owning the counter
+inline void StatsMax (std::atomic<uint32_t>& Counter, uint32_t Value)
+{
+    if (Value>Counter.load (std::memory_order_relaxed)) Counter.store (Value, std::memory_order_relaxed);
+}
+
+// Same as StatsAdd and StatsMax for counters updated by several realtime workers
+inline void StatsAddShared (std::atomic<uint64_t>& Counter, uint64_t Value)
+{
+    Counter.fetch_add (Value, std::memory_order_relaxed);
+}
+
+inline void StatsMaxShared (std::atomic<uint32_t>& Counter, uint32_t Value)
+{
+    uint32_t Current=Counter.load (std::memory_order_relaxed);
+
+    while ((Value>Current)&&(Counter.compare_exchange_weak (Current, Value, std::memory_order_relaxed)==false)) {}
+}
+
+// Counts a message queued (Queued=true) or lost
+inline void StatsCountMessage (TTrafficCounters* Counters, const unsigned char* Data, unsigned int Size, bool Queued)
+{
+    if (Queued)
+    {
+        StatsAdd (Counters->Messages, 1);
+        StatsAdd (Counters->Bytes, Size);
+    }
+    else if (Data[0]==0xF0) StatsAdd (Counters->SysExRejects, 1);
+    else StatsAdd (Counters->Drops, 1);
+}
+
+// Counts a latency in a histogram of STATS_LATENCY_BUCKETS buckets
+inline void StatsHistogram (std::atomic<uint64_t>* Buckets, uint32_t Micros)
+{
+    unsigned int Bucket;
+
+    Bucket=(Micros==0) ? 0 : 32-__builtin_clz (Micros);
+    if (Bucket>=STATS_LATENCY_BUCKETS) Bucket=STATS_LATENCY_BUCKETS-1;
+    StatsAddShared (Buckets[Bucket], 1);
+}
+
+inline void StatsLatency (TStatsBlock* Block, uint32_t Micros)
+{
+    StatsHistogram (&Block->WakeLatency[0], Micros);
+}
+
+class CStatistics
+{
+public:
+    CStatistics (void);
+    ~CStatistics (void);
+
+    // Creates the shared memory segment. If it can not be created, counters are kept in process memory
+    // Returns false in that case (Block is valid anyway)
+    bool Open (uint32_t QueueSize);
+
+    // Name and state of a session, published for the readers
+    void SetSession (unsigned int Session, const char* Name, bool Opened);
+
+    // Clears the counters of a session slot given to a new session (slot must not be used by realtime threads)
+    void ResetSession (unsigned int Session);
+
+    // Number of sessions published (sessions above are removed from the block)
+    void SetNumSessions (unsigned int NumSessions);
+
+    TStatsBlock* Block;
+
+private:
+    bool Shared;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * File:   SysExPool.h
+ * Pool of preallocated buffers used to stream large SYSEX messages between threads
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ A SYSEX message too big to be stored in an event queue record is split into chunks taken
+ from the pool. The event queue then transports only references to the chunks.
+ Chunks are allocated by one thread (the producer of the event queue) and freed by the
+ other thread (the consumer) : the list of free chunks is itself a single producer / single
+ consumer ring of chunk indexes, so no lock is needed.
+ A chunk sent to several destinations is not copied : it gets one reference per destination
+ and goes back to the pool when the last reference is released.
+ */
+
+#ifndef __SYSEXPOOL_H__
+#define __SYSEXPOOL_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Size of one chunk. Also the largest SYSEX stored directly in event queue records
+#define SYSEX_CHUNK_SIZE        512
+
+// Default number of chunks in a pool (must be a power of two)
+#define SYSEX_POOL_CHUNKS       256
+
+// Flag set in TMIDIEventHeader.Flags when the record carries a TSysExChunkRef instead of MIDI bytes
+#define EVENT_FLAG_CHUNK        0x01
+
+// Payload of a chunk record
+typedef struct {
+    uint16_t Chunk;             // Chunk index in the pool
+    uint16_t Length;            // Number of MIDI bytes in the chunk
+} TSysExChunkRef;
+
+class CSysExPool
+{
+public:
+    // NumChunks is rounded up to the next power of two
+    CSysExPool (unsigned int NumChunks)
+    {
+        unsigned int Chunk;
+
+        Count=1;
+        while (Count<NumChunks) Count<<=1;
+        Mask=Count-1;
+
+        Data=new unsigned char[Count*SYSEX_CHUNK_SIZE];
+        memset (Data, 0, Count*SYSEX_CHUNK_SIZE);
+        FreeList=new uint16_t[Count];
+        RefCount=new std::atomic<uint32_t>[Count];
+        for (Chunk=0; Chunk<Count; Chunk++)
+        {
+            FreeList[Chunk]=(uint16_t)Chunk;
+            RefCount[Chunk].store (0);
+        }
+
+        // All chunks are free at startup
+        FreeWrite.store (Count);
+        FreeRead.store (0);
+    }
+
+    ~CSysExPool (void)
+    {
+        delete[] RefCount;
+        delete[] FreeList;
+        delete[] Data;
+    }
+
+    // --- Allocating thread ---
+
+    // Number of chunks that can be allocated now (can only grow until next Alloc)
+    unsigned int Available (void)
+    {
+        return FreeWrite.load (std::memory_order_acquire)-FreeRead.load (std::memory_order_relaxed);
+    }
+
+    // Returns a free chunk index, or -1 if the pool is empty
+    int Alloc (void)
+    {
+        uint32_t Read;
+        uint16_t Chunk;
+
+        Read=FreeRead.load (std::memory_order_relaxed);
+        if (Read==FreeWrite.load (std::memory_order_acquire)) return -1;
+        Chunk=FreeList[Read&Mask];
+        FreeRead.store (Read+1, std::memory_order_release);
+        return Chunk;
+    }
+
+    // --- Releasing thread ---
+
+    void Free (unsigned int Chunk)
+    {
+        uint32_t Write;
+
+        Write=FreeWrite.load (std::memory_order_relaxed);
+        FreeList[Write&Mask]=(uint16_t)Chunk;
+        FreeWrite.store (Write+1, std::memory_order_release);
+    }
+
+    // Sets the number of destinations which will use the chunk before it goes back to the pool
+    void SetReferences (unsigned int Chunk, unsigned int Count)
+    {
+        if (Count==0) Free (Chunk);
+        else RefCount[Chunk].store (Count, std::memory_order_relaxed);
+    }
+
+    // Drops one reference. The chunk is freed when the last reference is dropped
+    void Release (unsigned int Chunk)
+    {
+        if (RefCount[Chunk].fetch_sub (1, std::memory_order_acq_rel)==1) Free (Chunk);
+    }
+
+    // --- Both threads ---
+
+    unsigned char* ChunkData (unsigned int Chunk)
+    {
+        return &Data[Chunk*SYSEX_CHUNK_SIZE];
+    }
+
+private:
+    unsigned char* Data;
+    uint16_t* FreeList;
+    std::atomic<uint32_t>* RefCount;
+    uint32_t Count;
+    uint32_t Mask;
+    unsigned char PadWrite[64];
+    std::atomic<uint32_t> FreeWrite;        // Written by releasing thread only
+    unsigned char PadRead[64];
+    std::atomic<uint32_t> FreeRead;         // Written by allocating thread only
+    unsigned char PadEnd[64];
+};
+
+#endif
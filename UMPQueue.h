@@ -0,0 +1,156 @@
+/*
+ * File:   UMPQueue.h
+ * Lock-free single producer / single consumer queue of timestamped UMP packets
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ UMP packets are made of 1 to 4 32 bits words, the size being given by the message type of
+ the first word. The queue is a ring of words : each record is the JACK frame time of the
+ packet followed by its words, so no length has to be stored nor decoded byte after byte.
+ Records may wrap at the end of the ring, words are copied one by one by Push and Pop.
+
+ Positions are free running counters of words (index = position & mask), published with
+ release semantic by their owner and read with acquire semantic by the other thread
+ */
+
+#ifndef __UMPQUEUE_H__
+#define __UMPQUEUE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Default queue size in words (must be a power of two)
+#define UMP_QUEUE_WORDS         16384
+
+// Largest UMP packet
+#define UMP_MAX_WORDS           4
+
+// Number of words of the UMP packet starting with Word
+static inline unsigned int UMPWordCount (uint32_t Word)
+{
+    static const unsigned char WordsPerType[16]={1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+
+    return WordsPerType[Word>>28];
+}  // UMPWordCount
+
+class CUMPQueue
+{
+public:
+    // QueueWords is rounded up to the next power of two
+    CUMPQueue (unsigned int QueueWords)
+    {
+        Size=64;
+        while (Size<QueueWords) Size<<=1;
+        Mask=Size-1;
+        Buffer=new uint32_t[Size];
+        memset (Buffer, 0, Size*sizeof(uint32_t));
+        WritePos.store (0);
+        ReadPos.store (0);
+        PendingWrite=0;
+    }
+
+    ~CUMPQueue (void)
+    {
+        delete[] Buffer;
+    }
+
+    // --- Producer side ---
+
+    // Stores one UMP packet. Returns false if the queue is full
+    // The packet is not visible to the consumer before Commit is called
+    bool Push (uint32_t Time, const uint32_t* Words)
+    {
+        unsigned int NumWords;
+        unsigned int WordNum;
+
+        NumWords=UMPWordCount (Words[0]);
+        if (PendingWrite-ReadPos.load (std::memory_order_acquire)+NumWords+1>Size) return false;
+
+        Buffer[PendingWrite&Mask]=Time;
+        for (WordNum=0; WordNum<NumWords; WordNum++)
+            Buffer[(PendingWrite+1+WordNum)&Mask]=Words[WordNum];
+        PendingWrite+=NumWords+1;
+        return true;
+    }
+
+    void Commit (void)
+    {
+        WritePos.store (PendingWrite, std::memory_order_release);
+    }
+
+    // Number of words used in the queue, seen from the producer
+    uint32_t GetFill (void)
+    {
+        return PendingWrite-ReadPos.load (std::memory_order_relaxed);
+    }
+
+    // --- Consumer side ---
+
+    // Gets the time of the oldest packet without removing it. Returns false if the queue is empty
+    bool PeekTime (uint32_t* Time)
+    {
+        uint32_t Read;
+
+        Read=ReadPos.load (std::memory_order_relaxed);
+        if (Read==WritePos.load (std::memory_order_acquire)) return false;
+        *Time=Buffer[Read&Mask];
+        return true;
+    }
+
+    // Removes the oldest packet and copies its words (UMP_MAX_WORDS words at most)
+    // Returns the number of words, 0 if the queue is empty
+    unsigned int Pop (uint32_t* Time, uint32_t* Words)
+    {
+        uint32_t Read;
+        unsigned int NumWords;
+        unsigned int WordNum;
+
+        Read=ReadPos.load (std::memory_order_relaxed);
+        if (Read==WritePos.load (std::memory_order_acquire)) return 0;
+
+        if (Time) *Time=Buffer[Read&Mask];
+        NumWords=UMPWordCount (Buffer[(Read+1)&Mask]);
+        for (WordNum=0; WordNum<NumWords; WordNum++)
+            Words[WordNum]=Buffer[(Read+1+WordNum)&Mask];
+        ReadPos.store (Read+NumWords+1, std::memory_order_release);
+        return NumWords;
+    }
+
+private:
+    uint32_t* Buffer;
+    uint32_t Size;
+    uint32_t Mask;
+    uint32_t PendingWrite;                                  // Producer private position
+    unsigned char PadWrite[64];
+    std::atomic<uint32_t> WritePos;                         // Written by producer only
+    unsigned char PadRead[64];
+    std::atomic<uint32_t> ReadPos;                          // Written by consumer only
+    unsigned char PadEnd[64];
+};
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * File:   UMPTranslator.cpp
+ * Translation between UMP packets and MIDI 1.0 messages
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "UMPTranslator.h"
+
+// UMP message types
+#define UMP_MT_SYSTEM           0x1
+#define UMP_MT_MIDI1_VOICE      0x2
+#define UMP_MT_SYSEX7           0x3
+#define UMP_MT_MIDI2_VOICE      0x4
+
+// Status of 7 bits SYSEX packets
+#define SYSEX7_COMPLETE         0x0
+#define SYSEX7_START            0x1
+#define SYSEX7_CONTINUE         0x2
+#define SYSEX7_END              0x3
+
+CUMPToMIDI1::CUMPToMIDI1 (void)
+{
+    Reset();
+}  // CUMPToMIDI1::CUMPToMIDI1
+//-----------------------------------------------------------------------------
+
+void CUMPToMIDI1::Reset (void)
+{
+    SysExSize=0;
+    SysExActive=false;
+}  // CUMPToMIDI1::Reset
+//-----------------------------------------------------------------------------
+
+unsigned int CUMPToMIDI1::AddShort (TMIDI1Message* Messages, unsigned int Count, unsigned char Status, unsigned char Data1, unsigned char Data2, unsigned int Size)
+{
+    ShortBuffer[Count][0]=Status;
+    ShortBuffer[Count][1]=Data1&0x7F;
+    ShortBuffer[Count][2]=Data2&0x7F;
+    Messages[Count].Data=&ShortBuffer[Count][0];
+    Messages[Count].Size=Size;
+    return Count+1;
+}  // CUMPToMIDI1::AddShort
+//-----------------------------------------------------------------------------
+
+unsigned int CUMPToMIDI1::Translate (const uint32_t* Words, TMIDI1Message* Messages)
+{
+    unsigned int Type;
+    unsigned char Status;
+    unsigned char Byte3, Byte4;
+    unsigned int Channel;
+    unsigned int NumBytes;
+    unsigned int ByteNum;
+    unsigned int Count=0;
+    uint32_t Value;
+
+    Type=Words[0]>>28;
+    Status=(unsigned char)(Words[0]>>16);
+    Byte3=(unsigned char)(Words[0]>>8);
+    Byte4=(unsigned char)Words[0];
+
+    switch (Type)
+    {
+        case UMP_MT_SYSTEM :
+            if ((Status==0xF1)||(Status==0xF3)) NumBytes=2;
+            else if (Status==0xF2) NumBytes=3;
+            else NumBytes=1;
+            return AddShort (Messages, 0, Status, Byte3, Byte4, NumBytes);
+
+        case UMP_MT_MIDI1_VOICE :
+            if (Status<0x80) return 0;
+            NumBytes=((Status&0xE0)==0xC0) ? 2 : 3;
+            return AddShort (Messages, 0, Status, Byte3, Byte4, NumBytes);
+
+        case UMP_MT_SYSEX7 :
+            Status=(Words[0]>>20)&0x0F;
+            NumBytes=(Words[0]>>16)&0x0F;
+            if (NumBytes>6) NumBytes=6;
+
+            if ((Status==SYSEX7_COMPLETE)||(Status==SYSEX7_START))
+            {
+                SysExBuffer[0]=0xF0;
+                SysExSize=1;
+                SysExActive=true;
+            }
+            else if (SysExActive==false) return 0;          // Start of SYSEX has been lost
+
+            for (ByteNum=0; ByteNum<NumBytes; ByteNum++)
+            {
+                // Bytes 2 to 7 of the packet
+                if (ByteNum<2) SysExBuffer[SysExSize++]=(unsigned char)(Words[0]>>(8*(1-ByteNum)))&0x7F;
+                else SysExBuffer[SysExSize++]=(unsigned char)(Words[1]>>(8*(5-ByteNum)))&0x7F;
+            }
+
+            if ((Status==SYSEX7_COMPLETE)||(Status==SYSEX7_END))
+            {
+                SysExBuffer[SysExSize++]=0xF7;
+                SysExActive=false;
+            }
+            else if (SysExSize+6<=UMP_SYSEX_PART_SIZE) return 0;     // Wait for next packet
+
+            // Complete SYSEX or buffer full : part is sent, next part continues without F0
+            Messages[0].Data=&SysExBuffer[0];
+            Messages[0].Size=SysExSize;
+            SysExSize=0;
+            return 1;
+
+        case UMP_MT_MIDI2_VOICE :
+            Channel=Status&0x0F;
+            switch (Status>>4)
+            {
+                case 0x8 :          // Note off
+                    return AddShort (Messages, 0, 0x80|Channel, Byte3, (unsigned char)(Words[1]>>25), 3);
+                case 0x9 :          // Note on, velocity 0 is not a note off in MIDI 2.0
+                    Value=Words[1]>>25;
+                    if (Value==0) Value=1;
+                    return AddShort (Messages, 0, 0x90|Channel, Byte3, (unsigned char)Value, 3);
+                case 0xA :          // Poly pressure
+                    return AddShort (Messages, 0, 0xA0|Channel, Byte3, (unsigned char)(Words[1]>>25), 3);
+                case 0xB :          // Control change
+                    return AddShort (Messages, 0, 0xB0|Channel, Byte3, (unsigned char)(Words[1]>>25), 3);
+                case 0xC :          // Program change, with bank select if bank is valid
+                    if (Byte4&0x01)
+                    {
+                        Count=AddShort (Messages, Count, 0xB0|Channel, 0, (unsigned char)(Words[1]>>8), 3);
+                        Count=AddShort (Messages, Count, 0xB0|Channel, 32, (unsigned char)Words[1], 3);
+                    }
+                    return AddShort (Messages, Count, 0xC0|Channel, (unsigned char)(Words[1]>>24), 0, 2);
+                case 0xD :          // Channel pressure
+                    return AddShort (Messages, 0, 0xD0|Channel, (unsigned char)(Words[1]>>25), 0, 2);
+                case 0xE :          // Pitch bend
+                    Value=Words[1]>>18;
+                    return AddShort (Messages, 0, 0xE0|Channel, (unsigned char)Value, (unsigned char)(Value>>7), 3);
+                case 0x2 :          // Registered controller
+                case 0x3 :          // Assignable controller
+                    Count=AddShort (Messages, Count, 0xB0|Channel, ((Status>>4)==0x2) ? 101 : 99, Byte3, 3);
+                    Count=AddShort (Messages, Count, 0xB0|Channel, ((Status>>4)==0x2) ? 100 : 98, Byte4, 3);
+                    Count=AddShort (Messages, Count, 0xB0|Channel, 6, (unsigned char)(Words[1]>>25), 3);
+                    return AddShort (Messages, Count, 0xB0|Channel, 38, (unsigned char)(Words[1]>>18), 3);
+                default :
+                    return 0;
+            }
+
+        default :
+            return 0;
+    }
+}  // CUMPToMIDI1::Translate
+//-----------------------------------------------------------------------------
+
+unsigned int MIDI1ToUMP (const unsigned char* Data, unsigned int Size, unsigned int* Position, uint32_t* Packet)
+{
+    unsigned int End;
+    unsigned int NumBytes;
+    unsigned int ByteNum;
+    unsigned int Status;
+    unsigned char Bytes[6];
+    bool First;
+
+    if ((Size==0)||(*Position>=Size)) return 0;
+
+    if (Data[0]==0xF0)
+    {
+        // Payload of SYSEX packets does not include F0 and F7
+        End=(Data[Size-1]==0xF7) ? Size-1 : Size;
+        First=(*Position==0);
+        if (First) *Position=1;
+        if ((*Position>=End)&&(First==false))
+        {
+            *Position=Size;
+            return 0;
+        }
+
+        NumBytes=End-*Position;
+        if (NumBytes>6) NumBytes=6;
+        memset (&Bytes[0], 0, sizeof(Bytes));
+        for (ByteNum=0; ByteNum<NumBytes; ByteNum++) Bytes[ByteNum]=Data[*Position+ByteNum]&0x7F;
+        *Position+=NumBytes;
+
+        if (*Position>=End)
+        {
+            Status=First ? SYSEX7_COMPLETE : SYSEX7_END;
+            *Position=Size;
+        }
+        else Status=First ? SYSEX7_START : SYSEX7_CONTINUE;
+
+        Packet[0]=(UMP_MT_SYSEX7<<28)|(Status<<20)|(NumBytes<<16)|((uint32_t)Bytes[0]<<8)|Bytes[1];
+        Packet[1]=((uint32_t)Bytes[2]<<24)|((uint32_t)Bytes[3]<<16)|((uint32_t)Bytes[4]<<8)|Bytes[5];
+        return 2;
+    }
+
+    *Position=Size;
+    if (Data[0]<0x80) return 0;                 // Not a complete message
+    if (Data[0]==0xF7) return 0;
+
+    Packet[0]=((Data[0]<0xF0) ? (uint32_t)UMP_MT_MIDI1_VOICE<<28 : (uint32_t)UMP_MT_SYSTEM<<28)|((uint32_t)Data[0]<<16);
+    if (Size>1) Packet[0]|=(uint32_t)(Data[1]&0x7F)<<8;
+    if (Size>2) Packet[0]|=(uint32_t)(Data[2]&0x7F);
+    return 1;
+}  // MIDI1ToUMP
+//-----------------------------------------------------------------------------
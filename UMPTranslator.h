@@ -0,0 +1,80 @@
+/*
+ * File:   UMPTranslator.h
+ * Translation between UMP packets and MIDI 1.0 messages
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Used when JACK does not provide UMP ports : UMP packets received from NetUMP are converted
+ into MIDI 1.0 messages for JACK, and MIDI 1.0 messages from JACK into UMP packets (MIDI 1.0
+ channel voice, system and 7 bits SYSEX message types, group 0)
+ MIDI 2.0 channel voice messages are scaled down to MIDI 1.0 resolution. Registered and
+ assignable controllers become RPN / NRPN sequences, program change with bank becomes bank
+ select + program change. Messages without MIDI 1.0 equivalent (per note controllers,...) are dropped
+ */
+
+#ifndef __UMPTRANSLATOR_H__
+#define __UMPTRANSLATOR_H__
+
+#include <stdint.h>
+
+// Largest part of a SYSEX sent as one MIDI 1.0 message (a longer SYSEX is sent in several parts)
+#define UMP_SYSEX_PART_SIZE     512
+
+// Largest number of MIDI 1.0 messages generated by one UMP packet (RPN / NRPN)
+#define UMP_MAX_MIDI1_MESSAGES  4
+
+typedef struct {
+    unsigned char* Data;
+    unsigned int Size;
+} TMIDI1Message;
+
+class CUMPToMIDI1
+{
+public:
+    CUMPToMIDI1 (void);
+
+    // Forgets any SYSEX being received
+    void Reset (void);
+
+    // Converts one UMP packet. Returns the number of complete MIDI 1.0 messages written in Messages
+    // Messages point to internal buffers, valid until next call
+    unsigned int Translate (const uint32_t* Words, TMIDI1Message* Messages);
+
+private:
+    unsigned char SysExBuffer[UMP_SYSEX_PART_SIZE+8];
+    unsigned int SysExSize;
+    bool SysExActive;
+    unsigned char ShortBuffer[UMP_MAX_MIDI1_MESSAGES][4];
+
+    unsigned int AddShort (TMIDI1Message* Messages, unsigned int Count, unsigned char Status, unsigned char Data1, unsigned char Data2, unsigned int Size);
+};
+
+// Converts a complete MIDI 1.0 message into UMP packets, one packet per call
+// Position must be 0 for the first call. Returns the number of words written in Packet, 0 when the message is finished
+unsigned int MIDI1ToUMP (const unsigned char* Data, unsigned int Size, unsigned int* Position, uint32_t* Packet);
+
+#endif
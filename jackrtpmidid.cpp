@@ -57,6 +57,34 @@ V0.9 - 17/02/2024
 V1.0 - 07/07/2024
   - added support for a second connexion (allow the Zynthian to be controlled by sequencer and keyboard at the same time)
   - main loop replaced by a high priority thread to get best possible timing even with high CPU load
+
+V1.1 - 16/10/2026
+  - realtime thread is now event driven (epoll on session sockets, timer for session timers, eventfd from JACK)
+  - received MIDI events are timestamped and placed at their exact position in JACK period (-latency option)
+  - byte FIFOs replaced by lock-free queues of complete MIDI events (no more MIDI parsing in JACK callback)
+  - events from JACK are sent to the RTP-MIDI sessions by the realtime thread
+  - large SYSEX messages are streamed in chunks (no more 512 bytes limit, split into several JACK events if needed)
+  - any number of sessions (up to 32) from command line (-sessions) or configuration file (-config)
+  - optional JACK ports per session (-multiport)
+  - routing matrix between sessions and JACK ports with MIDI channel filters (-routes)
+  - events from one JACK period are sent in a single RTP-MIDI packet per session (delta-times and running status)
+  - traffic, overflow and latency counters published in shared memory (read with tools/jackrtpmidistat)
+  - state repaired from RTP-MIDI recovery journal after packet loss, note off and sustain release repeated to the network
+  - optional adaptive jitter buffer for received events (-jitter option or jitter line in configuration file)
+  - realtime thread priority relative to JACK (-rtprio), CPU pinning (-rtcpu, -jackcpu), memory locking (-mlock)
+  - allocations and page faults in realtime threads reported in statistics
+  - realtime audit build (__RT_AUDIT__) reporting allocations, stdio, locks and sleeps in realtime threads
+  - optional Network MIDI 2.0 (NetUMP) endpoint with its own JACK ports, as UMP ports or translated to MIDI 1.0 (-netump, -jackump)
+  - received packets timestamped by the kernel (SO_TIMESTAMPNS), NetUMP socket read and written by batches (recvmmsg / sendmmsg)
+  - sent events keep their position in the JACK period (first delta-time of each packet counted from a constant origin, -txlatency)
+  - clock model of each peer from its CK exchanges : received events placed from sender timestamps, drift corrected in jitter buffer
+  - message filters per session and direction : drop classes, remove repeated values, thin and merge controller updates (-filters)
+  - sessions, routing and filters read again on SIGHUP without closing the JACK client (unchanged sessions keep their peers)
+  - sessions shared by several realtime threads with their own queues, merged in time order in JACK callback (-rtthreads)
+  - only the header of received packets is peeked (whole packet when journal is needed), events queued to JACK published once per wake up
+  - capture of received packets and JACK events to a file (-capture), replayed with tools/jackrtpmidireplay
+  - received data split in complete messages by a parser per session (running status, realtime inside SYSEX, SYSEX over several blocks), invalid bytes discarded
+  - events of a JACK period sent at a deadline after the period start (-txdeadline), JACK to network latency measured in statistics
  */
 
 #include <stdio.h>
@@ -67,283 +95,2027 @@ V1.0 - 07/07/2024
 #include <string.h>
 #include <math.h>
 #include <signal.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include "RTP_MIDI.h"
+#include "SystemSleep.h"
+#include "CThread.h"
+#include "RTEventLoop.h"
+#include "MIDIEventQueue.h"
+#include "SysExPool.h"
+#include "SessionManager.h"
+#include "RoutingMatrix.h"
+#include "RTPMIDIPacket.h"
+#include "Statistics.h"
+#include "RecoveryJournal.h"
+#include "JitterBuffer.h"
+#include "ClockModel.h"
+#include "MIDIFilter.h"
+#include "UMPQueue.h"
+#include "UMPTranslator.h"
+#include "NetUMP.h"
+#include "RTSetup.h"
+#include "RTAudit.h"
+#include "Capture.h"
+#include "MIDIParser.h"
+
+// Time between two repeats of a note off sent to the network (ms)
+#define RELEASE_REPEAT_MS       20
+
+// Maximum delta-time accepted from a received packet (frames = SampleRate/MAX_DELTA_DIVIDER)
+#define MAX_DELTA_DIVIDER       10
+
+// Maximum number of packets given to a session handler in one wake up
+#define MAX_PACKETS_PER_WAKEUP  8
+
+// RTP-MIDI timers count RunSession calls, including the calls made to read packets. A session may be run ahead
+// of the timer ticks by this number of calls, then its sockets are not read before next tick
+// (library timeouts are counted in seconds : the timers are never more than 100ms early)
+#define MAX_TIMER_LEAD          100
+
+// Bytes peeked from each datagram before the handler reads it : RTP header, or a whole CK packet
+// The rest of the packet is peeked only when its journal is needed
+#define PEEK_HEADER_SIZE        36
+
+// Period of the capture writer thread (ms)
+#define CAPTURE_WRITE_MS        10
+
+// Timer ticks between two updates of realtime thread health counters
+#define HEALTH_CHECK_TICKS      1000
+
+// JACK port flag for ports carrying UMP instead of MIDI 1.0 (JACK 1.9.22 and PipeWire)
+#define JACK_PORT_IS_MIDI2      0x20
+
+// Maximum number of realtime worker threads (-rtthreads)
+#define MAX_RT_WORKERS          8
+
+jack_client_t *client=0;
+jack_port_t *input_port;
+jack_port_t *output_port;
+bool MultiPort=false;                   // Create one input and one output JACK port per session
+jack_port_t* SessionInputPorts[MAX_SESSIONS];
+jack_port_t* SessionOutputPorts[MAX_SESSIONS];
+jack_nframes_t SampleRate=48000;
+jack_nframes_t LatencyFrames=0;         // Fixed latency added to received events. 0 = one JACK period
+int TXLatencyFrames=-1;                 // Delay between JACK frame time and RTP time of sent events. -1 = 1 ms
+int TXDeadlineMicros=-1;                // Events of a JACK period are sent at period start + deadline. -1 = as soon as jack_process has run
+bool break_request=false;
+bool reload_request=false;              // SIGHUP received : configuration files must be read again
+
+// Session definitions (read again on reload)
+const char* ConfigFileName=0;
+const char* RoutingFileName=0;
+const char* FilterFileName=0;
+unsigned int NumDefaultSessions=DEFAULT_NUM_SESSIONS;
+unsigned short BasePort=DEFAULT_BASE_PORT;
+bool JitterEnabled=false;
+unsigned int JitterMinMs=0;
+unsigned int JitterMaxMs=0;
+
+CSessionManager* SessionPool=0;
+CRoutingMatrix* JACKRouting=0;          // Used by jack_process
+CFilterSet* JACKFilters=0;              // Used by jack_process
+unsigned int JACKNumSessions=0;         // Sessions with their own JACK ports (jack_process)
+
+// Configuration published by main thread on reload. Each realtime thread takes it at the start of its next cycle
+// and acknowledges with the generation taken : objects replaced are deleted when all threads have taken the new ones
+typedef struct {
+    CRoutingMatrix* Routing;
+    CFilterSet* Filters;
+    unsigned int NumSessions;
+    uint32_t CloseMask;                 // Sessions no longer serviced by realtime thread
+    uint32_t OpenMask;                  // Sessions serviced from now on
+    uint32_t RenameMask;                // Sessions whose handler takes the new name
+} TRuntimeConfig;
+TRuntimeConfig NextConfig;
+std::atomic<uint32_t> ConfigGeneration(0);
+std::atomic<uint32_t> JACKGeneration(0);
+CStatistics* Statistics=0;
+TStatsBlock* Stats=0;                   // Counters (always valid once Statistics is opened)
+
+// Realtime worker thread. Session n is serviced by worker n % NumWorkers, which has its own event loop and its own
+// queues with jack_process : a busy session only delays the sessions of the same worker.
+// jack_process merges the events received by all workers in time order
+typedef struct {
+    CThread* Thread;
+    CRTEventLoop* Loop;                 // 0 if the event loop is not available (polling mode)
+    uint32_t SessionMask;               // Sessions serviced by the worker
+    bool PinThread;
+    cpu_set_t CPUs;
+    CSysExPool* ToJACKPool;             // Chunks allocated by the worker, freed by jack_process
+    CMIDIEventQueue* FromJACK;          // Events from JACK for the sessions of the worker
+    CSysExPool* FromJACKPool;           // Chunks allocated by jack_process, freed by the worker
+    std::atomic<uint64_t> TXCycleNanos; // Start of oldest JACK period not yet sent (CLOCK_MONOTONIC ns, 0 : none)
+    CRoutingMatrix* Routing;            // Configuration taken by the worker
+    CFilterSet* Filters;
+    std::atomic<uint32_t> Generation;   // Generation of the configuration taken by the worker
+    uint32_t TXPendingMask;             // Bit n set when packet of session n is not empty
+    uint32_t ArrivalValidMask;          // Bit n set while SessionArrival[n] is valid
+    uint32_t TimestampValidMask;        // Bit n set while SessionTimestamp[n] is valid
+    uint32_t PausedMask;                // Bit n set while sockets of session n are not read (timers too far ahead)
+    unsigned char Packet[2048];         // Header (or whole packet when journal is needed) peeked from a data socket
+} TRTWorker;
+
+TRTWorker Workers[MAX_RT_WORKERS];
+unsigned int NumWorkers=1;
+std::atomic<unsigned int> StartedWorkers(0);    // Workers are given to the threads in their start order
+int JACKSysExSession=-1;                // Session whose SYSEX is being sent to JACK, -1 if none (jack_process only)
+unsigned int JACKChunkPos=0;            // Bytes of current chunk already sent to JACK (jack_process only)
+
+// State of each session, used only by the worker of the session
+CRTPMIDIPacket TXPackets[MAX_SESSIONS];                 // Packet being built for each session
+CReleaseGuard TXGuards[MAX_SESSIONS];                   // Releases repeated to each session
+CRecoveryJournal RXJournals[MAX_SESSIONS];              // State received from each session
+CMIDIParser RXParsers[MAX_SESSIONS];                    // Running status and incomplete messages received from each session
+CMIDIEventQueue* ToJACKQueues[MAX_SESSIONS];            // Events received from each session, merged in time order by jack_process
+uint32_t ToJACKMarks[MAX_SESSIONS];                     // Queue position at last commit
+unsigned int TimerLeads[MAX_SESSIONS];                  // RunSession calls made ahead of the timer ticks
+CJitterBuffer JitterBuffers[MAX_SESSIONS];              // Playout delay of events received from each session
+jack_nframes_t SessionArrival[MAX_SESSIONS];            // Kernel arrival time of the packet being read by each session
+CClockModel ClockModels[MAX_SESSIONS];                  // Clock of the peer of each session
+uint32_t SessionTimestamp[MAX_SESSIONS];                // RTP timestamp of the packet being read by each session
+
+CNetUMP* NetUMP=0;                      // 0 if NetUMP is not enabled
+unsigned short NetUMPPort=0;
+bool JACKUMPPorts=false;                // NetUMP JACK ports carry UMP (else MIDI 1.0 with translation)
+jack_port_t* UMPInputPort;
+jack_port_t* UMPOutputPort;
+CUMPQueue* UMP2JACK=0;
+CUMPQueue* JACK2UMP=0;
+CUMPToMIDI1 UMPToJACK;                  // SYSEX reassembly state (jack_process only)
+
+CCapture* Capture=0;                    // 0 if capture is not enabled. Producer n = worker n, NumWorkers = jack_process
+const char* CaptureFileName=0;
+CThread* CaptureThread=0;
+
+bool PriorityFromJACK=false;            // Realtime thread priority is relative to JACK client threads
+int PriorityOffset=0;
+bool PinRTThread=false;
+cpu_set_t RTThreadCPUs;
+bool PinJACKThread=false;
+cpu_set_t JACKThreadCPUs;
+
+// Worker servicing a session
+inline TRTWorker* WorkerOf (unsigned int SessionNum)
+{
+    return &Workers[SessionNum%NumWorkers];
+}  // WorkerOf
+//-----------------------------------------------------------------------------
+
+// Stores a MIDI message in an event queue. SYSEX too big for a record are copied into chunks from the pool
+// Flags are stored in the record of a message which is not split in chunks
+// Records are not committed. Returns false if the message is dropped (queue or pool full)
+bool QueueMIDIMessage (CMIDIEventQueue* Queue, CSysExPool* Pool, uint32_t Time, uint8_t Source, unsigned char* Data, unsigned int Size, uint8_t Flags)
+{
+    TMIDIEventHeader* Event;
+    TSysExChunkRef* ChunkRef;
+    uint32_t Mark;
+    unsigned int NumChunks;
+    unsigned int ChunkNum;
+    unsigned int Offset;
+
+    if (Size<=SYSEX_CHUNK_SIZE)
+    {
+        Event=Queue->Reserve (Size);
+        if (Event==0) return false;
+        Event->Time=Time;
+        Event->Source=Source;
+        Event->Flags=Flags;
+        memcpy (CMIDIEventQueue::EventData(Event), Data, Size);
+        return true;
+    }
+
+    // Message is stored only if all chunks are available (a truncated SYSEX would be worse than no SYSEX)
+    NumChunks=(Size+SYSEX_CHUNK_SIZE-1)/SYSEX_CHUNK_SIZE;
+    if (Pool->Available()<NumChunks) return false;
+
+    // Reserve all records first : chunks can not be given back to the pool from this thread
+    Mark=Queue->GetMark();
+    for (ChunkNum=0; ChunkNum<NumChunks; ChunkNum++)
+    {
+        if (Queue->Reserve (sizeof(TSysExChunkRef))==0)
+        {
+            Queue->Rollback (Mark);
+            return false;
+        }
+    }
+
+    // Records are consecutive in the queue, except when padding has been inserted : walk them again from the mark
+    Queue->Rollback (Mark);
+    Offset=0;
+    for (ChunkNum=0; ChunkNum<NumChunks; ChunkNum++)
+    {
+        Event=Queue->Reserve (sizeof(TSysExChunkRef));
+        Event->Time=Time;
+        Event->Source=Source;
+        Event->Flags=EVENT_FLAG_CHUNK;
+        ChunkRef=(TSysExChunkRef*)CMIDIEventQueue::EventData(Event);
+        ChunkRef->Chunk=(uint16_t)Pool->Alloc();
+        ChunkRef->Length=(uint16_t)(Size-Offset>SYSEX_CHUNK_SIZE ? SYSEX_CHUNK_SIZE : Size-Offset);
+        memcpy (Pool->ChunkData(ChunkRef->Chunk), &Data[Offset], ChunkRef->Length);
+        Offset+=ChunkRef->Length;
+    }
+    return true;
+}  // QueueMIDIMessage
+//-----------------------------------------------------------------------------
+
+// Sends the packet built for a session and starts a new one
+void FlushPacket (TRTWorker* Worker, unsigned int SessionNum)
+{
+    CRTPMIDIPacket* Packet=&TXPackets[SessionNum];
+
+    if (Packet->IsEmpty()==false)
+    {
+        SessionPool->Sessions[SessionNum].Handler->SendRTPMIDIBlock (Packet->Size, &Packet->Data[0]);
+        StatsAdd (Stats->Sessions[SessionNum].PacketsSent, 1);
+    }
+    Packet->Clear();
+    Worker->TXPendingMask&=~(1u<<SessionNum);
+}  // FlushPacket
+//-----------------------------------------------------------------------------
+
+// Adds a MIDI message, or a part of a SYSEX message, to the packets of the sessions selected in SessionMask
+// SYSEX parts are sent as RTP-MIDI segments (RFC6295 : F0..F0 / F7..F0 / F7..F7)
+// If Chunk is not -1, one reference of the chunk is released for each session
+void AddToPackets (TRTWorker* Worker, uint32_t Time, unsigned char* Data, unsigned int Size, uint32_t SessionMask, CSysExPool* Pool, int Chunk)
+{
+    bool Start, End;
+    bool Continuation, Continues;
+    unsigned int SessionNum;
+    TSessionSlot* Session;
+
+    Start=(Data[0]==0xF0);
+    End=(Data[Size-1]==0xF7);
+
+    while (SessionMask!=0)
+    {
+        SessionNum=__builtin_ctz (SessionMask);
+        SessionMask&=SessionMask-1;
+        Session=&SessionPool->Sessions[SessionNum];
+
+        Continuation=false;
+        if ((Start==false)&&(Session->TXSYSEXActive))
+        {
+            if (Data[0]<0x80)
+            {  // Continuation of a SYSEX segmented by JACK or by us
+                Continuation=true;
+            }
+            else if (Data[0]<0xF8)
+            {  // Status byte (not realtime) cancels the current SYSEX
+                Session->TXSYSEXActive=false;
+            }
+        }
+
+        Continues=((Start)||(Continuation))&&(End==false);
+        if ((Start)||(Continuation)) Session->TXSYSEXActive=Continues;
+
+        if (TXPackets[SessionNum].Append (Time, Data, Size, Continuation, Continues)==false)
+        {  // Packet is full : send it and start next one with this event
+            FlushPacket (Worker, SessionNum);
+            TXPackets[SessionNum].Append (Time, Data, Size, Continuation, Continues);
+        }
+        Worker->TXPendingMask|=(1u<<SessionNum);
+        if ((Start==false)&&(Continuation==false)) TXGuards[SessionNum].TrackCommand (Data, Size, Time);
+        if (Continuation==false) StatsAdd (Stats->Sessions[SessionNum].ToNetwork.Messages, 1);
+        StatsAdd (Stats->Sessions[SessionNum].ToNetwork.Bytes, Size);
+
+        // A segment ending with F0 must be the last command of the list
+        if (Continues) FlushPacket (Worker, SessionNum);
+
+        if (Chunk!=-1) Pool->Release (Chunk);
+    }
+}  // AddToPackets
+//-----------------------------------------------------------------------------
+
+// Returns the sessions of the worker to which an event from a JACK input port must be sent
+uint32_t GetTargetSessions (TRTWorker* Worker, unsigned int Port, unsigned char Status)
+{
+    uint32_t Mask;
+    uint32_t Targets=0;
+    unsigned int SessionNum;
+
+    Mask=Worker->Routing->GetPortSessions (Port)&SessionPool->OpenedMask&Worker->SessionMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        if (Worker->Routing->ChannelAllowed (SessionNum, Status)) Targets|=(1u<<SessionNum);
+    }
+    return Targets;
+}  // GetTargetSessions
+//-----------------------------------------------------------------------------
+
+// Removes from Targets the sessions whose outbound filter drops the event
+uint32_t FilterTargets (TRTWorker* Worker, TMIDIEventHeader* Event, const unsigned char* Data, unsigned int Size, uint32_t Targets)
+{
+    uint32_t Mask;
+    unsigned int SessionNum;
+    CFilterSet* Filters=Worker->Filters;
+
+    Mask=Targets&Filters->OutMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        if (((Event->Flags&EVENT_FLAG_SUPERSEDED)&&(Filters->MergeMask&(1u<<SessionNum)))||
+            (Filters->Out[SessionNum].Check (Data, Size, Event->Time)==false))
+        {
+            Targets&=~(1u<<SessionNum);
+            StatsAdd (Stats->Sessions[SessionNum].ToNetwork.Filtered, 1);
+        }
+    }
+    return Targets;
+}  // FilterTargets
+//-----------------------------------------------------------------------------
+
+// Called for each message held by an outbound filter when its interval has elapsed. Instance is the slot of the session
+// Time is not used : end of interval is already passed and events of a packet must be in time order
+void FilteredToNetwork (void* Instance, unsigned char* Data, unsigned int Size, uint32_t Time)
+{
+    TSessionSlot* Session=(TSessionSlot*)Instance;
+
+    (void)Time;
+    AddToPackets (WorkerOf (Session->Index), jack_frame_time(client), Data, Size, 1u<<Session->Index, 0, -1);
+}  // FilteredToNetwork
+//-----------------------------------------------------------------------------
+
+// Counts the time between the start of the JACK period which produced sent data and the end of the sending
+void CountTXLatency (uint64_t CycleStart)
+{
+    struct timespec Now;
+    uint64_t NowNanos;
+    uint32_t Micros=0;
+    uint32_t Bound;
+
+    clock_gettime (CLOCK_MONOTONIC, &Now);
+    NowNanos=((uint64_t)Now.tv_sec*1000000000ull)+(uint64_t)Now.tv_nsec;
+    if (NowNanos>CycleStart) Micros=(uint32_t)((NowNanos-CycleStart)/1000);
+
+    StatsHistogram (&Stats->TXLatency[0], Micros);
+    StatsMaxShared (Stats->MaxTXLatencyMicros, Micros);
+
+    // Data must leave before the end of the period following its deadline (period start without deadline)
+    Bound=Stats->JACKPeriodMicros.load (std::memory_order_relaxed);
+    if (TXDeadlineMicros>0) Bound+=(uint32_t)TXDeadlineMicros;
+    if (Micros>Bound) StatsAddShared (Stats->TXLate, 1);
+}  // CountTXLatency
+//-----------------------------------------------------------------------------
+
+// Sends to the RTP-MIDI sessions of a worker the events queued by jack_process
+// All events available are coalesced in one packet per session (jack_process commits a whole period at once)
+// Each packet is stamped by the handler when it is sent : its origin is the send time minus TXLatencyFrames,
+// so an event at frame F always leaves with RTP time F + TXLatencyFrames (events are at most one period old)
+// Called from the worker thread only
+void TransmitToNetwork (TRTWorker* Worker)
+{
+    TMIDIEventHeader* Event;
+    TSysExChunkRef* ChunkRef;
+    unsigned char* Data;
+    uint32_t Targets;
+    unsigned int SessionNum;
+    uint32_t Mask;
+    jack_nframes_t Now;
+    CMIDIEventQueue* Queue=Worker->FromJACK;
+    CSysExPool* Pool=Worker->FromJACKPool;
+    uint64_t CycleStart;
+
+    // Taken before the queue is read : a period committed meanwhile may be sent now and measured with the next
+    // one, so the latency is never underestimated
+    CycleStart=Worker->TXCycleNanos.exchange (0, std::memory_order_relaxed);
+
+    Now=jack_frame_time(client);
+    Mask=SessionPool->OpenedMask&Worker->SessionMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        TXPackets[SessionNum].SetOrigin (Now-(jack_nframes_t)TXLatencyFrames);
+    }
+
+    while ((Event=Queue->Peek())!=0)
+    {
+        if (Event->Flags&EVENT_FLAG_CHUNK)
+        {
+            ChunkRef=(TSysExChunkRef*)CMIDIEventQueue::EventData(Event);
+            Data=Pool->ChunkData(ChunkRef->Chunk);
+            Targets=GetTargetSessions (Worker, Event->Source, Data[0]);
+            Targets=FilterTargets (Worker, Event, Data, ChunkRef->Length, Targets);
+            // Chunk stays in the pool until all target sessions have used it
+            Pool->SetReferences (ChunkRef->Chunk, __builtin_popcount (Targets));
+            if (Targets!=0)
+                AddToPackets (Worker, Event->Time, Data, ChunkRef->Length, Targets, Pool, ChunkRef->Chunk);
+        }
+        else if (Event->Size>0)
+        {
+            Data=CMIDIEventQueue::EventData(Event);
+            Targets=GetTargetSessions (Worker, Event->Source, Data[0]);
+            Targets=FilterTargets (Worker, Event, Data, Event->Size, Targets);
+            if (Targets!=0)
+                AddToPackets (Worker, Event->Time, Data, Event->Size, Targets, 0, -1);
+        }
+
+        Queue->Pop();
+    }
+
+    // Releases to be repeated and thinned controllers go in the same packets, or in their own packet if nothing else is sent
+    Mask=SessionPool->OpenedMask&Worker->SessionMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        if ((Worker->Filters->OutMask&(1u<<SessionNum))&&(SessionPool->Sessions[SessionNum].TXSYSEXActive==false))
+            Worker->Filters->Out[SessionNum].FlushDue (Now, &FilteredToNetwork, &SessionPool->Sessions[SessionNum]);
+        if (TXGuards[SessionNum].HasPending()==false) continue;
+        if (SessionPool->Sessions[SessionNum].TXSYSEXActive) continue;     // Status byte would cancel the SYSEX
+        if (TXGuards[SessionNum].AppendDue (&TXPackets[SessionNum], Now))
+            Worker->TXPendingMask|=(1u<<SessionNum);
+    }
+
+    while (Worker->TXPendingMask!=0)
+    {
+        SessionNum=__builtin_ctz (Worker->TXPendingMask);
+        FlushPacket (Worker, SessionNum);
+    }
+
+    // A period is counted even if filters or routes have sent nothing from it
+    if (CycleStart!=0) CountTXLatency (CycleStart);
+}  // TransmitToNetwork
+//-----------------------------------------------------------------------------
+
+// Called for each MIDI message rebuilt from a recovery journal. Instance is the slot of the session
+void JournalRepair (void* Instance, unsigned char* Data, unsigned int Size)
+{
+    TSessionSlot* Session=(TSessionSlot*)Instance;
+    TRTWorker* Worker=WorkerOf (Session->Index);
+    bool Queued;
+
+    Queued=QueueMIDIMessage (ToJACKQueues[Session->Index], Worker->ToJACKPool, jack_frame_time(client), (uint8_t)Session->Index, Data, Size, 0);
+    StatsCountMessage (&Stats->Sessions[Session->Index].FromNetwork, Data, Size, Queued);
+}  // JournalRepair
+//-----------------------------------------------------------------------------
+
+// Called for each message held by an inbound filter when its interval has elapsed. Instance is the slot of the session
+// The message is played at the end of its interval, so it is never before the message it follows
+void FilteredToJACK (void* Instance, unsigned char* Data, unsigned int Size, uint32_t Time)
+{
+    TSessionSlot* Session=(TSessionSlot*)Instance;
+    TRTWorker* Worker=WorkerOf (Session->Index);
+    bool Queued;
+
+    Queued=QueueMIDIMessage (ToJACKQueues[Session->Index], Worker->ToJACKPool, Time, (uint8_t)Session->Index, Data, Size, 0);
+    if (Queued) RXJournals[Session->Index].TrackCommand (Data, Size);
+    StatsCountMessage (&Stats->Sessions[Session->Index].FromNetwork, Data, Size, Queued);
+}  // FilteredToJACK
+//-----------------------------------------------------------------------------
+
+// Sends to JACK the messages held by the inbound filters of a worker whose interval has elapsed
+// Received events are never scheduled before their arrival : an interval ended before now can not get a new value
+void FlushInboundFilters (TRTWorker* Worker)
+{
+    uint32_t Mask;
+    unsigned int SessionNum;
+    jack_nframes_t Now;
+
+    Mask=Worker->Filters->InMask&SessionPool->OpenedMask&Worker->SessionMask;
+    if (Mask==0) return;
+
+    Now=jack_frame_time(client);
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        Worker->Filters->In[SessionNum].FlushDue (Now, &FilteredToJACK, &SessionPool->Sessions[SessionNum]);
+    }
+}  // FlushInboundFilters
+//-----------------------------------------------------------------------------
+
+// Makes the events queued for JACK since the last call visible to jack_process at once (worker thread)
+// A burst of messages (MPE, packets with many commands) is published with a single release store
+void CommitToJACK (TRTWorker* Worker)
+{
+    uint32_t Mark;
+    uint32_t Mask=Worker->SessionMask;
+    unsigned int SessionNum;
+
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        Mark=ToJACKQueues[SessionNum]->GetMark();
+        if (Mark==ToJACKMarks[SessionNum]) continue;
+        ToJACKQueues[SessionNum]->Commit();
+        ToJACKMarks[SessionNum]=Mark;
+        StatsMaxShared (Stats->MaxFillToJACK, ToJACKQueues[SessionNum]->GetFill());
+    }
+}  // CommitToJACK
+//-----------------------------------------------------------------------------
+
+// Converts a kernel receive timestamp (CLOCK_REALTIME) to JACK frame time
+// The time spent by the packet in the socket buffer is removed from current frame time
+// Returns current frame time if the kernel did not give a timestamp
+jack_nframes_t KernelTimeToFrames (const struct timespec* Arrival)
+{
+    struct timespec Now;
+    int64_t AgeNanos;
+    jack_nframes_t FrameNow;
+
+    FrameNow=jack_frame_time(client);
+    if ((Arrival->tv_sec==0)&&(Arrival->tv_nsec==0)) return FrameNow;
+
+    clock_gettime (CLOCK_REALTIME, &Now);
+    AgeNanos=(int64_t)(Now.tv_sec-Arrival->tv_sec)*1000000000LL+(Now.tv_nsec-Arrival->tv_nsec);
+    if (AgeNanos<=0) return FrameNow;
+    if (AgeNanos>1000000000LL) AgeNanos=1000000000LL;              // Clock stepped : age is meaningless
+    return FrameNow-(jack_nframes_t)((AgeNanos*SampleRate)/1000000000LL);
+}  // KernelTimeToFrames
+//-----------------------------------------------------------------------------
+
+// Looks at the packet waiting on the data socket of a session before the RTP-MIDI handler reads it
+// When packets have been lost, the state is repaired from the journal before the commands of the packet are delivered
+// The RTP timestamp of the packet is given to the jitter buffer, which schedules the commands
+// The kernel receive time of the packet is stored in SessionArrival
+// Clock synchronization packets (CK) from the peer update the clock model of the session
+// Only the header of the packet is copied, unless the journal is needed or the packet is captured : the handler reads the packet anyway
+// Returns false if no packet is waiting
+bool PeekPacket (TRTWorker* Worker, unsigned int SessionNum)
+{
+    int Socket;
+    ssize_t Size;
+    unsigned int PeekedSize;
+    unsigned int NumRepairs;
+    uint32_t Timestamp;
+    uint32_t SSRC;
+    struct msghdr Message;
+    struct iovec Vector;
+    unsigned char Control[CMSG_SPACE(sizeof(struct timespec))];
+    struct cmsghdr* ControlHeader;
+    struct timespec Arrival;
+    unsigned char* Packet=&Worker->Packet[0];
+
+    Socket=Worker->Loop->GetDataSocket (SessionNum);
+    if (Socket==-1) return false;
+
+    // MSG_TRUNC : real size of the datagram is returned even if only its header is copied
+    Vector.iov_base=Packet;
+    Vector.iov_len=(Capture!=0) ? sizeof(Worker->Packet) : PEEK_HEADER_SIZE;
+    memset (&Message, 0, sizeof(Message));
+    Message.msg_iov=&Vector;
+    Message.msg_iovlen=1;
+    Message.msg_control=Control;
+    Message.msg_controllen=sizeof(Control);
+    Size=recvmsg (Socket, &Message, MSG_PEEK|MSG_DONTWAIT|MSG_TRUNC);
+    if (Size<=0) return false;
+    PeekedSize=(Size>(ssize_t)Vector.iov_len) ? (unsigned int)Vector.iov_len : (unsigned int)Size;
+
+    Arrival.tv_sec=0;
+    Arrival.tv_nsec=0;
+    for (ControlHeader=CMSG_FIRSTHDR (&Message); ControlHeader!=0; ControlHeader=CMSG_NXTHDR (&Message, ControlHeader))
+    {
+        if ((ControlHeader->cmsg_level==SOL_SOCKET)&&(ControlHeader->cmsg_type==SCM_TIMESTAMPNS))
+            memcpy (&Arrival, CMSG_DATA (ControlHeader), sizeof(Arrival));
+    }
+    SessionArrival[SessionNum]=KernelTimeToFrames (&Arrival);
+    if (Capture) Capture->Record ((unsigned int)(Worker-&Workers[0]), CAPTURE_RX_DATAGRAM, (uint8_t)SessionNum, SessionArrival[SessionNum], &Arrival, Packet, PeekedSize);
+
+    Worker->TimestampValidMask&=~(1u<<SessionNum);
+
+    // Session control packets start with 0xFFFF
+    if ((PeekedSize>=36)&&(Packet[0]==0xFF)&&(Packet[1]==0xFF)&&(Packet[2]=='C')&&(Packet[3]=='K'))
+    {
+        if (ClockModels[SessionNum].ProcessCK (Packet, SessionArrival[SessionNum]))
+        {
+            JitterBuffers[SessionNum].SetClockRatio (ClockModels[SessionNum].GetRatio());
+            Stats->Sessions[SessionNum].ClockExchanges.store (ClockModels[SessionNum].Exchanges, std::memory_order_relaxed);
+            Stats->Sessions[SessionNum].ClockRejected.store (ClockModels[SessionNum].Rejected, std::memory_order_relaxed);
+            Stats->Sessions[SessionNum].ClockErrorMicros.store (ClockModels[SessionNum].GetSyncErrorMicros(), std::memory_order_relaxed);
+            Stats->Sessions[SessionNum].ClockDriftPPB.store (ClockModels[SessionNum].GetDriftPPB(), std::memory_order_relaxed);
+            Stats->Sessions[SessionNum].ClockRoundTripMicros.store (ClockModels[SessionNum].GetRoundTripMicros(), std::memory_order_relaxed);
+        }
+    }
+
+    // RTP packets
+    if ((PeekedSize>=12)&&((Packet[0]&0xC0)==0x80))
+    {
+        Timestamp=((uint32_t)Packet[4]<<24)|((uint32_t)Packet[5]<<16)|((uint32_t)Packet[6]<<8)|Packet[7];
+        SSRC=((uint32_t)Packet[8]<<24)|((uint32_t)Packet[9]<<16)|((uint32_t)Packet[10]<<8)|Packet[11];
+        SessionTimestamp[SessionNum]=Timestamp;
+        Worker->TimestampValidMask|=(1u<<SessionNum);
+        if (JitterBuffers[SessionNum].IsEnabled())
+        {
+            JitterBuffers[SessionNum].PacketArrival (SSRC, Timestamp, SessionArrival[SessionNum]);
+            Stats->Sessions[SessionNum].JitterDelayMicros.store (JitterBuffers[SessionNum].GetTargetMicros(), std::memory_order_relaxed);
+        }
+    }
+
+    // Packets have been lost : the whole packet is needed to read its journal
+    if ((PeekedSize<(unsigned int)Size)&&(RXJournals[SessionNum].NeedsJournal (Packet, PeekedSize)))
+    {
+        Vector.iov_len=sizeof(Worker->Packet);
+        Message.msg_control=0;
+        Message.msg_controllen=0;
+        Size=recvmsg (Socket, &Message, MSG_PEEK|MSG_DONTWAIT);
+        if (Size>0) PeekedSize=(unsigned int)Size;
+    }
+
+    NumRepairs=RXJournals[SessionNum].ProcessPacket (Packet, PeekedSize, &JournalRepair, &SessionPool->Sessions[SessionNum]);
+    Stats->Sessions[SessionNum].PacketsLost.store (RXJournals[SessionNum].LostPackets, std::memory_order_relaxed);
+    if (NumRepairs>0) StatsAdd (Stats->Sessions[SessionNum].JournalRepairs, NumRepairs);
+    return true;
+}  // PeekPacket
+//-----------------------------------------------------------------------------
+
+// Runs the sessions with a packet waiting. Each packet is peeked before the handler reads it,
+// so the handler is run once per packet (the jitter buffer needs the timestamp of each packet)
+// Each call also counts as a timer tick for the library : it is recorded in TimerLeads, so the session is not
+// run again by the timer until the ticks have caught up
+void ReceivePackets (TRTWorker* Worker, unsigned int ReadyMask)
+{
+    unsigned int SessionNum;
+    unsigned int PacketCount;
+
+    ReadyMask&=SessionPool->OpenedMask&Worker->SessionMask&~Worker->PausedMask;
+    while (ReadyMask!=0)
+    {
+        SessionNum=__builtin_ctz (ReadyMask);
+        ReadyMask&=ReadyMask-1;
+
+        // Handler is run at least once : the event may come from the control socket
+        if (PeekPacket (Worker, SessionNum)) Worker->ArrivalValidMask|=(1u<<SessionNum);
+        SessionPool->RunSessions (1u<<SessionNum);
+        ClockModels[SessionNum].HandlerDone (jack_frame_time(client));
+        TimerLeads[SessionNum]++;
+        PacketCount=1;
+        while ((PacketCount<MAX_PACKETS_PER_WAKEUP)&&(TimerLeads[SessionNum]<MAX_TIMER_LEAD)&&(PeekPacket (Worker, SessionNum)))
+        {
+            Worker->ArrivalValidMask|=(1u<<SessionNum);
+            SessionPool->RunSessions (1u<<SessionNum);
+            ClockModels[SessionNum].HandlerDone (jack_frame_time(client));
+            TimerLeads[SessionNum]++;
+            PacketCount++;
+        }
+        Worker->ArrivalValidMask&=~(1u<<SessionNum);
+        Worker->TimestampValidMask&=~(1u<<SessionNum);
+
+        // Sockets are level triggered : waiting packets would wake the loop again at once
+        if (TimerLeads[SessionNum]>=MAX_TIMER_LEAD)
+        {
+            Worker->Loop->PauseSession (SessionNum, true);
+            Worker->PausedMask|=(1u<<SessionNum);
+        }
+    }
+}  // ReceivePackets
+//-----------------------------------------------------------------------------
+
+// Advances the library timers of the sessions on timer tick. A session already run for its packets since
+// previous tick is not run again, so its timers keep the pace of the ticks
+void RunSessionTimers (TRTWorker* Worker, unsigned int NumTicks)
+{
+    unsigned int Mask;
+    unsigned int RunMask=0;
+    unsigned int SessionNum;
+
+    Mask=SessionPool->OpenedMask&Worker->SessionMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+
+        if (TimerLeads[SessionNum]>=NumTicks) TimerLeads[SessionNum]-=NumTicks;
+        else
+        {
+            TimerLeads[SessionNum]=0;
+            RunMask|=(1u<<SessionNum);
+        }
+    }
+    SessionPool->RunSessions (RunMask);
+
+    // Lead is now below the limit : paused sessions read their packets again
+    Mask=Worker->PausedMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        Worker->Loop->PauseSession (SessionNum, false);
+    }
+    Worker->PausedMask=0;
+}  // RunSessionTimers
+//-----------------------------------------------------------------------------
+
+// Called by the NetUMP endpoint for each UMP packet received
+void NetUMPCallback (void* Instance, const uint32_t* Words, const struct timespec* Arrival)
+{
+    (void)Instance;
+    if (UMP2JACK->Push (KernelTimeToFrames (Arrival), Words)) UMP2JACK->Commit();
+}  // NetUMPCallback
+//-----------------------------------------------------------------------------
+
+// Reads the NetUMP socket, runs its timers and sends the UMP packets read from JACK
+void ServiceNetUMP (bool SocketReady, unsigned int ElapsedMs)
+{
+    uint32_t Words[UMP_MAX_WORDS];
+
+    if (NetUMP==0) return;
+
+    if (SocketReady) NetUMP->ProcessIncoming (&NetUMPCallback, 0);
+    if (ElapsedMs>0) NetUMP->RunTimers (ElapsedMs, &NetUMPCallback, 0);
+
+    // Packets are dropped while no client is connected
+    while (JACK2UMP->Pop (0, Words)!=0) NetUMP->AppendUMP (Words);
+    NetUMP->Flush();
+    NetUMP->SendQueued();
+}  // ServiceNetUMP
+//-----------------------------------------------------------------------------
+
+// Takes the configuration published by main thread (worker thread). Each worker opens and closes its own sessions
+// Renamed sessions keep their peers : the new name is given in next invitations
+void TakeRTConfiguration (TRTWorker* Worker)
+{
+    uint32_t Generation;
+    uint32_t Mask;
+    unsigned int SessionNum;
+
+    Generation=ConfigGeneration.load (std::memory_order_acquire);
+    if (Generation==Worker->Generation.load (std::memory_order_relaxed)) return;
+
+    Worker->Routing=NextConfig.Routing;
+    Worker->Filters=NextConfig.Filters;
+    SessionPool->OpenedMask.fetch_and (~(NextConfig.CloseMask&Worker->SessionMask), std::memory_order_relaxed);
+    SessionPool->OpenedMask.fetch_or (NextConfig.OpenMask&Worker->SessionMask, std::memory_order_relaxed);
+
+    Mask=NextConfig.RenameMask&SessionPool->OpenedMask.load (std::memory_order_relaxed)&Worker->SessionMask;
+    while (Mask!=0)
+    {
+        SessionNum=__builtin_ctz (Mask);
+        Mask&=Mask-1;
+        SessionPool->Sessions[SessionNum].Handler->setSessionName (SessionPool->Sessions[SessionNum].Name);
+    }
+
+    Worker->Generation.store (Generation, std::memory_order_release);
+}  // TakeRTConfiguration
+//-----------------------------------------------------------------------------
+
+// High priority realtime thread for RTP-MIDI communication (one per worker)
+// The NetUMP endpoint is serviced by the first worker
+void* RTThreadFunc (CThread* Control)
+{
+    TRTWorker* Worker;
+    bool FirstWorker;
+    TRTLoopEvents Events;
+    unsigned int HealthTicks=0;
+    uint64_t Faults;
+    uint64_t LastFaults;
+
+    // Threads may start in any order : each one takes the next worker
+    Worker=&Workers[StartedWorkers.fetch_add (1)];
+    FirstWorker=(Worker==&Workers[0]);
+
+    if (Worker->PinThread)
+    {
+        if (PinCurrentThread (&Worker->CPUs)==false) fprintf (stderr, "jackrtpmidid : can not set CPU affinity of realtime thread\n");
+    }
+    PrefaultStack();
+    LastFaults=GetThreadPageFaults();
+    EnterRealtimeContext (RT_CONTEXT_SESSIONS);
+
+    while (Control->ShouldStop==false)
+    {
+        TakeRTConfiguration (Worker);
+
+        if (Worker->Loop==0)
+        {  // Event loop not available : fall back to polling
+            SessionPool->RunSessions (SessionPool->OpenedMask&Worker->SessionMask);
+            CommitToJACK (Worker);
+            TransmitToNetwork (Worker);
+            if (FirstWorker) ServiceNetUMP (true, 1);
+            SystemSleepMillis(1);
+            Events.NumTicks=1;
+        }
+        else
+        {
+            if (Worker->Loop->Wait(&Events)==false) continue;
+            if (Events.NumTicks>0) StatsLatency (Stats, Events.WakeLatencyMicros);
+        }
+
+        // Page faults of all workers are summed, allocations are counted for the whole process
+        HealthTicks+=Events.NumTicks;
+        if (HealthTicks>=HEALTH_CHECK_TICKS)
+        {
+            HealthTicks=0;
+            Faults=GetThreadPageFaults();
+            StatsAddShared (Stats->RTPageFaults, Faults-LastFaults);
+            LastFaults=Faults;
+            if (FirstWorker) Stats->RTAllocations.store (GetRealtimeAllocations(), std::memory_order_relaxed);
+        }
+        if (Worker->Loop==0) continue;
+
+        // Sessions with a packet waiting are run immediately
+        ReceivePackets (Worker, Events.ReadyMask);
+        if (Events.NumTicks>0) RunSessionTimers (Worker, Events.NumTicks);
+        FlushInboundFilters (Worker);
+        CommitToJACK (Worker);
+
+        // Queue is checked on every wake up, in case a signal from JACK has been merged with another event
+        // With a send deadline, nothing is sent before the deadline of the pending period
+        if ((Events.OutboundPending)||(Worker->Loop->DeadlinePending()==false)) TransmitToNetwork (Worker);
+        if (FirstWorker) ServiceNetUMP (Events.UMPReady, (Events.NumTicks*SESSION_TICK_MICROS)/1000);
+    }
+
+    Control->IsStopped=true;
+    pthread_exit(NULL);
+    return 0;
+}  // RTThreadFunc
+//-----------------------------------------------------------------------------
+
+// Function called when the RTP engine receives a valid MIDI message
+// Stores received MIDI message into the queue to JACK, with its JACK frame time
+// Instance is the slot of the session which has received the message
+void RTPMIDICallback (void* Instance, unsigned int DataSize, unsigned char* DataBlock, unsigned int DeltaTime)
+{
+    TSessionSlot* Session=(TSessionSlot*)Instance;
+    TRTWorker* Worker=WorkerOf (Session->Index);
+    unsigned long long DeltaFrames;
+    jack_nframes_t EventTime;
+    jack_nframes_t ArrivalTime;
+    uint32_t PlayoutTime;
+    uint32_t SenderTime;
+    int32_t Advance;
+    bool Queued;
+    CMIDIParser* Parser=&RXParsers[Session->Index];
+    uint64_t Discarded;
+    unsigned char* Message;
+    unsigned int MessageSize;
+
+    if (DataSize==0) return;
+
+    if (JitterBuffers[Session->Index].GetPlayoutTime (DeltaTime, &PlayoutTime))
+    {  // Event time = sender time of the packet + delta-time + transit time + jitter buffer delay
+        EventTime=(jack_nframes_t)PlayoutTime;
+    }
+    else
+    {  // Event time = arrival time + delta-time from RTP-MIDI payload (converted from RTP clock to JACK frames)
+        // Arrival time is the kernel receive time when the packet was peeked, otherwise the current time
+        DeltaFrames=((unsigned long long)DeltaTime*SampleRate)/RTP_TIMESTAMP_RATE;
+        if (DeltaFrames>SampleRate/MAX_DELTA_DIVIDER) DeltaFrames=SampleRate/MAX_DELTA_DIVIDER;
+        if (Worker->ArrivalValidMask&(1u<<Session->Index)) ArrivalTime=SessionArrival[Session->Index];
+        else ArrivalTime=jack_frame_time(client);
+        EventTime=ArrivalTime+(jack_nframes_t)DeltaFrames;
+
+        // Peer clock synchronized : event time = sender time mapped to JACK clock + one way transit,
+        // so a packet arriving early is not played early. Late packets are played at arrival
+        if ((Worker->TimestampValidMask&(1u<<Session->Index))&&
+            (ClockModels[Session->Index].MapTimestamp (SessionTimestamp[Session->Index]+DeltaTime, &SenderTime)))
+        {
+            Advance=(int32_t)(SenderTime+ClockModels[Session->Index].GetTransitFrames()-ArrivalTime);
+            if (Advance<0) Advance=0;
+            if (Advance>(int32_t)(SampleRate/MAX_DELTA_DIVIDER)) Advance=SampleRate/MAX_DELTA_DIVIDER;
+            EventTime=ArrivalTime+(jack_nframes_t)Advance;
+        }
+    }
+
+    // The block is split in complete messages by the parser of the session, so an incomplete message, running status
+    // or data bytes from one peer never reach JACK merged with the messages of another session
+    Discarded=Parser->DiscardedBytes;
+    Parser->Begin (DataBlock, DataSize);
+    while (Parser->Next (&Message, &MessageSize))
+    {
+        if (Worker->Filters->InMask&(1u<<Session->Index))
+        {
+            // Held messages whose interval ends before this event are queued first, so the queue stays in time order
+            Worker->Filters->In[Session->Index].FlushDue (EventTime, &FilteredToJACK, Session);
+            if (Worker->Filters->In[Session->Index].Check (Message, MessageSize, EventTime)==false)
+            {
+                StatsAdd (Stats->Sessions[Session->Index].FromNetwork.Filtered, 1);
+                continue;
+            }
+        }
+
+        // Message is dropped if the queue or the SYSEX pool is full
+        // Records are committed once per wake up by CommitToJACK
+        Queued=QueueMIDIMessage (ToJACKQueues[Session->Index], Worker->ToJACKPool, EventTime, (uint8_t)Session->Index, Message, MessageSize, 0);
+        if (Queued) RXJournals[Session->Index].TrackCommand (Message, MessageSize);
+        StatsCountMessage (&Stats->Sessions[Session->Index].FromNetwork, Message, MessageSize, Queued);
+    }
+    if (Parser->DiscardedBytes!=Discarded)
+        StatsAdd (Stats->Sessions[Session->Index].ParserDiscards, Parser->DiscardedBytes-Discarded);
+}  // RTPMIDICallback
+//-----------------------------------------------------------------------------
+
+// Reads events from a JACK input port and queues them for the RTP-MIDI sessions
+// Events are queued only for the workers servicing a session routed from the port
+// Port is the number of the input port in the routing matrix
+// Returns the workers which have received events (bit n = worker n)
+uint32_t QueueJACKEvents (void* in_port_buf, jack_nframes_t PeriodStart, uint8_t Port)
+{
+    unsigned int i;
+    jack_midi_event_t in_event;
+    jack_nframes_t event_count = jack_midi_get_event_count(in_port_buf);
+    uint32_t PortSessions;
+    uint32_t WorkerMask=0;
+    uint32_t QueuedMask=0;
+    uint32_t Mask;
+    unsigned int WorkerNum;
+    bool Queued;
+    bool Merge;
+    int Key;
+    uint8_t Flags;
+
+    if (event_count==0) return 0;
+
+    PortSessions=JACKRouting->GetPortSessions (Port);
+    for (WorkerNum=0; WorkerNum<NumWorkers; WorkerNum++)
+    {
+        if (PortSessions&Workers[WorkerNum].SessionMask) WorkerMask|=(1u<<WorkerNum);
+    }
+
+    // Some sessions only want the last update of each controller in a period : find them first
+    Merge=(JACKFilters->MergeMask!=0);
+    if (Merge)
+    {
+        JACKFilters->Merger.Begin();
+        for(i=0; i<event_count; i++)
+        {
+            jack_midi_event_get(&in_event, in_port_buf, i);
+            if (in_event.size==0) continue;
+            Key=FilterKey (in_event.buffer, in_event.size);
+            if (Key>=0) JACKFilters->Merger.Record (Key, i);
+        }
+    }
+
+    for(i=0; i<event_count; i++)
+    {
+        jack_midi_event_get(&in_event, in_port_buf, i);
+        if (in_event.size==0) continue;
+
+        Flags=0;
+        if (Merge)
+        {
+            Key=FilterKey (in_event.buffer, in_event.size);
+            if ((Key>=0)&&(JACKFilters->Merger.IsSuperseded (Key, i))) Flags=EVENT_FLAG_SUPERSEDED;
+        }
+
+        // Event is discarded by a worker if its queue or SYSEX pool is full
+        Queued=true;
+        Mask=WorkerMask;
+        while (Mask!=0)
+        {
+            WorkerNum=__builtin_ctz (Mask);
+            Mask&=Mask-1;
+            if (QueueMIDIMessage (Workers[WorkerNum].FromJACK, Workers[WorkerNum].FromJACKPool, PeriodStart+in_event.time, Port, in_event.buffer, in_event.size, Flags))
+                QueuedMask|=(1u<<WorkerNum);
+            else Queued=false;
+        }
+        StatsCountMessage (&Stats->FromJACK, in_event.buffer, in_event.size, Queued);
+        if (Capture) Capture->Record (NumWorkers, CAPTURE_JACK_IN, Port, PeriodStart+in_event.time, 0, in_event.buffer, in_event.size);
+    }
+    return QueuedMask;
+}  // QueueJACKEvents
+// ----------------------------------------------------
+
+// Sends UMP packets received from NetUMP to JACK and queues the packets read from JACK for NetUMP
+// UMP is translated from and to MIDI 1.0 if JACK ports are MIDI 1.0 ports
+// Returns the number of packets queued for NetUMP
+unsigned int TransferUMP (jack_nframes_t nframes, jack_nframes_t PeriodStart, jack_nframes_t Latency)
+{
+    void* InBuffer=jack_port_get_buffer (UMPInputPort, nframes);
+    void* OutBuffer=jack_port_get_buffer (UMPOutputPort, nframes);
+    jack_midi_event_t InEvent;
+    jack_nframes_t EventCount;
+    jack_nframes_t EventNum;
+    uint32_t Time;
+    uint32_t Words[UMP_MAX_WORDS];
+    TMIDI1Message Messages[UMP_MAX_MIDI1_MESSAGES];
+    unsigned int NumMessages;
+    unsigned int MessageNum;
+    unsigned int NumWords;
+    unsigned int WordNum;
+    unsigned int PacketWords;
+    unsigned int Position;
+    size_t MinSpace;
+    int FrameOffset;
+    int LastOffset=0;
+    unsigned int NumQueued=0;
+
+    jack_midi_clear_buffer (OutBuffer);
+
+    // A translated packet can become a SYSEX part or several short messages
+    MinSpace=JACKUMPPorts ? 4*UMP_MAX_WORDS : UMP_SYSEX_PART_SIZE+16;
+    while (UMP2JACK->PeekTime (&Time))
+    {
+        FrameOffset=(int)(Time+Latency-PeriodStart);
+        if (FrameOffset>=(int)nframes) break;           // Packet (and all next ones) to be played in a next period
+        if (FrameOffset<LastOffset) FrameOffset=LastOffset;
+        if (jack_midi_max_event_size (OutBuffer)<MinSpace) break;       // Packet stays in the queue for next period
+
+        UMP2JACK->Pop (0, Words);
+        if (JACKUMPPorts)
+        {
+            jack_midi_event_write (OutBuffer, FrameOffset, (jack_midi_data_t*)Words, 4*UMPWordCount (Words[0]));
+        }
+        else
+        {
+            NumMessages=UMPToJACK.Translate (Words, Messages);
+            for (MessageNum=0; MessageNum<NumMessages; MessageNum++)
+                jack_midi_event_write (OutBuffer, FrameOffset, Messages[MessageNum].Data, Messages[MessageNum].Size);
+        }
+        LastOffset=FrameOffset;
+    }
+
+    EventCount=jack_midi_get_event_count (InBuffer);
+    for (EventNum=0; EventNum<EventCount; EventNum++)
+    {
+        jack_midi_event_get (&InEvent, InBuffer, EventNum);
+        if (JACKUMPPorts)
+        {  // Event holds one or more UMP packets in host order
+            NumWords=InEvent.size/4;
+            WordNum=0;
+            while (WordNum<NumWords)
+            {
+                memcpy (&Words[0], InEvent.buffer+4*WordNum, 4);
+                PacketWords=UMPWordCount (Words[0]);
+                if (WordNum+PacketWords>NumWords) break;
+                memcpy (&Words[0], InEvent.buffer+4*WordNum, 4*PacketWords);
+                if (JACK2UMP->Push (PeriodStart+InEvent.time, Words)) NumQueued++;
+                WordNum+=PacketWords;
+            }
+        }
+        else
+        {
+            Position=0;
+            while (MIDI1ToUMP (InEvent.buffer, InEvent.size, &Position, Words)!=0)
+            {
+                if (JACK2UMP->Push (PeriodStart+InEvent.time, Words)) NumQueued++;
+            }
+        }
+    }
+
+    if (NumQueued>0) JACK2UMP->Commit();
+    return NumQueued;
+}  // TransferUMP
+// ----------------------------------------------------
+
+// Start of the current JACK period in CLOCK_MONOTONIC time (JACK clock may be another clock). Returns 0 if not available
+// Called from jack_process only
+uint64_t GetCycleStartNanos (void)
+{
+    jack_nframes_t CycleFrames;
+    jack_time_t CycleUsecs;
+    jack_time_t NextUsecs;
+    jack_time_t JACKNow;
+    float PeriodUsecs;
+    struct timespec Now;
+
+    if (jack_get_cycle_times (client, &CycleFrames, &CycleUsecs, &NextUsecs, &PeriodUsecs)!=0) return 0;
+    clock_gettime (CLOCK_MONOTONIC, &Now);
+    JACKNow=jack_get_time();
+    if (JACKNow<CycleUsecs) JACKNow=CycleUsecs;
+
+    Stats->JACKPeriodMicros.store ((uint32_t)(NextUsecs-CycleUsecs), std::memory_order_relaxed);
+    return ((uint64_t)Now.tv_sec*1000000000ull)+(uint64_t)Now.tv_nsec-(JACKNow-CycleUsecs)*1000;
+}  // GetCycleStartNanos
+// ----------------------------------------------------
+
+// Callback function called when there is an audio block to process
+int jack_process(jack_nframes_t nframes, void *arg)
+{
+    void* in_port_buf = jack_port_get_buffer(input_port, nframes);
+    void* out_port_buf = jack_port_get_buffer(output_port, nframes);
+    void* PortOutBuffers[MAX_ROUTE_PORTS];  // 0 = common port, n = port of session n
+    uint64_t AvailablePorts;
+    uint64_t TargetPorts;
+    uint64_t PortMask;
+    unsigned int PortNum;
+    jack_midi_data_t* Buffer;
+    TMIDIEventHeader* Event;
+    TMIDIEventHeader* Head;
+    CMIDIEventQueue* Queue;
+    uint32_t WaitingMask;               // Sessions with events waiting for JACK
+    uint32_t Mask;
+    TSysExChunkRef* ChunkRef=0;
+    unsigned char* Data;
+    size_t Size;
+    size_t MaxSize;
+    jack_nframes_t PeriodStart;
+    jack_nframes_t Latency;
+    int FrameOffset;
+    int LastOffset=0;
+    uint32_t QueuedMask;
+    unsigned int SessionNum;
+    unsigned int WorkerNum;
+    TRTWorker* Worker;
+    uint32_t Generation;
+    uint64_t CycleStart=0;
+    uint64_t NotSent;
+
+    // Configuration published by main thread on reload
+    Generation=ConfigGeneration.load (std::memory_order_acquire);
+    if (Generation!=JACKGeneration.load (std::memory_order_relaxed))
+    {
+        JACKRouting=NextConfig.Routing;
+        JACKFilters=NextConfig.Filters;
+        JACKNumSessions=NextConfig.NumSessions;
+        JACKGeneration.store (Generation, std::memory_order_release);
+    }
+
+    jack_midi_clear_buffer(out_port_buf);    // Recommended to call this at the beginning of process cycle
+    PortOutBuffers[0]=out_port_buf;
+    AvailablePorts=1;
+    if (MultiPort)
+    {
+        for (SessionNum=0; SessionNum<JACKNumSessions; SessionNum++)
+        {
+            if (SessionOutputPorts[SessionNum]==0) continue;
+            PortOutBuffers[SessionNum+1]=jack_port_get_buffer(SessionOutputPorts[SessionNum], nframes);
+            jack_midi_clear_buffer(PortOutBuffers[SessionNum+1]);
+            AvailablePorts|=(1ull<<(SessionNum+1));
+        }
+    }
+
+    PeriodStart=jack_last_frame_time(client);
+    if (LatencyFrames!=0) Latency=LatencyFrames;
+    else Latency=nframes;
+
+    // Generate JACK events for the MIDI messages received from RTP-MIDI and due in this period
+    // Workers only queue complete MIDI messages, so there is no need to parse them here
+    // Queues of the sessions are merged in time order, so an event delayed by the jitter buffer or the clock of one
+    // peer never holds the events of the other sessions. A SYSEX split in chunks is sent completely before any other event
+    WaitingMask=0;
+    for (SessionNum=0; SessionNum<MAX_SESSIONS; SessionNum++)
+    {
+        if (ToJACKQueues[SessionNum]->Peek()!=0) WaitingMask|=(1u<<SessionNum);
+    }
+    while (true)
+    {
+        Queue=0;
+        Event=0;
+        if (JACKSysExSession!=-1)
+        {  // All chunks of a SYSEX are committed at once : no chunk waiting means the SYSEX is complete
+            Head=ToJACKQueues[JACKSysExSession]->Peek();
+            if ((Head!=0)&&(Head->Flags&EVENT_FLAG_CHUNK))
+            {
+                Queue=ToJACKQueues[JACKSysExSession];
+                Event=Head;
+            }
+            else JACKSysExSession=-1;
+        }
+        if (Event==0)
+        {
+            Mask=WaitingMask;
+            while (Mask!=0)
+            {
+                SessionNum=__builtin_ctz (Mask);
+                Mask&=Mask-1;
+                Head=ToJACKQueues[SessionNum]->Peek();
+                if (Head==0)
+                {
+                    WaitingMask&=~(1u<<SessionNum);
+                    continue;
+                }
+                if ((Event==0)||((int32_t)(Head->Time-Event->Time)<0))
+                {
+                    Queue=ToJACKQueues[SessionNum];
+                    Event=Head;
+                }
+            }
+        }
+        if (Event==0) break;
+        Worker=WorkerOf (Event->Source);
+
+        // Position in current period once the fixed latency is applied
+        FrameOffset=(int)(Event->Time+Latency-PeriodStart);
+        if (FrameOffset>=(int)nframes) break;           // Earliest head of all sessions is to be played in a next period
+        if (FrameOffset<LastOffset) FrameOffset=LastOffset;     // Late event or JACK requires events in time order
+
+        if (Event->Flags&EVENT_FLAG_CHUNK)
+        {  // Part of a big SYSEX : sent in one or more JACK events, limited by the space left in JACK buffers
+            ChunkRef=(TSysExChunkRef*)CMIDIEventQueue::EventData(Event);
+            Data=Worker->ToJACKPool->ChunkData(ChunkRef->Chunk)+JACKChunkPos;
+            Size=ChunkRef->Length-JACKChunkPos;
+        }
+        else
+        {
+            Data=CMIDIEventQueue::EventData(Event);
+            Size=Event->Size;
+        }
+
+        // Output ports selected by routing matrix for the session (event is dropped if filtered)
+        TargetPorts=0;
+        if (Event->Source<JACKNumSessions)
+        {
+            if (JACKRouting->ChannelAllowed (Event->Source, Data[0]))
+                TargetPorts=JACKRouting->GetSessionPorts (Event->Source)&AvailablePorts;
+        }
+
+        // Check space in all ports first, so an event is never written twice in the same port
+        PortMask=TargetPorts;
+        while (PortMask!=0)
+        {
+            PortNum=__builtin_ctzll (PortMask);
+            PortMask&=PortMask-1;
+            MaxSize=jack_midi_max_event_size(PortOutBuffers[PortNum]);
+            if (Size>MaxSize)
+            {
+                if (Event->Flags&EVENT_FLAG_CHUNK) Size=MaxSize;
+                else Size=0;
+            }
+        }
+        if (Size==0) break;                             // JACK buffer is full : keep the message for next period
+
+        PortMask=TargetPorts;
+        while (PortMask!=0)
+        {
+            PortNum=__builtin_ctzll (PortMask);
+            PortMask&=PortMask-1;
+            Buffer=jack_midi_event_reserve (PortOutBuffers[PortNum], FrameOffset, Size);
+            if (Buffer!=0) memcpy (Buffer, Data, Size);
+        }
+        if (TargetPorts!=0)
+        {
+            LastOffset=FrameOffset;
+            if (Capture) Capture->Record (NumWorkers, CAPTURE_JACK_OUT, Event->Source, PeriodStart+FrameOffset, 0, Data, Size);
+        }
+
+        if (Event->Flags&EVENT_FLAG_CHUNK)
+        {
+            JACKChunkPos+=Size;
+            if (JACKChunkPos<ChunkRef->Length)
+            {  // Rest of the chunk in the next JACK event
+                JACKSysExSession=Event->Source;
+                continue;
+            }
+            JACKChunkPos=0;
+            // Next chunks of the SYSEX are in the same queue
+            JACKSysExSession=(Data[Size-1]==0xF7) ? -1 : (int)Event->Source;
+            Worker->ToJACKPool->Free (ChunkRef->Chunk);
+        }
+        Queue->Pop();
+    }
+
+    // Queue each event sent by JACK for the RTP-MIDI sessions
+    QueuedMask=QueueJACKEvents (in_port_buf, PeriodStart, 0);
+    if (MultiPort)
+    {
+        for (SessionNum=0; SessionNum<JACKNumSessions; SessionNum++)
+        {
+            if (SessionInputPorts[SessionNum]==0) continue;
+            QueuedMask|=QueueJACKEvents (jack_port_get_buffer(SessionInputPorts[SessionNum], nframes), PeriodStart, (uint8_t)(SessionNum+1));
+        }
+    }
+
+    // NetUMP is serviced by the first worker
+    if (NetUMP)
+    {
+        if (TransferUMP (nframes, PeriodStart, Latency)>0) QueuedMask|=1;
+    }
 
-#include <jack/jack.h>
-#include <jack/midiport.h>
-#include "RTP_MIDI.h"
-#include "SystemSleep.h"
-#include "CThread.h"
+    if (QueuedMask!=0) CycleStart=GetCycleStartNanos();
+    while (QueuedMask!=0)
+    {
+        WorkerNum=__builtin_ctz (QueuedMask);
+        QueuedMask&=QueuedMask-1;
+        Worker=&Workers[WorkerNum];
 
-jack_port_t *input_port;
-jack_port_t *output_port;
-bool break_request=false;
-CThread* RTThread=0;
+        // Make all events of the period visible at once to the worker
+        Worker->FromJACK->Commit();
+        StatsMax (Stats->MaxFillToNetwork, Worker->FromJACK->GetFill());
 
-CRTP_MIDI* RTPMIDIHandler1=0;
-CRTP_MIDI* RTPMIDIHandler2=0;
-TMIDI_FIFO_CHAR MIDI2JACK;
-TMIDI_FIFO_CHAR JACK2RTP;
+        // Latency is measured from the oldest period not yet sent
+        NotSent=0;
+        if (CycleStart!=0) Worker->TXCycleNanos.compare_exchange_strong (NotSent, CycleStart, std::memory_order_relaxed);
 
-// High priority realtime thread for RTP-MIDI communication
-void* RTThreadFunc (CThread* Control)
+        // Wake up the worker so data is sent without waiting next timer tick, or at the deadline after period start
+        if (Worker->Loop)
+        {
+            if ((TXDeadlineMicros>=0)&&(CycleStart!=0)) Worker->Loop->SignalOutboundAt (CycleStart+(uint64_t)TXDeadlineMicros*1000);
+            else Worker->Loop->SignalOutbound();
+        }
+    }
+
+    return 0;
+}  // jack_process
+// ----------------------------------------------------
+
+/* Callback function called by JACK in its process thread before the first cycle */
+void jack_thread_init (void *arg)
 {
-    while (Control->ShouldStop==false)
+    (void)arg;
+    if (PinJACKThread)
     {
-        if (RTPMIDIHandler1)
-            RTPMIDIHandler1->RunSession();
-        if (RTPMIDIHandler2)
-            RTPMIDIHandler2->RunSession();
-        SystemSleepMillis(1);
+        if (PinCurrentThread (&JACKThreadCPUs)==false) fprintf (stderr, "jackrtpmidid : can not set CPU affinity of JACK thread\n");
     }
-    Control->IsStopped=true;
-    pthread_exit(NULL);
+    PrefaultStack();
+    EnterRealtimeContext (RT_CONTEXT_JACK);
+}  // jack_thread_init
+// ----------------------------------------------------
+
+/* Callback function called by JACK when an xrun occurs */
+int jack_xrun (void *arg)
+{
+    (void)arg;
+    StatsAdd (Stats->Xruns, 1);
     return 0;
-}  // RTThreadFunc
-//-----------------------------------------------------------------------------
+}  // jack_xrun
+// ----------------------------------------------------
 
-// Function called when the RTP engine receives a valid MIDI message
-// Stores received MIDI bytes into FIFO to JACK (generates a MIDI stream)
-void RTPMIDICallback (void* Instance, unsigned int DataSize, unsigned char* DataBlock, unsigned int DeltaTime)
+/* Callback function called when jack server is shut down */
+void jack_shutdown(void *arg)
+{
+    printf ("JACK has shut down\n");
+    break_request=true;
+}  // jack_shutdown
+// ----------------------------------------------------
+
+void sig_handler (int signo)
 {
-    unsigned int CurrentOutPtr;
-    unsigned int TempInPtr;
-    unsigned int ByteCount;
-    bool Overflow=false;
+    if (signo == SIGINT)
+    {
+        break_request=true;
+    }
+    else if (signo == SIGHUP)
+    {
+        reload_request=true;
+    }
+}  // sig_handler
+// ----------------------------------------------------
 
-    CurrentOutPtr=MIDI2JACK.ReadPtr;		// Make a snapshot to avoid change during next loop
-    TempInPtr=MIDI2JACK.WritePtr;			// Local copy to be updated only when full MIDI message is transferred
+// Declares the sessions from the configuration file, or the default sessions
+// Returns 0 if the configuration is invalid
+CSessionManager* CreateSessionPool (void)
+{
+    CSessionManager* Pool;
 
-    for (ByteCount=0; ByteCount<DataSize; ByteCount++)
+    Pool = new CSessionManager ();
+    Pool->SetJitterLimits (JitterEnabled, JitterMinMs, JitterMaxMs);
+    if (ConfigFileName)
+    {
+        if (Pool->LoadConfigFile (ConfigFileName)==false)
+        {
+            delete Pool;
+            return 0;
+        }
+    }
+    else
     {
-        MIDI2JACK.FIFO[TempInPtr]=DataBlock[ByteCount];
-        TempInPtr+=1;
-        if (TempInPtr>=MIDI_CHAR_FIFO_SIZE) TempInPtr=0;
-        if (TempInPtr==CurrentOutPtr)
+        if (Pool->AddDefaultSessions (NumDefaultSessions, BasePort)==false)
         {
-                Overflow=true;
-                break;
+            fprintf (stderr, "jackrtpmidid : too many sessions (max %u)\n", MAX_SESSIONS);
+            delete Pool;
+            return 0;
         }
     }
+    return Pool;
+}  // CreateSessionPool
+// ----------------------------------------------------
+
+// Creates the routing matrix and the filters for NumSessions sessions from their files, or the default ones
+// Returns false if a file is invalid
+bool CreateRoutes (unsigned int NumSessions, CRoutingMatrix** NewRouting, CFilterSet** NewFilters)
+{
+    *NewRouting = new CRoutingMatrix ();
+    *NewFilters = new CFilterSet ();
 
-    if (Overflow==false)
-    {  // Update input pointer only if we have been able to store all data
-        MIDI2JACK.WritePtr=TempInPtr;
+    if (RoutingFileName)
+    {
+        if ((*NewRouting)->LoadRoutingFile (RoutingFileName, NumSessions, MultiPort)==false) return false;
+    }
+    else
+    {
+        (*NewRouting)->SetDefaultRoutes (NumSessions, MultiPort);
     }
-}  // RTPMIDICallback
-//-----------------------------------------------------------------------------
 
-// Callback function called when there is an audio block to process
-int jack_process(jack_nframes_t nframes, void *arg)
+    if (FilterFileName)
+    {
+        if ((*NewFilters)->LoadFilterFile (FilterFileName, NumSessions)==false) return false;
+    }
+    return true;
+}  // CreateRoutes
+// ----------------------------------------------------
+
+// Registers the JACK ports of a session (-multiport). Returns false if a port can not be registered
+bool RegisterSessionPorts (unsigned int SessionNum)
 {
-    unsigned int i;
-    void* in_port_buf = jack_port_get_buffer(input_port, nframes);
-    void* out_port_buf = jack_port_get_buffer(output_port, nframes);
-    jack_midi_event_t in_event;
-    jack_nframes_t event_count = jack_midi_get_event_count(in_port_buf);
-    jack_midi_data_t* Buffer;
-    unsigned int TempRead, LastBufferPos, TempWrite;
-    unsigned char RunningStatus;
-    unsigned int NumBytesToRead;
-    unsigned char SYSEXBuffer[512];
-    unsigned int SYSEXSize;
-    unsigned char SYSEXByte;
-    size_t NumBytesInEvent;
-    unsigned int ByteCounter;
+    char PortName[32];
 
-    jack_midi_clear_buffer(out_port_buf);    // Recommended to call this at the beginning of process cycle
+    // Only missing ports are registered, so a registration which failed on reload can be tried again
+    if (SessionInputPorts[SessionNum]==0)
+    {
+        snprintf (PortName, sizeof(PortName), "rtpmidi_in_%u", SessionNum+1);
+        SessionInputPorts[SessionNum] = jack_port_register (client, PortName, JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    }
+    if (SessionOutputPorts[SessionNum]==0)
+    {
+        snprintf (PortName, sizeof(PortName), "rtpmidi_out_%u", SessionNum+1);
+        SessionOutputPorts[SessionNum] = jack_port_register (client, PortName, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    }
+    if ((SessionInputPorts[SessionNum]==0)||(SessionOutputPorts[SessionNum]==0))
+    {
+        fprintf (stderr, "jackrtpmidid : can not register JACK ports for session %u\n", SessionNum+1);
+        return false;
+    }
+    return true;
+}  // RegisterSessionPorts
+// ----------------------------------------------------
+
+// Removes the JACK ports of a session. jack_process must not use them anymore
+void UnregisterSessionPorts (unsigned int SessionNum)
+{
+    if (SessionInputPorts[SessionNum]) jack_port_unregister (client, SessionInputPorts[SessionNum]);
+    if (SessionOutputPorts[SessionNum]) jack_port_unregister (client, SessionOutputPorts[SessionNum]);
+    SessionInputPorts[SessionNum]=0;
+    SessionOutputPorts[SessionNum]=0;
+}  // UnregisterSessionPorts
+// ----------------------------------------------------
+
+// Publishes a configuration for the realtime threads and waits until all have taken it
+// Returns false if one of them has not taken it within one second
+bool PublishConfiguration (CRoutingMatrix* NewRouting, CFilterSet* NewFilters, unsigned int NumSessions, uint32_t CloseMask, uint32_t OpenMask, uint32_t RenameMask)
+{
+    uint32_t Generation;
+    unsigned int Waited;
+    unsigned int WorkerNum;
+    bool Taken;
+
+    NextConfig.Routing=NewRouting;
+    NextConfig.Filters=NewFilters;
+    NextConfig.NumSessions=NumSessions;
+    NextConfig.CloseMask=CloseMask;
+    NextConfig.OpenMask=OpenMask;
+    NextConfig.RenameMask=RenameMask;
+
+    Generation=ConfigGeneration.load (std::memory_order_relaxed)+1;
+    ConfigGeneration.store (Generation, std::memory_order_release);
+
+    for (Waited=0; Waited<1000; Waited++)
+    {
+        Taken=(JACKGeneration.load (std::memory_order_acquire)==Generation);
+        for (WorkerNum=0; WorkerNum<NumWorkers; WorkerNum++)
+        {
+            if (Workers[WorkerNum].Generation.load (std::memory_order_acquire)!=Generation) Taken=false;
+        }
+        if (Taken) return true;
+        SystemSleepMillis(1);
+    }
+    return false;
+}  // PublishConfiguration
+// ----------------------------------------------------
+
+// Prepares the state kept by the realtime thread for a session opened on reload (session not serviced yet)
+void ResetSessionState (unsigned int SessionNum)
+{
+    TSessionSlot* Slot=&SessionPool->Sessions[SessionNum];
+
+    TXPackets[SessionNum].Clear();
+    TXGuards[SessionNum].Reset();
+    RXJournals[SessionNum].Reset();
+    RXParsers[SessionNum].Reset();
+    TimerLeads[SessionNum]=0;
+    JitterBuffers[SessionNum]=CJitterBuffer();
+    if (Slot->JitterEnabled) JitterBuffers[SessionNum].Configure (SampleRate, Slot->JitterMinMs, Slot->JitterMaxMs);
+    ClockModels[SessionNum].Configure (SampleRate);
+    Statistics->ResetSession (SessionNum);
+}  // ResetSessionState
+// ----------------------------------------------------
+
+// Reads the session, routing and filter files again (SIGHUP) without closing the JACK client
+// Session n of the new configuration replaces session n of the running one. It is kept with its peers and
+// JACK connections when its ports and jitter settings are the same (a new name is given in next invitations),
+// otherwise it is closed and opened again. The running configuration is kept if a file is invalid
+void ReloadConfiguration (void)
+{
+    CSessionManager* NewPool;
+    CRoutingMatrix* NewRouting;
+    CFilterSet* NewFilters;
+    CRoutingMatrix* OldRouting;
+    CFilterSet* OldFilters;
+    TSessionSlot* Slot;
+    TSessionSlot* NewSlot;
+    unsigned int OldNum;
+    unsigned int NewNum;
+    unsigned int KeptNum;
+    unsigned int SessionNum;
+    uint32_t CloseMask=0;
+    uint32_t OpenMask=0;
+    uint32_t RenameMask=0;
+    uint32_t OpenedMask=0;
+
+    // Sessions and ports are stored in the header of the capture file : they can not change during a capture
+    if (Capture)
+    {
+        fprintf (stderr, "jackrtpmidid : configuration can not be reloaded during a capture (-capture)\n");
+        return;
+    }
 
-    // Check if we have MIDI data waiting in the FIFO from RTP-MIDI to be sent
-    if (MIDI2JACK.ReadPtr!=MIDI2JACK.WritePtr)
+    printf ("Reloading configuration...\n");
+    NewPool=CreateSessionPool();
+    if (NewPool==0)
     {
-        // Read FIFO and generate JACK events for each MIDI message in the FIFO
-        TempRead=MIDI2JACK.ReadPtr;     // Local snapshot to avoid RTP-MIDI thread to see pointer moving while we parse the buffer
-        LastBufferPos=MIDI2JACK.WritePtr;
+        fprintf (stderr, "jackrtpmidid : configuration not reloaded\n");
+        return;
+    }
+    if (CreateRoutes (NewPool->NumSessions, &NewRouting, &NewFilters)==false)
+    {
+        fprintf (stderr, "jackrtpmidid : configuration not reloaded\n");
+        delete NewRouting;
+        delete NewFilters;
+        delete NewPool;
+        return;
+    }
+    NewFilters->SetSampleRate (SampleRate);
+
+    OldNum=SessionPool->NumSessions;
+    NewNum=NewPool->NumSessions;
+    KeptNum=(NewNum<OldNum) ? NewNum : OldNum;
 
-        while (TempRead!=LastBufferPos)
+    for (SessionNum=0; SessionNum<MAX_SESSIONS; SessionNum++)
+    {
+        Slot=&SessionPool->Sessions[SessionNum];
+        NewSlot=&NewPool->Sessions[SessionNum];
+        if ((SessionNum<KeptNum)&&(Slot->Handler!=0)&&
+            (Slot->ControlPort==NewSlot->ControlPort)&&(Slot->JitterEnabled==NewSlot->JitterEnabled)&&
+            (Slot->JitterMinMs==NewSlot->JitterMinMs)&&(Slot->JitterMaxMs==NewSlot->JitterMaxMs))
         {
-            // We can assume safely that there will be no incomplete MIDI message in the queue
-            // as RTP-MIDI thread only transfers full MIDI messages. No need to check here
-            // if a message in the queue is truncated
+            if (strcmp (Slot->Name, NewSlot->Name)!=0) RenameMask|=(1u<<SessionNum);
+            continue;
+        }
+        if (Slot->Handler!=0) CloseMask|=(1u<<SessionNum);
+        if (SessionNum<NewNum) OpenMask|=(1u<<SessionNum);
+    }
+
+    // Sessions to close and JACK ports to remove are released by the realtime threads first
+    if (PublishConfiguration (NextConfig.Routing, NextConfig.Filters, KeptNum, CloseMask, 0, 0)==false)
+    {
+        fprintf (stderr, "jackrtpmidid : realtime threads not responding, configuration not reloaded\n");
+        PublishConfiguration (NextConfig.Routing, NextConfig.Filters, OldNum, 0, CloseMask, 0);
+        delete NewRouting;
+        delete NewFilters;
+        delete NewPool;
+        return;
+    }
 
-            // Identify message length from first byte
-            RunningStatus=MIDI2JACK.FIFO[TempRead];
+    while (CloseMask!=0)
+    {
+        SessionNum=__builtin_ctz (CloseMask);
+        CloseMask&=CloseMask-1;
+        SessionPool->CloseSession (SessionNum, WorkerOf (SessionNum)->Loop);
+    }
+    if (MultiPort)
+    {
+        for (SessionNum=NewNum; SessionNum<OldNum; SessionNum++) UnregisterSessionPorts (SessionNum);
+    }
 
-            if (RunningStatus==0xF0)
-            {  // Specific SYSEX processing
-                SYSEXBuffer[0]=0xF0;
-                SYSEXSize=0;
+    // Slots of renamed and new sessions take their new definition
+    SessionPool->NumSessions=NewNum;
+    for (SessionNum=0; SessionNum<NewNum; SessionNum++)
+    {
+        Slot=&SessionPool->Sessions[SessionNum];
+        NewSlot=&NewPool->Sessions[SessionNum];
+        if (RenameMask&(1u<<SessionNum)) memcpy (&Slot->Name[0], &NewSlot->Name[0], SESSION_NAME_LENGTH);
+        if ((OpenMask&(1u<<SessionNum))==0) continue;
 
-                // Read SYSEX size by searching 0xF7
-                do {
-                    SYSEXByte=MIDI2JACK.FIFO[TempRead];
-                    TempRead+=1;
-                    if (TempRead>=MIDI_CHAR_FIFO_SIZE) TempRead=0;  // Could be a mask for faster update
+        memcpy (Slot, NewSlot, sizeof(TSessionSlot));
+        Slot->Handler=0;
+        ResetSessionState (SessionNum);
 
-                    SYSEXBuffer[SYSEXSize]=SYSEXByte;
-                    SYSEXSize++;
-                } while ((SYSEXSize<512)&&(SYSEXByte!=0xF7));
+        // A session without its JACK ports is not opened (ports are tried again on next reload)
+        if ((MultiPort)&&(RegisterSessionPorts (SessionNum)==false)) continue;
+        if (SessionPool->OpenSession (SessionNum, &RTPMIDICallback, WorkerOf (SessionNum)->Loop)) OpenedMask|=(1u<<SessionNum);
+    }
 
-                // If SYSEX is too big or 0xF7 not found, reject the message
-                if (SYSEXByte==0xF7)
-                {
-                    // Allocate JACK buffer
-                    Buffer=jack_midi_event_reserve (out_port_buf, 0, SYSEXSize);
-                    if (Buffer!=0)
-                    {  // Copy SYSEX message in the buffer
-                        memcpy (Buffer, &SYSEXBuffer[0], SYSEXSize);
-                    }
-                }
-            }
-            else
-            {  // Non SYSEX
-                if ((RunningStatus>=0x80) && (RunningStatus<=0xBF)) NumBytesToRead=3;
-                else if ((RunningStatus>=0xC0) && (RunningStatus<=0xDF)) NumBytesToRead=2;
-                else if ((RunningStatus>=0xE0) && (RunningStatus<=0xEF)) NumBytesToRead=3;
-                else if ((RunningStatus==0xF1)||(RunningStatus==0xF3)) NumBytesToRead=2;
-                else if (RunningStatus==0xF2) NumBytesToRead=3;
-                else NumBytesToRead=1;
-
-                // Generate the message in JACK buffer
-                Buffer=jack_midi_event_reserve (out_port_buf, 0, NumBytesToRead);
-                if (Buffer!=0)
-                {
-                    Buffer[0]=RunningStatus;
-                    TempRead+=1;
-                    if (TempRead>=MIDI_CHAR_FIFO_SIZE) TempRead=0;  // Could be a mask for faster update
-
-                    if (NumBytesToRead>1)       // Read first byte as we are alreay pointing it
-                    {
-                        Buffer[1]=MIDI2JACK.FIFO[TempRead];
-                        TempRead+=1;
-                        if (TempRead>=MIDI_CHAR_FIFO_SIZE) TempRead=0;  // Could be a mask for faster update
-                    }
-
-                    if (NumBytesToRead==3)      // Read second byte (avoid loop for standard MIDI messages)
-                    {
-                        Buffer[2]=MIDI2JACK.FIFO[TempRead];
-                        TempRead+=1;
-                        if (TempRead>=MIDI_CHAR_FIFO_SIZE) TempRead=0;  // Could be a mask for faster update
-                    }
-                }  // Buffer to JACK allocated
-            }  // Non SYSEX message
-        }  // loop over all events in the queue
-
-        // Update read pointer only when we have parsed the whole buffer
-        MIDI2JACK.ReadPtr=TempRead;
-    }  // MIDI data available from RTP-MIDI queue
-
-    // Generate RTP-MIDI payload (with null delta-time) for each event sent by JACK
-    if(event_count >= 1)
-    {
-        // Make a snapshot of current FIFO position
-        TempWrite=JACK2RTP.WritePtr;
+    for (SessionNum=0; SessionNum<NewNum; SessionNum++)
+    {
+        Slot=&SessionPool->Sessions[SessionNum];
+        Statistics->SetSession (SessionNum, Slot->Name, Slot->Handler!=0);
+    }
+    Statistics->SetNumSessions (NewNum);
 
-        for(i=0; i<event_count; i++)
+    OldRouting=NextConfig.Routing;
+    OldFilters=NextConfig.Filters;
+    if (PublishConfiguration (NewRouting, NewFilters, NewNum, 0, OpenedMask, RenameMask))
+    {
+        delete OldRouting;
+        delete OldFilters;
+    }
+    else fprintf (stderr, "jackrtpmidid : realtime threads not responding, previous routing not released\n");
+    delete NewPool;
+
+    for (SessionNum=0; SessionNum<NewNum; SessionNum++)
+    {
+        Slot=&SessionPool->Sessions[SessionNum];
+        printf ("Session %u : %s (port %u)%s\n", SessionNum+1, Slot->Name, Slot->ControlPort, Slot->Handler ? "" : " not opened");
+    }
+}  // ReloadConfiguration
+// ----------------------------------------------------
+
+// Creates the queues and the event loop of each worker and gives the sessions to the workers
+// With -rtcpu, each worker is pinned on its own CPU of the list when the list has enough CPUs, else on all CPUs of the list
+void CreateWorkers (void)
+{
+    TRTWorker* Worker;
+    unsigned int WorkerNum;
+    unsigned int SessionNum;
+    unsigned int CPU;
+
+    for (WorkerNum=0; WorkerNum<NumWorkers; WorkerNum++)
+    {
+        Worker=&Workers[WorkerNum];
+        Worker->Thread=0;
+        Worker->ToJACKPool = new CSysExPool (SYSEX_POOL_CHUNKS);
+        Worker->FromJACK = new CMIDIEventQueue (MIDI_EVENT_QUEUE_SIZE);
+        Worker->FromJACKPool = new CSysExPool (SYSEX_POOL_CHUNKS);
+        Worker->TXCycleNanos.store (0);
+        Worker->Routing=NextConfig.Routing;
+        Worker->Filters=NextConfig.Filters;
+        Worker->Generation.store (ConfigGeneration.load());
+        Worker->TXPendingMask=0;
+        Worker->ArrivalValidMask=0;
+        Worker->TimestampValidMask=0;
+        Worker->PausedMask=0;
+
+        Worker->SessionMask=0;
+        for (SessionNum=WorkerNum; SessionNum<MAX_SESSIONS; SessionNum+=NumWorkers)
         {
-            jack_midi_event_get(&in_event, in_port_buf, i);
-            NumBytesInEvent=in_event.size;
+            Worker->SessionMask|=(1u<<SessionNum);
+            ToJACKQueues[SessionNum] = new CMIDIEventQueue (MIDI_EVENT_QUEUE_SIZE);
+            ToJACKMarks[SessionNum]=ToJACKQueues[SessionNum]->GetMark();
+        }
 
-            // Try to store the event in the queue
-            // Add leading null delta-time
-            JACK2RTP.FIFO[TempWrite++]=0x00;
-            if (TempWrite>=MIDI_CHAR_FIFO_SIZE) TempWrite=0;
-            if (TempWrite==JACK2RTP.ReadPtr) return 0;      // FIFO is full discard the message
-            // TODO : maybe we can save the TempWrite for the last valid message and send what has been stored successfully
+        Worker->PinThread=PinRTThread;
+        Worker->CPUs=RTThreadCPUs;
 
-            // Copy all the bytes from the JACK MIDI message to the queue
-            for (ByteCounter=0; ByteCounter<NumBytesInEvent; ByteCounter++)
-            {
-                JACK2RTP.FIFO[TempWrite++]=in_event.buffer[ByteCounter];
-                if (TempWrite>=MIDI_CHAR_FIFO_SIZE) TempWrite=0;
-                if (TempWrite==JACK2RTP.ReadPtr) return 0;      // FIFO is full discard the message
-            }
+        Worker->Loop = new CRTEventLoop ();
+        if (Worker->Loop->Init (SESSION_TICK_MICROS)==false)
+        {
+            fprintf (stderr, "jackrtpmidid : can not create event loop for realtime thread %u, using polling mode\n", WorkerNum+1);
+            delete Worker->Loop;
+            Worker->Loop = 0;
+        }
+    }
+
+    if ((PinRTThread)&&((unsigned int)CPU_COUNT (&RTThreadCPUs)>=NumWorkers))
+    {
+        WorkerNum=0;
+        for (CPU=0; (CPU<CPU_SETSIZE)&&(WorkerNum<NumWorkers); CPU++)
+        {
+            if (CPU_ISSET (CPU, &RTThreadCPUs)==0) continue;
+            CPU_ZERO (&Workers[WorkerNum].CPUs);
+            CPU_SET (CPU, &Workers[WorkerNum].CPUs);
+            WorkerNum++;
         }
+    }
+}  // CreateWorkers
+// ----------------------------------------------------
+
+// Deletes the event loops and queues of the workers (threads must be stopped)
+void DeleteWorkers (void)
+{
+    TRTWorker* Worker;
+    unsigned int WorkerNum;
+    unsigned int SessionNum;
 
-        // Update FIFO pointer when all events to send have been read
-        JACK2RTP.WritePtr=TempWrite;
+    for (WorkerNum=0; WorkerNum<NumWorkers; WorkerNum++)
+    {
+        Worker=&Workers[WorkerNum];
+        delete Worker->Loop;
+        Worker->Loop=0;
+        delete Worker->ToJACKPool;
+        Worker->ToJACKPool=0;
+        delete Worker->FromJACK;
+        Worker->FromJACK=0;
+        delete Worker->FromJACKPool;
+        Worker->FromJACKPool=0;
+    }
+
+    for (SessionNum=0; SessionNum<MAX_SESSIONS; SessionNum++)
+    {
+        delete ToJACKQueues[SessionNum];
+        ToJACKQueues[SessionNum]=0;
+    }
+}  // DeleteWorkers
+// ----------------------------------------------------
+
+// Writes the records captured by the realtime threads to the capture file (normal priority thread)
+void* CaptureThreadFunc (CThread* Control)
+{
+    while (Control->ShouldStop==false)
+    {
+        Capture->Drain();
+        SystemSleepMillis (CAPTURE_WRITE_MS);
     }
 
+    Control->IsStopped=true;
+    pthread_exit(NULL);
     return 0;
-}  // jack_process
+}  // CaptureThreadFunc
 // ----------------------------------------------------
 
-/* Callback function called when jack server is shut down */
-void jack_shutdown(void *arg)
+// Creates the capture file and its writer thread. The daemon runs without capture if the file can not be created
+void StartCapture (void)
 {
-    printf ("JACK has shut down\n");
-    break_request=true;
-}  // jack_shutdown
+    uint16_t ControlPorts[CAPTURE_MAX_SESSIONS];
+    unsigned int SessionNum;
+
+    for (SessionNum=0; (SessionNum<SessionPool->NumSessions)&&(SessionNum<CAPTURE_MAX_SESSIONS); SessionNum++)
+        ControlPorts[SessionNum]=SessionPool->Sessions[SessionNum].ControlPort;
+
+    Capture = new CCapture ();
+    if (Capture->Open (CaptureFileName, NumWorkers+1, SampleRate, SessionPool->NumSessions, &ControlPorts[0])==false)
+    {
+        delete Capture;
+        Capture = 0;
+        return;
+    }
+
+    CaptureThread = new CThread((ThreadFuncType*)CaptureThreadFunc, 0, 0);
+    printf ("Capturing received packets and JACK events to %s\n", CaptureFileName);
+}  // StartCapture
 // ----------------------------------------------------
 
-void sig_handler (int signo)
+// Stops the writer thread and closes the capture file (realtime threads and JACK client must be stopped)
+void StopCapture (void)
 {
-    if (signo == SIGINT)
+    if (Capture==0) return;
+
+    if (CaptureThread)
     {
-        break_request=true;
+        CaptureThread->StopThread(500);
+        delete CaptureThread;
+        CaptureThread = 0;
     }
-}  // sig_handler
+    Capture->Close();
+    delete Capture;
+    Capture = 0;
+}  // StopCapture
+// ----------------------------------------------------
+
+// Prints the NetUMP session state changes posted by the realtime thread (main thread)
+void ReportNetUMPEvents (void)
+{
+    TNetUMPEvent Event;
+
+    if (NetUMP==0) return;
+    while (NetUMP->GetEvent (&Event))
+    {
+        if (Event.Type==NETUMP_EVENT_OPENED) printf ("NetUMP session opened with %s:%u\n", inet_ntoa (Event.Address), ntohs (Event.Port));
+        else if (Event.Type==NETUMP_EVENT_BYE) printf ("NetUMP session closed by client\n");
+        else printf ("NetUMP session closed\n");
+    }
+}  // ReportNetUMPEvents
+// ----------------------------------------------------
+
+void print_usage (void)
+{
+    fprintf (stderr, "Usage : jackrtpmidid [-latency frames] [-txlatency frames] [-txdeadline us] [-sessions count] [-baseport port] [-config file] [-multiport] [-routes file] [-filters file] [-jitter min max] [-netump port] [-jackump]\n");
+    fprintf (stderr, "                     [-rtthreads count] [-rtprio offset] [-rtcpu cpus] [-jackcpu cpus] [-mlock] [-capture file]\n");
+}  // print_usage
 // ----------------------------------------------------
 
 int main(int argc, char** argv)
 {
-    int Ret;
     int MaxPrio;
-    jack_client_t *client;
+    int JACKPrio;
+    bool LockMemory=false;
+    int ArgNum;
+    unsigned int SessionNum;
+    unsigned int WorkerNum;
+    unsigned int NumOpened=0;
+    TSessionSlot* Slot;
+    CRoutingMatrix* Routing;
+    CFilterSet* Filters;
+
+    StartAudit();
 
-    printf ("JACK <-> RTP-MIDI bridge V1.0 for Zynthian\n");
+    printf ("JACK <-> RTP-MIDI bridge V1.1 for Zynthian\n");
     printf ("Copyright 2019/2024 Benoit BOUCHEZ (BEB)\n");
     printf ("Please report any issue to BEB on https:\\discourse.zynthian.org\n");
 
     break_request=false;
+    reload_request=false;
     signal (SIGINT, sig_handler);
+    signal (SIGHUP, sig_handler);
+
+    for (ArgNum=1; ArgNum<argc; ArgNum++)
+    {
+        if ((strcmp (argv[ArgNum], "-latency")==0)&&(ArgNum+1<argc))
+        {  // Fixed latency (in frames) applied to events received from network
+            ArgNum++;
+            LatencyFrames=(jack_nframes_t)atoi (argv[ArgNum]);
+        }
+        else if ((strcmp (argv[ArgNum], "-txlatency")==0)&&(ArgNum+1<argc))
+        {  // Delay (in frames) between the JACK time of sent events and their RTP time
+            ArgNum++;
+            TXLatencyFrames=atoi (argv[ArgNum]);
+            if (TXLatencyFrames<0) TXLatencyFrames=0;
+        }
+        else if ((strcmp (argv[ArgNum], "-txdeadline")==0)&&(ArgNum+1<argc))
+        {  // Time (in microseconds) after the start of the JACK period at which its events are sent
+            ArgNum++;
+            TXDeadlineMicros=atoi (argv[ArgNum]);
+            if (TXDeadlineMicros<0) TXDeadlineMicros=0;
+        }
+        else if ((strcmp (argv[ArgNum], "-sessions")==0)&&(ArgNum+1<argc))
+        {  // Number of sessions created on consecutive ports
+            ArgNum++;
+            NumDefaultSessions=(unsigned int)atoi (argv[ArgNum]);
+        }
+        else if ((strcmp (argv[ArgNum], "-baseport")==0)&&(ArgNum+1<argc))
+        {  // Control port of first session
+            ArgNum++;
+            BasePort=(unsigned short)atoi (argv[ArgNum]);
+        }
+        else if ((strcmp (argv[ArgNum], "-config")==0)&&(ArgNum+1<argc))
+        {  // Sessions defined in a file
+            ArgNum++;
+            ConfigFileName=argv[ArgNum];
+        }
+        else if (strcmp (argv[ArgNum], "-multiport")==0)
+        {
+            MultiPort=true;
+        }
+        else if ((strcmp (argv[ArgNum], "-routes")==0)&&(ArgNum+1<argc))
+        {  // Routing matrix and channel filters
+            ArgNum++;
+            RoutingFileName=argv[ArgNum];
+        }
+        else if ((strcmp (argv[ArgNum], "-filters")==0)&&(ArgNum+1<argc))
+        {  // Filtering and thinning of messages per session
+            ArgNum++;
+            FilterFileName=argv[ArgNum];
+        }
+        else if ((strcmp (argv[ArgNum], "-jitter")==0)&&(ArgNum+2<argc))
+        {  // Jitter buffer delay limits (ms) for all sessions
+            JitterEnabled=true;
+            JitterMinMs=(unsigned int)atoi (argv[ArgNum+1]);
+            JitterMaxMs=(unsigned int)atoi (argv[ArgNum+2]);
+            ArgNum+=2;
+        }
+        else if ((strcmp (argv[ArgNum], "-netump")==0)&&(ArgNum+1<argc))
+        {  // UDP port of NetUMP endpoint
+            ArgNum++;
+            NetUMPPort=(unsigned short)atoi (argv[ArgNum]);
+        }
+        else if (strcmp (argv[ArgNum], "-jackump")==0)
+        {
+            JACKUMPPorts=true;
+        }
+        else if ((strcmp (argv[ArgNum], "-rtthreads")==0)&&(ArgNum+1<argc))
+        {  // Number of realtime threads sharing the sessions
+            ArgNum++;
+            NumWorkers=(unsigned int)atoi (argv[ArgNum]);
+            if (NumWorkers<1) NumWorkers=1;
+            if (NumWorkers>MAX_RT_WORKERS) NumWorkers=MAX_RT_WORKERS;
+        }
+        else if ((strcmp (argv[ArgNum], "-rtprio")==0)&&(ArgNum+1<argc))
+        {  // Realtime thread priority relative to JACK client threads
+            ArgNum++;
+            PriorityFromJACK=true;
+            PriorityOffset=atoi (argv[ArgNum]);
+        }
+        else if ((strcmp (argv[ArgNum], "-rtcpu")==0)&&(ArgNum+1<argc))
+        {  // CPUs of realtime thread
+            ArgNum++;
+            PinRTThread=true;
+            if (ParseCPUList (argv[ArgNum], &RTThreadCPUs)==false)
+            {
+                fprintf (stderr, "jackrtpmidid : invalid CPU list %s\n", argv[ArgNum]);
+                return 1;
+            }
+        }
+        else if ((strcmp (argv[ArgNum], "-jackcpu")==0)&&(ArgNum+1<argc))
+        {  // CPUs of JACK process thread
+            ArgNum++;
+            PinJACKThread=true;
+            if (ParseCPUList (argv[ArgNum], &JACKThreadCPUs)==false)
+            {
+                fprintf (stderr, "jackrtpmidid : invalid CPU list %s\n", argv[ArgNum]);
+                return 1;
+            }
+        }
+        else if (strcmp (argv[ArgNum], "-mlock")==0)
+        {
+            LockMemory=true;
+        }
+        else if ((strcmp (argv[ArgNum], "-capture")==0)&&(ArgNum+1<argc))
+        {  // Received datagrams and JACK events written to a file for jackrtpmidireplay
+            ArgNum++;
+            CaptureFileName=argv[ArgNum];
+        }
+        else
+        {
+            fprintf (stderr, "jackrtpmidid : unknown option %s\n", argv[ArgNum]);
+            print_usage();
+            return 1;
+        }
+    }
 
-    MIDI2JACK.ReadPtr=0;
-    MIDI2JACK.WritePtr=0;
+    // Memory is locked before anything is allocated, so all buffers are locked when created
+    if (LockMemory)
+    {
+        if (LockProcessMemory()==false) fprintf (stderr, "jackrtpmidid : can not lock memory (check memlock limit)\n");
+    }
 
-    JACK2RTP.ReadPtr=0;
-    JACK2RTP.WritePtr=0;
+    SessionPool=CreateSessionPool();
+    if (SessionPool==0) return 1;
+    if (CreateRoutes (SessionPool->NumSessions, &Routing, &Filters)==false) return 1;
+
+    // Realtime threads start with the same configuration
+    JACKRouting=Routing;
+    JACKFilters=Filters;
+    JACKNumSessions=SessionPool->NumSessions;
+    NextConfig.Routing=Routing;
+    NextConfig.Filters=Filters;
+    NextConfig.NumSessions=SessionPool->NumSessions;
+    NextConfig.CloseMask=0;
+    NextConfig.OpenMask=0;
+    NextConfig.RenameMask=0;
 
     if ((client = jack_client_open ("jackrtpmidid", JackNullOption, NULL)) == 0)
     {
         fprintf(stderr, "jackrtpmidid : JACK server not running\n");
         return 1;
     }
+    SampleRate=jack_get_sample_rate (client);
+    // Events sent at the deadline are older : default delay covers the deadline
+    if (TXLatencyFrames<0)
+    {
+        TXLatencyFrames=(int)(SampleRate/1000);
+        if (TXDeadlineMicros>0) TXLatencyFrames+=(int)(((uint64_t)TXDeadlineMicros*SampleRate)/1000000);
+    }
+    Filters->SetSampleRate (SampleRate);
 
-    RTPMIDIHandler1 = new CRTP_MIDI (2048, &RTPMIDICallback, 0);
-    if (RTPMIDIHandler1)
+    Statistics = new CStatistics ();
+    Statistics->Open (MIDI_EVENT_QUEUE_SIZE);
+    Stats=Statistics->Block;
+    Stats->TXDeadlineMicros=TXDeadlineMicros;
+    for (SessionNum=0; SessionNum<MAX_SESSIONS; SessionNum++)
     {
-        RTPMIDIHandler1->setSessionName((char*)"Zynthian RTP-MIDI 1");
-        Ret=RTPMIDIHandler1->InitiateSession (0, 5004, 5005, 5004, 5005, false);
-        if (Ret==-1) fprintf (stderr, "jackrtpmidid : can not create control socket for session 1\n");
-        else if (Ret==-2) fprintf (stderr, "jackrtpmidid : can not create data socket for session 1\n");
-        if (Ret!=0)
-        {
-            delete RTPMIDIHandler1;
-            RTPMIDIHandler1 = 0;
-        }
+        TXPackets[SessionNum].SetSampleRate (SampleRate);
+        TXGuards[SessionNum].SetRepeatInterval ((SampleRate*RELEASE_REPEAT_MS)/1000);
+    }
+    for (SessionNum=0; SessionNum<SessionPool->NumSessions; SessionNum++)
+    {
+        Slot=&SessionPool->Sessions[SessionNum];
+        if (Slot->JitterEnabled) JitterBuffers[SessionNum].Configure (SampleRate, Slot->JitterMinMs, Slot->JitterMaxMs);
+        ClockModels[SessionNum].Configure (SampleRate);
     }
 
-    RTPMIDIHandler2 = new CRTP_MIDI (2048, &RTPMIDICallback, 0);    // We can use the same callback for the two handlers, as they run in the same thread
-    if (RTPMIDIHandler2)
+    CreateWorkers();
+    if (CaptureFileName) StartCapture();
+
+    if (NetUMPPort!=0)
     {
-        RTPMIDIHandler2->setSessionName((char*)"Zynthian RTP-MIDI 2");
-        Ret=RTPMIDIHandler2->InitiateSession (0, 5006, 5007, 5006, 5007, false);
-        if (Ret==-1) fprintf (stderr, "jackrtpmidid : can not create control socket for session 2\n");
-        else if (Ret==-2) fprintf (stderr, "jackrtpmidid : can not create data socket for session 2\n");
-        if (Ret!=0)
+        UMP2JACK = new CUMPQueue (UMP_QUEUE_WORDS);
+        JACK2UMP = new CUMPQueue (UMP_QUEUE_WORDS);
+        NetUMP = new CNetUMP ();
+        if (NetUMP->Open (NetUMPPort, "Zynthian NetUMP", "jackrtpmidid")==false)
         {
-            delete RTPMIDIHandler2;
-            RTPMIDIHandler2 = 0;
+            fprintf (stderr, "jackrtpmidid : can not open NetUMP socket on port %u\n", NetUMPPort);
+            delete NetUMP;
+            NetUMP = 0;
         }
+        else if (Workers[0].Loop) Workers[0].Loop->AddUMPSocket (NetUMP->GetSocket());
+    }
+
+    for (SessionNum=0; SessionNum<SessionPool->NumSessions; SessionNum++)
+    {
+        if (SessionPool->OpenSession (SessionNum, &RTPMIDICallback, WorkerOf (SessionNum)->Loop)==false) continue;
+        SessionPool->OpenedMask.fetch_or (1u<<SessionNum);
+        NumOpened++;
     }
+    if (NumOpened==0)
+        fprintf (stderr, "jackrtpmidid : no RTP-MIDI session could be opened\n");
+    for (SessionNum=0; SessionNum<SessionPool->NumSessions; SessionNum++)
+        Statistics->SetSession (SessionNum, SessionPool->Sessions[SessionNum].Name, (SessionPool->OpenedMask&(1u<<SessionNum))!=0);
 
     // Register the various callbacks needed by a JACK application
     jack_set_process_callback (client, jack_process, 0);
     jack_on_shutdown (client, jack_shutdown, 0);
+    jack_set_xrun_callback (client, jack_xrun, 0);
+    jack_set_thread_init_callback (client, jack_thread_init, 0);
 
     input_port = jack_port_register (client, "rtpmidi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
     output_port = jack_port_register (client, "rtpmidi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
 
+    if (MultiPort)
+    {
+        for (SessionNum=0; SessionNum<SessionPool->NumSessions; SessionNum++)
+        {
+            if (RegisterSessionPorts (SessionNum)==false) return -1;
+        }
+    }
+
+    if (NetUMP)
+    {
+        UMPInputPort = jack_port_register (client, "ump_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput|(JACKUMPPorts ? JACK_PORT_IS_MIDI2 : 0), 0);
+        UMPOutputPort = jack_port_register (client, "ump_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput|(JACKUMPPorts ? JACK_PORT_IS_MIDI2 : 0), 0);
+        if ((UMPInputPort==0)||(UMPOutputPort==0))
+        {
+            fprintf (stderr, "jackrtpmidid : can not register JACK ports for NetUMP\n");
+            return -1;
+        }
+    }
+
     if (jack_activate (client))
     {
             fprintf(stderr, "jackrtpmidid : cannot activate client");
@@ -352,48 +2124,96 @@ int main(int argc, char** argv)
 
     // Start realtime thread
     MaxPrio = sched_get_priority_max(SCHED_FIFO);
-    RTThread = new CThread((ThreadFuncType*)RTThreadFunc, MaxPrio, 0);
-    if (RTThread == 0)
+    if (PriorityFromJACK)
+    {
+        JACKPrio=jack_client_real_time_priority (client);
+        if (JACKPrio<=0) fprintf (stderr, "jackrtpmidid : JACK is not running in realtime mode, -rtprio ignored\n");
+        else
+        {
+            MaxPrio=JACKPrio+PriorityOffset;
+            if (MaxPrio<sched_get_priority_min(SCHED_FIFO)) MaxPrio=sched_get_priority_min(SCHED_FIFO);
+            if (MaxPrio>sched_get_priority_max(SCHED_FIFO)) MaxPrio=sched_get_priority_max(SCHED_FIFO);
+        }
+    }
+    for (WorkerNum=0; WorkerNum<NumWorkers; WorkerNum++)
     {
-        fprintf (stderr, "Can not create realtime communication thread");
-        return -2;
+        Workers[WorkerNum].Thread = new CThread((ThreadFuncType*)RTThreadFunc, MaxPrio, 0);
+        if (Workers[WorkerNum].Thread == 0)
+        {
+            fprintf (stderr, "Can not create realtime communication thread");
+            return -2;
+        }
     }
 
+    // From now on, realtime threads must not allocate memory
+    ArmAllocationCheck();
+
     /* run until interrupted */
     while(break_request==false)
     {
         SystemSleepMillis(100);
+        if (reload_request)
+        {
+            reload_request=false;
+            ReloadConfiguration();
+        }
+        PrintAuditReport();
+        ReportNetUMPEvents();
+        Stats->RTAuditViolations.store (GetAuditViolations(), std::memory_order_relaxed);
     }
     printf ("Program termination requested by user\n");
+    if (GetAuditViolations()>0)
+        fprintf (stderr, "jackrtpmidid : %llu forbidden calls made by realtime threads\n", (unsigned long long)GetAuditViolations());
+    if (GetRealtimeAllocations()>0)
+        fprintf (stderr, "jackrtpmidid : %llu memory allocations made by realtime threads\n", (unsigned long long)GetRealtimeAllocations());
 
-    // Stop realtime communication thread
-    if (RTThread)
+    // Stop realtime communication threads
+    for (WorkerNum=0; WorkerNum<NumWorkers; WorkerNum++)
     {
-        printf ("Stopping realtime thread...\n");
-        RTThread->StopThread(500);
-        delete RTThread;
-        RTThread = 0;
+        if (Workers[WorkerNum].Thread==0) continue;
+        printf ("Stopping realtime thread %u...\n", WorkerNum+1);
+        Workers[WorkerNum].Thread->StopThread(500);
+        delete Workers[WorkerNum].Thread;
+        Workers[WorkerNum].Thread = 0;
     }
 
     // Clean everything before we exit
     jack_client_close(client);
+    StopCapture();
 
-    if (RTPMIDIHandler1)
+    if (NetUMP)
     {
-        printf ("Closing RTP-MIDI handler for session 1...\n");
-        RTPMIDIHandler1->CloseSession();
-        delete RTPMIDIHandler1;
-        RTPMIDIHandler1=0;
+        NetUMP->Close();
+        delete NetUMP;
+        NetUMP = 0;
     }
 
-    if (RTPMIDIHandler2)
+    if (SessionPool)
     {
-        printf ("Closing RTP-MIDI handler for session 2...\n");
-        RTPMIDIHandler2->CloseSession();
-        delete RTPMIDIHandler2;
-        RTPMIDIHandler2=0;
+        SessionPool->CloseSessions();
+        delete SessionPool;
+        SessionPool=0;
     }
 
+    // Objects taken by realtime threads are the last ones published
+    delete NextConfig.Routing;
+    NextConfig.Routing=0;
+    JACKRouting=0;
+    delete NextConfig.Filters;
+    NextConfig.Filters=0;
+    JACKFilters=0;
+
+    DeleteWorkers();
+    delete UMP2JACK;
+    UMP2JACK=0;
+    delete JACK2UMP;
+    JACK2UMP=0;
+
+    // Removes the shared memory segment
+    Stats=0;
+    delete Statistics;
+    Statistics=0;
+
     printf ("Done...\n");
 
     return (EXIT_SUCCESS);
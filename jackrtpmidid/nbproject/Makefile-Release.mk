@@ -41,8 +41,22 @@ OBJECTFILES= \
 	${OBJECTDIR}/_ext/e6ab54e0/RTP_MIDI.o \
 	${OBJECTDIR}/_ext/e6ab54e0/RTP_MIDI_AppleProtocol.o \
 	${OBJECTDIR}/_ext/e6ab54e0/RTP_MIDI_Input.o \
-	${OBJECTDIR}/_ext/5c0/jackrtpmidid.o
-
+	${OBJECTDIR}/_ext/5c0/jackrtpmidid.o \
+	${OBJECTDIR}/_ext/5c0/RTEventLoop.o \
+	${OBJECTDIR}/_ext/5c0/SessionManager.o \
+	${OBJECTDIR}/_ext/5c0/RoutingMatrix.o \
+	${OBJECTDIR}/_ext/5c0/RTPMIDIPacket.o \
+	${OBJECTDIR}/_ext/5c0/Statistics.o \
+	${OBJECTDIR}/_ext/5c0/RecoveryJournal.o \
+	${OBJECTDIR}/_ext/5c0/JitterBuffer.o \
+	${OBJECTDIR}/_ext/5c0/UMPTranslator.o \
+	${OBJECTDIR}/_ext/5c0/NetUMP.o \
+	${OBJECTDIR}/_ext/5c0/RTSetup.o \
+	${OBJECTDIR}/_ext/5c0/RTAudit.o \
+	${OBJECTDIR}/_ext/5c0/ClockModel.o \
+	${OBJECTDIR}/_ext/5c0/MIDIFilter.o \
+	${OBJECTDIR}/_ext/5c0/Capture.o \
+	${OBJECTDIR}/_ext/5c0/MIDIParser.o
 
 # C Compiler Flags
 CFLAGS=
@@ -58,7 +72,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=-ljack -lpthread
+LDLIBSOPTIONS=-ljack -lpthread -lrt -ldl
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -103,6 +117,81 @@ ${OBJECTDIR}/_ext/5c0/jackrtpmidid.o: ../jackrtpmidid.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/jackrtpmidid.o ../jackrtpmidid.cpp
 
+${OBJECTDIR}/_ext/5c0/RTEventLoop.o: ../RTEventLoop.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/RTEventLoop.o ../RTEventLoop.cpp
+
+${OBJECTDIR}/_ext/5c0/SessionManager.o: ../SessionManager.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/SessionManager.o ../SessionManager.cpp
+
+${OBJECTDIR}/_ext/5c0/RoutingMatrix.o: ../RoutingMatrix.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/RoutingMatrix.o ../RoutingMatrix.cpp
+
+${OBJECTDIR}/_ext/5c0/RTPMIDIPacket.o: ../RTPMIDIPacket.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/RTPMIDIPacket.o ../RTPMIDIPacket.cpp
+
+${OBJECTDIR}/_ext/5c0/Statistics.o: ../Statistics.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/Statistics.o ../Statistics.cpp
+
+${OBJECTDIR}/_ext/5c0/RecoveryJournal.o: ../RecoveryJournal.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/RecoveryJournal.o ../RecoveryJournal.cpp
+
+${OBJECTDIR}/_ext/5c0/JitterBuffer.o: ../JitterBuffer.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/JitterBuffer.o ../JitterBuffer.cpp
+
+${OBJECTDIR}/_ext/5c0/UMPTranslator.o: ../UMPTranslator.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/UMPTranslator.o ../UMPTranslator.cpp
+
+${OBJECTDIR}/_ext/5c0/NetUMP.o: ../NetUMP.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/NetUMP.o ../NetUMP.cpp
+
+${OBJECTDIR}/_ext/5c0/RTSetup.o: ../RTSetup.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/RTSetup.o ../RTSetup.cpp
+
+${OBJECTDIR}/_ext/5c0/RTAudit.o: ../RTAudit.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/RTAudit.o ../RTAudit.cpp
+
+${OBJECTDIR}/_ext/5c0/ClockModel.o: ../ClockModel.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/ClockModel.o ../ClockModel.cpp
+
+${OBJECTDIR}/_ext/5c0/MIDIFilter.o: ../MIDIFilter.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/MIDIFilter.o ../MIDIFilter.cpp
+
+${OBJECTDIR}/_ext/5c0/Capture.o: ../Capture.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/Capture.o ../Capture.cpp
+
+${OBJECTDIR}/_ext/5c0/MIDIParser.o: ../MIDIParser.cpp
+	${MKDIR} -p ${OBJECTDIR}/_ext/5c0
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -D__TARGET_LINUX__ -I../../RTP-MIDI -I../../../../../SDK/beb/common_src -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/5c0/MIDIParser.o ../MIDIParser.cpp
+
 # Subprojects
 .build-subprojects:
 
@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# Runs jackrtpmidibench against jackrtpmidid on loopback, with a JACK dummy backend
+# Usage : bench.sh <jackrtpmidid binary> <jackrtpmidibench binary> [benchmark options]
+# A JACK server already running is used as is (set BENCH_JACKD_ARGS to change the dummy backend settings)
+#
+
+DAEMON=$1
+BENCH=$2
+if [ -z "$DAEMON" ] || [ -z "$BENCH" ]; then
+    echo "Usage : bench.sh <jackrtpmidid binary> <jackrtpmidibench binary> [benchmark options]"
+    exit 1
+fi
+shift 2
+
+JACKD_PID=
+if ! jack_lsp > /dev/null 2>&1; then
+    jackd ${BENCH_JACKD_ARGS:--d dummy -r 48000 -p 128} > /dev/null 2>&1 &
+    JACKD_PID=$!
+    sleep 2
+fi
+
+"$DAEMON" > /dev/null 2>&1 &
+DAEMON_PID=$!
+sleep 1
+
+"$BENCH" "$@"
+RESULT=$?
+
+kill -INT $DAEMON_PID
+wait $DAEMON_PID 2> /dev/null
+if [ -n "$JACKD_PID" ]; then
+    kill $JACKD_PID
+    wait $JACKD_PID 2> /dev/null
+fi
+
+exit $RESULT
@@ -0,0 +1,821 @@
+/*
+ * File:   jackrtpmidibench.cpp
+ * Loopback benchmark : latency, jitter and loss through jackrtpmidid in both directions
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ The benchmark is at the same time :
+ - an RTP-MIDI peer on loopback, which invites the first session of the daemon (Apple session
+   protocol), sends it timestamped messages and receives the messages sent by the daemon
+ - a JACK client connected to rtpmidi_in / rtpmidi_out of the daemon
+
+ Each message carries a 14 bit sequence number, so its latency is the time between the send
+ on one side and the reception on the other side. All times come from jack_get_time(), so both
+ sides share the same clock.
+   Network -> JACK : polyphonic pressure on channel 1 (A0 seq_hi seq_lo), SYSEX F0 7D seq_hi seq_lo ... F7
+   JACK -> network : polyphonic pressure on channel 2 (A1 seq_hi seq_lo), same SYSEX format
+ Latencies from network to JACK include the fixed latency of the daemon (-latency option).
+
+ Build : g++ -O2 -o jackrtpmidibench jackrtpmidibench.cpp -ljack -lpthread
+ Usage : see print_usage or tools/bench.sh
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <algorithm>
+#include <jack/jack.h>
+#include <jack/midiport.h>
+
+#define DEFAULT_NOTE_RATE       1000            // Messages per second in each direction
+#define DEFAULT_DURATION        10              // Seconds
+#define DEFAULT_SYSEX_RATE      10              // SYSEX per second in each direction
+#define DEFAULT_BASE_PORT       5004
+#define MAX_SYSEX_SIZE          1000            // Network side sends each SYSEX in a single packet
+
+#define SEQ_RANGE               16384           // Sequence numbers are coded on 14 bits
+#define MAX_SAMPLES             (1<<20)         // Latency samples kept per stream
+
+#define BENCH_SSRC              0x42454E43
+#define RTP_TIMESTAMP_RATE      10000
+#define DRAIN_MICROS            500000          // Time left to the last messages after the end of the test
+
+// Streams measured
+#define STREAM_NET_NOTES        0
+#define STREAM_NET_SYSEX        1
+#define STREAM_JACK_NOTES       2
+#define STREAM_JACK_SYSEX       3
+#define NUM_STREAMS             4
+
+typedef struct {
+    const char* Name;
+    std::atomic<uint64_t> SendTime[SEQ_RANGE];  // 0 when no message is waiting with this sequence number
+    std::atomic<uint32_t> Sent;                 // Written by sending side
+    uint32_t Received;                          // Written by receiving side
+    uint32_t NumSamples;
+    float* Samples;                             // Latencies in microseconds (preallocated)
+} TBenchStream;
+
+TBenchStream Streams[NUM_STREAMS];
+
+// Parameters
+unsigned int NoteRate=DEFAULT_NOTE_RATE;
+unsigned int Duration=DEFAULT_DURATION;
+unsigned int SysExSize=0;
+unsigned int SysExRate=DEFAULT_SYSEX_RATE;
+unsigned short DaemonPort=DEFAULT_BASE_PORT;
+const char* DaemonClient="jackrtpmidid";
+
+jack_client_t* client=0;
+jack_port_t* input_port;
+jack_port_t* output_port;
+jack_nframes_t SampleRate=48000;
+std::atomic<bool> Running (false);              // Messages are sent while true
+bool break_request=false;
+
+// JACK side generator state (jack_process only)
+double NextNoteFrame=0;
+double NextSysExFrame=0;
+bool GeneratorStarted=false;
+unsigned int JACKNoteSeq=0;
+unsigned int JACKSysExSeq=0;
+int JACKSysExPending=-1;                        // Sequence number of SYSEX being received from JACK
+
+// Network side state
+int ControlSocket=-1;
+int DataSocket=-1;
+struct sockaddr_in DaemonControl;
+struct sockaddr_in DaemonData;
+uint16_t RTPSequence=0;
+int NetSysExPending=-1;                         // Sequence number of SYSEX being received from the daemon
+
+// Records the send time of a message
+void MarkSent (unsigned int Stream, unsigned int Seq, uint64_t Time)
+{
+    if (Time==0) Time=1;
+    Streams[Stream].SendTime[Seq&(SEQ_RANGE-1)].store (Time, std::memory_order_release);
+    Streams[Stream].Sent.fetch_add (1, std::memory_order_relaxed);
+}  // MarkSent
+//-----------------------------------------------------------------------------
+
+// Records the reception of a message. Duplicates and unknown sequence numbers are ignored
+void MarkReceived (unsigned int Stream, unsigned int Seq, uint64_t Time)
+{
+    TBenchStream* S=&Streams[Stream];
+    uint64_t SendTime;
+
+    SendTime=S->SendTime[Seq&(SEQ_RANGE-1)].exchange (0, std::memory_order_acq_rel);
+    if (SendTime==0) return;
+
+    S->Received++;
+    if (S->NumSamples<MAX_SAMPLES)
+        S->Samples[S->NumSamples++]=(Time>SendTime) ? (float)(Time-SendTime) : 0.0f;
+}  // MarkReceived
+//-----------------------------------------------------------------------------
+
+// Builds a test SYSEX. Returns its size
+unsigned int MakeSysEx (unsigned char* Buffer, unsigned int Seq)
+{
+    unsigned int Pos;
+
+    Buffer[0]=0xF0;
+    Buffer[1]=0x7D;                             // Non commercial manufacturer ID
+    Buffer[2]=(Seq>>7)&0x7F;
+    Buffer[3]=Seq&0x7F;
+    for (Pos=4; Pos<SysExSize-1; Pos++)
+        Buffer[Pos]=Pos&0x7F;
+    Buffer[SysExSize-1]=0xF7;
+    return SysExSize;
+}  // MakeSysEx
+//-----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+// JACK side
+// ---------------------------------------------------------------------------
+
+int jack_process (jack_nframes_t nframes, void *arg)
+{
+    void* in_port_buf=jack_port_get_buffer(input_port, nframes);
+    void* out_port_buf=jack_port_get_buffer(output_port, nframes);
+    jack_nframes_t PeriodStart;
+    jack_nframes_t event_count;
+    jack_midi_event_t in_event;
+    jack_midi_data_t* Buffer;
+    unsigned int i;
+    unsigned int Offset;
+    uint64_t Time;
+
+    (void)arg;
+    jack_midi_clear_buffer(out_port_buf);
+    PeriodStart=jack_last_frame_time(client);
+
+    // Messages sent by the daemon to JACK
+    event_count=jack_midi_get_event_count(in_port_buf);
+    for (i=0; i<event_count; i++)
+    {
+        jack_midi_event_get(&in_event, in_port_buf, i);
+        if (in_event.size==0) continue;
+        Time=jack_frames_to_time(client, PeriodStart+in_event.time);
+
+        if ((in_event.buffer[0]==0xA0)&&(in_event.size>=3))
+        {
+            MarkReceived (STREAM_NET_NOTES, (in_event.buffer[1]<<7)|in_event.buffer[2], Time);
+        }
+        else if ((in_event.buffer[0]==0xF0)&&(in_event.size>=4)&&(in_event.buffer[1]==0x7D))
+        {
+            JACKSysExPending=(in_event.buffer[2]<<7)|in_event.buffer[3];
+        }
+        // A long SYSEX can be split in several JACK events by the daemon : latency is measured on the last one
+        if ((JACKSysExPending!=-1)&&(in_event.buffer[in_event.size-1]==0xF7))
+        {
+            MarkReceived (STREAM_NET_SYSEX, JACKSysExPending, Time);
+            JACKSysExPending=-1;
+        }
+    }
+
+    if (Running.load (std::memory_order_relaxed)==false)
+    {
+        GeneratorStarted=false;
+        return 0;
+    }
+
+    if (GeneratorStarted==false)
+    {
+        NextNoteFrame=PeriodStart;
+        NextSysExFrame=PeriodStart;
+        GeneratorStarted=true;
+    }
+
+    // Messages sent from JACK to the daemon, at their exact frame in the period
+    while (NextNoteFrame<(double)PeriodStart+nframes)
+    {
+        Offset=(NextNoteFrame>PeriodStart) ? (unsigned int)(NextNoteFrame-PeriodStart) : 0;
+        Buffer=jack_midi_event_reserve(out_port_buf, Offset, 3);
+        if (Buffer==0) break;
+        Buffer[0]=0xA1;
+        Buffer[1]=(JACKNoteSeq>>7)&0x7F;
+        Buffer[2]=JACKNoteSeq&0x7F;
+        MarkSent (STREAM_JACK_NOTES, JACKNoteSeq, jack_frames_to_time(client, PeriodStart+Offset));
+        JACKNoteSeq=(JACKNoteSeq+1)&(SEQ_RANGE-1);
+        NextNoteFrame+=(double)SampleRate/NoteRate;
+    }
+
+    while ((SysExSize>0)&&(NextSysExFrame<(double)PeriodStart+nframes))
+    {
+        Offset=(NextSysExFrame>PeriodStart) ? (unsigned int)(NextSysExFrame-PeriodStart) : 0;
+        Buffer=jack_midi_event_reserve(out_port_buf, Offset, SysExSize);
+        if (Buffer==0) break;
+        MakeSysEx (Buffer, JACKSysExSeq);
+        MarkSent (STREAM_JACK_SYSEX, JACKSysExSeq, jack_frames_to_time(client, PeriodStart+Offset));
+        JACKSysExSeq=(JACKSysExSeq+1)&(SEQ_RANGE-1);
+        NextSysExFrame+=(double)SampleRate/SysExRate;
+    }
+
+    return 0;
+}  // jack_process
+//-----------------------------------------------------------------------------
+
+bool OpenJACK (void)
+{
+    char PortName[128];
+
+    client=jack_client_open ("jackrtpmidibench", JackNullOption, NULL);
+    if (client==0)
+    {
+        fprintf (stderr, "jackrtpmidibench : JACK server not running\n");
+        return false;
+    }
+    SampleRate=jack_get_sample_rate (client);
+
+    jack_set_process_callback (client, jack_process, 0);
+    input_port=jack_port_register (client, "in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    output_port=jack_port_register (client, "out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    if ((input_port==0)||(output_port==0))
+    {
+        fprintf (stderr, "jackrtpmidibench : can not register JACK ports\n");
+        return false;
+    }
+
+    if (jack_activate (client))
+    {
+        fprintf (stderr, "jackrtpmidibench : can not activate JACK client\n");
+        return false;
+    }
+
+    snprintf (PortName, sizeof(PortName), "%s:rtpmidi_in", DaemonClient);
+    if (jack_connect (client, jack_port_name (output_port), PortName)!=0)
+    {
+        fprintf (stderr, "jackrtpmidibench : can not connect to %s\n", PortName);
+        return false;
+    }
+    snprintf (PortName, sizeof(PortName), "%s:rtpmidi_out", DaemonClient);
+    if (jack_connect (client, PortName, jack_port_name (input_port))!=0)
+    {
+        fprintf (stderr, "jackrtpmidibench : can not connect to %s\n", PortName);
+        return false;
+    }
+    return true;
+}  // OpenJACK
+//-----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+// Network side (RTP-MIDI peer)
+// ---------------------------------------------------------------------------
+
+// Current time in RTP-MIDI timestamp units
+uint64_t RTPTime (void)
+{
+    return (jack_get_time()*RTP_TIMESTAMP_RATE)/1000000;
+}  // RTPTime
+//-----------------------------------------------------------------------------
+
+void Write16 (unsigned char* Buffer, uint16_t Value)
+{
+    Buffer[0]=Value>>8;
+    Buffer[1]=Value&0xFF;
+}  // Write16
+//-----------------------------------------------------------------------------
+
+void Write32 (unsigned char* Buffer, uint32_t Value)
+{
+    Write16 (Buffer, Value>>16);
+    Write16 (&Buffer[2], Value&0xFFFF);
+}  // Write32
+//-----------------------------------------------------------------------------
+
+void Write64 (unsigned char* Buffer, uint64_t Value)
+{
+    Write32 (Buffer, (uint32_t)(Value>>32));
+    Write32 (&Buffer[4], (uint32_t)Value);
+}  // Write64
+//-----------------------------------------------------------------------------
+
+// Sends an Apple session command (IN or BY) to the daemon
+void SendSessionCommand (int Socket, struct sockaddr_in* Dest, char C1, char C2)
+{
+    unsigned char Packet[64];
+    unsigned int Size=16;
+
+    Write16 (Packet, 0xFFFF);
+    Packet[2]=C1;
+    Packet[3]=C2;
+    Write32 (&Packet[4], 2);                    // Protocol version
+    Write32 (&Packet[8], 0x12345678);           // Initiator token
+    Write32 (&Packet[12], BENCH_SSRC);
+    if (C1=='I')
+    {
+        strcpy ((char*)&Packet[16], "jackrtpmidibench");
+        Size+=strlen ("jackrtpmidibench")+1;
+    }
+    sendto (Socket, Packet, Size, 0, (struct sockaddr*)Dest, sizeof(struct sockaddr_in));
+}  // SendSessionCommand
+//-----------------------------------------------------------------------------
+
+// Sends a clock synchronization packet. Timestamps not used are sent as 0
+void SendClockSync (uint8_t Count, uint64_t TS1, uint64_t TS2, uint64_t TS3)
+{
+    unsigned char Packet[36];
+
+    Write16 (Packet, 0xFFFF);
+    Packet[2]='C';
+    Packet[3]='K';
+    Write32 (&Packet[4], BENCH_SSRC);
+    Packet[8]=Count;
+    Packet[9]=Packet[10]=Packet[11]=0;
+    Write64 (&Packet[12], TS1);
+    Write64 (&Packet[20], TS2);
+    Write64 (&Packet[28], TS3);
+    sendto (DataSocket, Packet, sizeof(Packet), 0, (struct sockaddr*)&DaemonData, sizeof(DaemonData));
+}  // SendClockSync
+//-----------------------------------------------------------------------------
+
+// Sends a MIDI command list in one RTP-MIDI packet (no journal, first command without delta-time)
+void SendRTPMIDI (unsigned char* Commands, unsigned int Length)
+{
+    unsigned char Packet[MAX_SYSEX_SIZE+32];
+    unsigned int Header;
+
+    Packet[0]=0x80;                             // RTP version 2
+    Packet[1]=0x61;                             // Payload type for RTP-MIDI
+    Write16 (&Packet[2], RTPSequence++);
+    Write32 (&Packet[4], (uint32_t)RTPTime());
+    Write32 (&Packet[8], BENCH_SSRC);
+    if (Length<16)
+    {
+        Packet[12]=Length;
+        Header=13;
+    }
+    else
+    {  // B flag : 12 bits length
+        Packet[12]=0x80|(Length>>8);
+        Packet[13]=Length&0xFF;
+        Header=14;
+    }
+    memcpy (&Packet[Header], Commands, Length);
+    sendto (DataSocket, Packet, Header+Length, 0, (struct sockaddr*)&DaemonData, sizeof(DaemonData));
+}  // SendRTPMIDI
+//-----------------------------------------------------------------------------
+
+// Number of data bytes following a status byte
+unsigned int MIDIDataLength (unsigned char Status)
+{
+    if (Status<0xF0)
+    {
+        if (((Status&0xF0)==0xC0)||((Status&0xF0)==0xD0)) return 1;
+        return 2;
+    }
+    if ((Status==0xF1)||(Status==0xF3)) return 1;
+    if (Status==0xF2) return 2;
+    return 0;
+}  // MIDIDataLength
+//-----------------------------------------------------------------------------
+
+// Decodes the MIDI command list of an RTP-MIDI packet received from the daemon
+void ProcessRTPMIDI (unsigned char* Packet, unsigned int Size, uint64_t Time)
+{
+    unsigned int Pos;
+    unsigned int End;
+    unsigned int Length;
+    bool ZFlag;
+    bool First=true;
+    unsigned char Status;
+    unsigned char RunningStatus=0;
+    unsigned int SegmentEnd;
+
+    if ((Size<13)||((Packet[0]&0xC0)!=0x80)) return;
+
+    Length=Packet[12]&0x0F;
+    Pos=13;
+    if (Packet[12]&0x80)
+    {
+        if (Size<14) return;
+        Length=(Length<<8)|Packet[13];
+        Pos=14;
+    }
+    ZFlag=(Packet[12]&0x20)!=0;
+    End=Pos+Length;
+    if (End>Size) End=Size;
+
+    while (Pos<End)
+    {
+        if ((First==false)||(ZFlag))
+        {  // Delta-time
+            while ((Pos<End)&&(Packet[Pos]&0x80)) Pos++;
+            Pos++;
+            if (Pos>=End) break;
+        }
+        First=false;
+
+        Status=Packet[Pos];
+        if ((Status==0xF0)||(Status==0xF7))
+        {  // SYSEX segment : up to F7 (end), F0 (continues in a next segment) or F4 (cancelled)
+            SegmentEnd=Pos+1;
+            while ((SegmentEnd<End)&&(Packet[SegmentEnd]!=0xF7)&&(Packet[SegmentEnd]!=0xF0)&&(Packet[SegmentEnd]!=0xF4)) SegmentEnd++;
+            if (SegmentEnd>=End) break;
+
+            if ((Status==0xF0)&&(SegmentEnd-Pos>=4)&&(Packet[Pos+1]==0x7D))
+                NetSysExPending=(Packet[Pos+2]<<7)|Packet[Pos+3];
+            if (Packet[SegmentEnd]==0xF7)
+            {
+                if (NetSysExPending!=-1) MarkReceived (STREAM_JACK_SYSEX, NetSysExPending, Time);
+                NetSysExPending=-1;
+            }
+            else if (Packet[SegmentEnd]==0xF4) NetSysExPending=-1;
+
+            RunningStatus=0;
+            Pos=SegmentEnd+1;
+            continue;
+        }
+
+        if (Status&0x80)
+        {
+            Pos++;
+            if (Status<0xF0) RunningStatus=Status;
+            else if (Status<0xF8) RunningStatus=0;
+        }
+        else
+        {
+            Status=RunningStatus;
+            if (Status==0) break;               // Invalid list
+        }
+
+        Length=MIDIDataLength (Status);
+        if (Pos+Length>End) break;
+        if ((Status==0xA1)&&(Length==2))
+            MarkReceived (STREAM_JACK_NOTES, (Packet[Pos]<<7)|Packet[Pos+1], Time);
+        Pos+=Length;
+    }
+}  // ProcessRTPMIDI
+//-----------------------------------------------------------------------------
+
+// Reads all packets waiting on a socket. Returns true if an invitation has been accepted
+bool ReadSocket (int Socket)
+{
+    unsigned char Packet[2048];
+    ssize_t Size;
+    uint64_t Time;
+    bool Accepted=false;
+
+    while ((Size=recv (Socket, Packet, sizeof(Packet), MSG_DONTWAIT))>0)
+    {
+        Time=jack_get_time();
+
+        if ((Size>=4)&&(Packet[0]==0xFF)&&(Packet[1]==0xFF))
+        {  // Apple session protocol
+            if ((Packet[2]=='O')&&(Packet[3]=='K')) Accepted=true;
+            else if ((Packet[2]=='N')&&(Packet[3]=='O'))
+                fprintf (stderr, "jackrtpmidibench : invitation rejected by the daemon\n");
+            else if ((Packet[2]=='C')&&(Packet[3]=='K')&&(Size>=36))
+            {
+                if (Packet[8]==0)
+                {  // Synchronization started by the daemon
+                    uint64_t TS1=0;
+                    for (int i=0; i<8; i++) TS1=(TS1<<8)|Packet[12+i];
+                    SendClockSync (1, TS1, RTPTime(), 0);
+                }
+                else if (Packet[8]==1)
+                {
+                    uint64_t TS1=0, TS2=0;
+                    for (int i=0; i<8; i++)
+                    {
+                        TS1=(TS1<<8)|Packet[12+i];
+                        TS2=(TS2<<8)|Packet[20+i];
+                    }
+                    SendClockSync (2, TS1, TS2, RTPTime());
+                }
+            }
+            continue;
+        }
+
+        ProcessRTPMIDI (Packet, (unsigned int)Size, Time);
+    }
+    return Accepted;
+}  // ReadSocket
+//-----------------------------------------------------------------------------
+
+// Invites the daemon on one of its ports. Returns false if the daemon does not answer
+bool Invite (int Socket, struct sockaddr_in* Dest)
+{
+    struct pollfd PollFD;
+    unsigned int Attempt;
+
+    for (Attempt=0; Attempt<10; Attempt++)
+    {
+        SendSessionCommand (Socket, Dest, 'I', 'N');
+        PollFD.fd=Socket;
+        PollFD.events=POLLIN;
+        if (poll (&PollFD, 1, 500)>0)
+        {
+            if (ReadSocket (Socket)) return true;
+        }
+    }
+    return false;
+}  // Invite
+//-----------------------------------------------------------------------------
+
+int CreateSocket (unsigned short Port)
+{
+    int Socket;
+    struct sockaddr_in Address;
+
+    Socket=socket (AF_INET, SOCK_DGRAM, 0);
+    if (Socket<0) return -1;
+
+    memset (&Address, 0, sizeof(Address));
+    Address.sin_family=AF_INET;
+    Address.sin_addr.s_addr=htonl (INADDR_LOOPBACK);
+    Address.sin_port=htons (Port);
+    if (bind (Socket, (struct sockaddr*)&Address, sizeof(Address))!=0)
+    {
+        close (Socket);
+        return -1;
+    }
+    return Socket;
+}  // CreateSocket
+//-----------------------------------------------------------------------------
+
+bool OpenSession (void)
+{
+    memset (&DaemonControl, 0, sizeof(DaemonControl));
+    DaemonControl.sin_family=AF_INET;
+    DaemonControl.sin_addr.s_addr=htonl (INADDR_LOOPBACK);
+    DaemonControl.sin_port=htons (DaemonPort);
+    DaemonData=DaemonControl;
+    DaemonData.sin_port=htons (DaemonPort+1);
+
+    // The daemon answers to the source address of the invitations, so any local port can be used
+    ControlSocket=CreateSocket (0);
+    DataSocket=CreateSocket (0);
+    if ((ControlSocket<0)||(DataSocket<0))
+    {
+        fprintf (stderr, "jackrtpmidibench : can not create sockets\n");
+        return false;
+    }
+
+    if ((Invite (ControlSocket, &DaemonControl)==false)||(Invite (DataSocket, &DaemonData)==false))
+    {
+        fprintf (stderr, "jackrtpmidibench : no answer from the daemon on port %u\n", DaemonPort);
+        return false;
+    }
+
+    SendClockSync (0, RTPTime(), 0, 0);
+    return true;
+}  // OpenSession
+//-----------------------------------------------------------------------------
+
+void CloseSession (void)
+{
+    if (ControlSocket>=0)
+    {
+        SendSessionCommand (ControlSocket, &DaemonControl, 'B', 'Y');
+        close (ControlSocket);
+    }
+    if (DataSocket>=0) close (DataSocket);
+}  // CloseSession
+//-----------------------------------------------------------------------------
+
+// Sends the network side streams and receives the daemon packets until EndTime (jack_get_time units)
+void RunNetwork (uint64_t StartTime, uint64_t StopSendTime, uint64_t EndTime)
+{
+    struct pollfd PollFD[2];
+    struct timespec Timeout;
+    uint64_t Now;
+    uint64_t Next;
+    double NextNote=StartTime;
+    double NextSysEx=StartTime;
+    double NextSync=StartTime;
+    unsigned int NoteSeq=0;
+    unsigned int SysExSeq=0;
+    unsigned char Commands[MAX_SYSEX_SIZE];
+
+    PollFD[0].fd=ControlSocket;
+    PollFD[0].events=POLLIN;
+    PollFD[1].fd=DataSocket;
+    PollFD[1].events=POLLIN;
+
+    while ((Now=jack_get_time())<EndTime)
+    {
+        if (break_request) break;
+
+        if (Now<StopSendTime)
+        {
+            while (NextNote<=Now)
+            {
+                Commands[0]=0xA0;
+                Commands[1]=(NoteSeq>>7)&0x7F;
+                Commands[2]=NoteSeq&0x7F;
+                MarkSent (STREAM_NET_NOTES, NoteSeq, jack_get_time());
+                SendRTPMIDI (Commands, 3);
+                NoteSeq=(NoteSeq+1)&(SEQ_RANGE-1);
+                NextNote+=1000000.0/NoteRate;
+            }
+            while ((SysExSize>0)&&(NextSysEx<=Now))
+            {
+                MarkSent (STREAM_NET_SYSEX, SysExSeq, jack_get_time());
+                SendRTPMIDI (Commands, MakeSysEx (Commands, SysExSeq));
+                SysExSeq=(SysExSeq+1)&(SEQ_RANGE-1);
+                NextSysEx+=1000000.0/SysExRate;
+            }
+        }
+        else
+        {
+            Running.store (false);
+        }
+
+        if (NextSync<=Now)
+        {  // Keeps the session alive
+            SendClockSync (0, RTPTime(), 0, 0);
+            NextSync+=1000000.0;
+        }
+
+        Next=EndTime;
+        if (Now<StopSendTime)
+        {
+            if ((uint64_t)NextNote<Next) Next=(uint64_t)NextNote;
+            if ((SysExSize>0)&&((uint64_t)NextSysEx<Next)) Next=(uint64_t)NextSysEx;
+        }
+        if ((uint64_t)NextSync<Next) Next=(uint64_t)NextSync;
+        Now=jack_get_time();
+        if (Next<Now) Next=Now;
+        Timeout.tv_sec=(Next-Now)/1000000;
+        Timeout.tv_nsec=((Next-Now)%1000000)*1000;
+
+        if (ppoll (PollFD, 2, &Timeout, NULL)>0)
+        {
+            if (PollFD[0].revents&POLLIN) ReadSocket (ControlSocket);
+            if (PollFD[1].revents&POLLIN) ReadSocket (DataSocket);
+        }
+    }
+    Running.store (false);
+}  // RunNetwork
+//-----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+// Report
+// ---------------------------------------------------------------------------
+
+float Percentile (float* Sorted, unsigned int Count, double Rank)
+{
+    unsigned int Index;
+
+    Index=(unsigned int)(Rank*(Count-1)+0.5);
+    return Sorted[Index];
+}  // Percentile
+//-----------------------------------------------------------------------------
+
+void PrintReport (void)
+{
+    unsigned int StreamNum;
+    TBenchStream* S;
+    uint32_t Sent;
+    double Sum, SumSquares, Mean, StdDev;
+    unsigned int i;
+
+    printf ("\n%-22s %8s %8s %7s %8s %8s %8s %8s %8s %8s %8s\n", "Stream (latency in us)", "sent", "lost", "loss%",
+            "min", "p50", "p90", "p99", "p99.9", "max", "jitter");
+
+    for (StreamNum=0; StreamNum<NUM_STREAMS; StreamNum++)
+    {
+        S=&Streams[StreamNum];
+        Sent=S->Sent.load();
+        if (Sent==0) continue;
+
+        printf ("%-22s %8u %8u %7.3f", S->Name, Sent, Sent-S->Received, 100.0*(Sent-S->Received)/Sent);
+        if (S->NumSamples==0)
+        {
+            printf ("\n");
+            continue;
+        }
+
+        std::sort (S->Samples, S->Samples+S->NumSamples);
+        Sum=0;
+        SumSquares=0;
+        for (i=0; i<S->NumSamples; i++)
+        {
+            Sum+=S->Samples[i];
+            SumSquares+=(double)S->Samples[i]*S->Samples[i];
+        }
+        Mean=Sum/S->NumSamples;
+        StdDev=sqrt (fabs (SumSquares/S->NumSamples-Mean*Mean));
+
+        // Jitter is the standard deviation of the latency
+        printf (" %8.0f %8.0f %8.0f %8.0f %8.0f %8.0f %8.1f\n", S->Samples[0],
+                Percentile (S->Samples, S->NumSamples, 0.5), Percentile (S->Samples, S->NumSamples, 0.9),
+                Percentile (S->Samples, S->NumSamples, 0.99), Percentile (S->Samples, S->NumSamples, 0.999),
+                S->Samples[S->NumSamples-1], StdDev);
+    }
+}  // PrintReport
+//-----------------------------------------------------------------------------
+
+void sig_handler (int signo)
+{
+    if (signo==SIGINT) break_request=true;
+}  // sig_handler
+//-----------------------------------------------------------------------------
+
+void print_usage (void)
+{
+    fprintf (stderr, "Usage : jackrtpmidibench [-rate messages/s] [-duration s] [-sysex bytes] [-sysexrate count/s] [-port daemon control port] [-client daemon JACK name]\n");
+}  // print_usage
+//-----------------------------------------------------------------------------
+
+int main (int argc, char** argv)
+{
+    int ArgNum;
+    unsigned int StreamNum;
+    uint64_t StartTime;
+    static const char* StreamNames[NUM_STREAMS]={"network -> JACK notes", "network -> JACK SYSEX", "JACK -> network notes", "JACK -> network SYSEX"};
+
+    for (ArgNum=1; ArgNum<argc; ArgNum++)
+    {
+        if ((strcmp (argv[ArgNum], "-rate")==0)&&(ArgNum+1<argc)) NoteRate=(unsigned int)atoi (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-duration")==0)&&(ArgNum+1<argc)) Duration=(unsigned int)atoi (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-sysex")==0)&&(ArgNum+1<argc)) SysExSize=(unsigned int)atoi (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-sysexrate")==0)&&(ArgNum+1<argc)) SysExRate=(unsigned int)atoi (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-port")==0)&&(ArgNum+1<argc)) DaemonPort=(unsigned short)atoi (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-client")==0)&&(ArgNum+1<argc)) DaemonClient=argv[++ArgNum];
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+    if ((NoteRate==0)||(Duration==0)||(SysExRate==0)||((SysExSize!=0)&&((SysExSize<5)||(SysExSize>MAX_SYSEX_SIZE))))
+    {
+        fprintf (stderr, "jackrtpmidibench : invalid parameter (SYSEX size from 5 to %u bytes)\n", MAX_SYSEX_SIZE);
+        return 1;
+    }
+
+    for (StreamNum=0; StreamNum<NUM_STREAMS; StreamNum++)
+    {
+        Streams[StreamNum].Name=StreamNames[StreamNum];
+        Streams[StreamNum].Samples=new float[MAX_SAMPLES];
+    }
+
+    signal (SIGINT, sig_handler);
+
+    if (OpenJACK()==false) return 1;
+    if (OpenSession()==false)
+    {
+        jack_client_close (client);
+        return 1;
+    }
+
+    printf ("jackrtpmidibench : %u messages/s", NoteRate);
+    if (SysExSize>0) printf (", %u SYSEX of %u bytes/s", SysExRate, SysExSize);
+    printf (" in each direction during %u s\n", Duration);
+
+    // Session is left to settle before measuring
+    StartTime=jack_get_time()+500000;
+    while (jack_get_time()<StartTime)
+    {
+        ReadSocket (ControlSocket);
+        ReadSocket (DataSocket);
+        usleep (1000);
+    }
+    Running.store (true);
+    RunNetwork (StartTime, StartTime+(uint64_t)Duration*1000000, StartTime+(uint64_t)Duration*1000000+DRAIN_MICROS);
+
+    jack_client_close (client);
+    CloseSession ();
+
+    PrintReport ();
+
+    for (StreamNum=0; StreamNum<NUM_STREAMS; StreamNum++)
+        delete[] Streams[StreamNum].Samples;
+    return 0;
+}  // main
+//-----------------------------------------------------------------------------
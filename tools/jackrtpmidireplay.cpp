@@ -0,0 +1,800 @@
+/*
+ * File:   jackrtpmidireplay.cpp
+ * Replays the datagrams of a capture file (jackrtpmidid -capture) to jackrtpmidid
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ The replay tool is at the same time :
+ - an RTP-MIDI peer on loopback, which invites each session of the daemon found in the capture
+   (Apple session protocol) and sends it the captured RTP-MIDI datagrams at their original
+   arrival times, or faster with -speed
+ - a JACK client connected to rtpmidi_out of the daemon, which records what the daemon delivers
+
+ Captured datagrams are sent unchanged, except the SSRC (the daemon sees the replay tool as its
+ peer) and the RTP timestamp, moved to the clock of the replay tool (the replay tool runs its own
+ clock synchronization, captured CK packets are not sent). Timestamp differences of the capture
+ are kept, so the sender jitter is replayed. RTP timestamps are assumed to use 10 kHz (Apple).
+ Sequence numbers are kept : packets lost in the capture are seen as lost by the daemon.
+
+ The events delivered to JACK are written to the output file (-o), one line per event with its
+ time in ms from the start of the replay and its bytes in hexadecimal. With -notimes, only the
+ bytes are written : the file is the same for each replay of a capture with the same daemon
+ build and configuration, so two builds can be compared with diff.
+ The daemon must be started with the same session configuration as when the capture was made.
+
+ Build : g++ -O2 -o jackrtpmidireplay jackrtpmidireplay.cpp -ljack -lpthread
+ Usage : see print_usage
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include "../Capture.h"
+
+#define REPLAY_SSRC             0x5245504C
+#define RTP_TIMESTAMP_RATE      10000
+#define DRAIN_MICROS            500000          // Time left to the last events after the last datagram
+#define SETTLE_MICROS           500000          // Time left to the sessions before the first datagram
+#define MIN_LOG_SIZE            (1<<20)         // Minimum size of the log of JACK events (bytes)
+
+typedef struct {
+    bool Used;                                  // Session has datagrams to replay
+    int ControlSocket;
+    int DataSocket;
+    struct sockaddr_in DaemonControl;
+    struct sockaddr_in DaemonData;
+    bool AnchorValid;                           // Timestamps of the current captured SSRC are mapped
+    uint32_t AnchorSSRC;
+    uint32_t AnchorTimestamp;                   // Captured timestamp of the first packet of the SSRC
+    uint32_t AnchorRTP;                         // Replay RTP time of this packet
+    uint64_t Datagrams;
+} TReplaySession;
+
+// Records are packed in the file, so their headers are not aligned : each header is copied in the index
+typedef struct {
+    TCaptureRecord Header;
+    unsigned char* Data;
+} TReplayRecord;
+
+// Parameters
+const char* CaptureFileName=0;
+const char* OutputFileName=0;
+const char* DaemonClient="jackrtpmidid";
+double Speed=1.0;
+int OnlySession=-1;                             // -1 : all sessions
+unsigned int BasePort=0;                        // 0 : ports stored in the capture
+bool PrintTimes=true;
+bool DumpOnly=false;
+
+// Capture loaded in memory
+unsigned char* CaptureData=0;
+TCaptureFileHeader* Header=0;
+TReplayRecord* Records=0;
+int64_t* RecordTimes=0;                         // Frame time of each record, without wrap around
+unsigned int NumRecords=0;
+unsigned int* Order=0;                          // Datagrams to replay, sorted by time
+unsigned int NumDatagrams=0;
+
+TReplaySession Sessions[CAPTURE_MAX_SESSIONS];
+
+jack_client_t* client=0;
+jack_port_t* input_port;
+bool break_request=false;
+
+// Events received from JACK (jack_process only while the client is active) : time (us), size, bytes
+unsigned char* EventLog=0;
+size_t EventLogSize=0;
+size_t EventLogPos=0;
+uint64_t EventsReceived=0;
+uint64_t EventsLost=0;
+
+// Reads the capture file and indexes its records. Returns false if the file is not a valid capture
+bool LoadCapture (const char* FileName)
+{
+    FILE* File;
+    long Size;
+    size_t Pos;
+    unsigned int Pass;
+    TCaptureRecord Record;
+    uint32_t LastFrame=0;
+    int64_t Time=0;
+
+    File=fopen (FileName, "rb");
+    if (File==0)
+    {
+        fprintf (stderr, "jackrtpmidireplay : can not open %s\n", FileName);
+        return false;
+    }
+    fseek (File, 0, SEEK_END);
+    Size=ftell (File);
+    fseek (File, 0, SEEK_SET);
+    if (Size<(long)sizeof(TCaptureFileHeader))
+    {
+        fprintf (stderr, "jackrtpmidireplay : %s is not a capture file\n", FileName);
+        fclose (File);
+        return false;
+    }
+    CaptureData=new unsigned char[Size];
+    if (fread (CaptureData, 1, Size, File)!=(size_t)Size)
+    {
+        fprintf (stderr, "jackrtpmidireplay : can not read %s\n", FileName);
+        fclose (File);
+        return false;
+    }
+    fclose (File);
+
+    Header=(TCaptureFileHeader*)CaptureData;
+    if ((Header->Magic!=CAPTURE_MAGIC)||(Header->Version!=CAPTURE_VERSION)||(Header->SampleRate==0))
+    {
+        fprintf (stderr, "jackrtpmidireplay : %s is not a capture file (or has another version)\n", FileName);
+        return false;
+    }
+
+    // First pass counts the records, second pass indexes them (a truncated last record is ignored)
+    for (Pass=0; Pass<2; Pass++)
+    {
+        Pos=sizeof(TCaptureFileHeader);
+        NumRecords=0;
+        while (Pos+sizeof(TCaptureRecord)<=(size_t)Size)
+        {
+            memcpy (&Record, &CaptureData[Pos], sizeof(TCaptureRecord));
+            if (Pos+sizeof(TCaptureRecord)+Record.Size>(size_t)Size) break;
+            if (Records)
+            {
+                // Records of different threads are close in time : frame time is unwrapped from the previous record
+                if (NumRecords==0) LastFrame=Record.FrameTime;
+                Time+=(int32_t)(Record.FrameTime-LastFrame);
+                LastFrame=Record.FrameTime;
+                Records[NumRecords].Header=Record;
+                Records[NumRecords].Data=&CaptureData[Pos+sizeof(TCaptureRecord)];
+                RecordTimes[NumRecords]=Time;
+            }
+            NumRecords++;
+            Pos+=sizeof(TCaptureRecord)+Record.Size;
+        }
+        if (Records==0)
+        {
+            Records=new TReplayRecord[NumRecords+1];
+            RecordTimes=new int64_t[NumRecords+1];
+        }
+    }
+    return true;
+}  // LoadCapture
+//-----------------------------------------------------------------------------
+
+// Prints one line : time (ms), then bytes in hexadecimal
+void PrintBytes (FILE* Output, const unsigned char* Data, unsigned int Size)
+{
+    unsigned int Pos;
+
+    for (Pos=0; Pos<Size; Pos++) fprintf (Output, " %02X", Data[Pos]);
+    fprintf (Output, "\n");
+}  // PrintBytes
+//-----------------------------------------------------------------------------
+
+// Prints all records of the capture. Sessions are numbered from 1, JACK input ports as in the routing file
+void DumpCapture (void)
+{
+    unsigned int RecordNum;
+    TCaptureRecord* Record;
+    static const char* TypeNames[4]={"?", "RX", "OUT", "IN"};
+
+    printf ("Sample rate %u, %u sessions, %u records\n", Header->SampleRate, Header->NumSessions, NumRecords);
+    for (RecordNum=0; RecordNum<Header->NumSessions; RecordNum++)
+        printf ("Session %u : control port %u\n", RecordNum+1, Header->ControlPorts[RecordNum]);
+
+    for (RecordNum=0; RecordNum<NumRecords; RecordNum++)
+    {
+        Record=&Records[RecordNum].Header;
+        printf ("%-3s %2u", TypeNames[(Record->Type<=CAPTURE_JACK_IN) ? Record->Type : 0],
+                (Record->Type==CAPTURE_JACK_IN) ? Record->Source : Record->Source+1);
+        if (PrintTimes) printf (" %12.3f", (RecordTimes[RecordNum]*1000.0)/Header->SampleRate);
+        if ((PrintTimes)&&(Record->KernelNanos!=0)) printf (" [%lld.%09lld]", (long long)(Record->KernelNanos/1000000000LL), (long long)(Record->KernelNanos%1000000000LL));
+        PrintBytes (stdout, Records[RecordNum].Data, Record->Size);
+    }
+}  // DumpCapture
+//-----------------------------------------------------------------------------
+
+bool CompareTimes (unsigned int A, unsigned int B)
+{
+    return RecordTimes[A]<RecordTimes[B];
+}  // CompareTimes
+//-----------------------------------------------------------------------------
+
+// Selects the RTP-MIDI datagrams to replay (session commands and CK packets are not replayed)
+void SelectDatagrams (void)
+{
+    unsigned int RecordNum;
+    TCaptureRecord* Record;
+    unsigned char* Packet;
+
+    Order=new unsigned int[NumRecords+1];
+    NumDatagrams=0;
+    for (RecordNum=0; RecordNum<NumRecords; RecordNum++)
+    {
+        Record=&Records[RecordNum].Header;
+        if (Record->Type!=CAPTURE_RX_DATAGRAM) continue;
+        if (Record->Source>=Header->NumSessions) continue;
+        if ((OnlySession>=0)&&(Record->Source!=OnlySession)) continue;
+        Packet=Records[RecordNum].Data;
+        if ((Record->Size<12)||((Packet[0]&0xC0)!=0x80)) continue;
+
+        Order[NumDatagrams++]=RecordNum;
+        Sessions[Record->Source].Used=true;
+    }
+    std::stable_sort (Order, Order+NumDatagrams, CompareTimes);
+}  // SelectDatagrams
+//-----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+// JACK side
+// ---------------------------------------------------------------------------
+
+int jack_process (jack_nframes_t nframes, void *arg)
+{
+    void* in_port_buf=jack_port_get_buffer(input_port, nframes);
+    jack_nframes_t PeriodStart;
+    jack_nframes_t event_count;
+    jack_midi_event_t in_event;
+    unsigned int i;
+    uint64_t Time;
+    uint32_t Size;
+
+    (void)arg;
+    PeriodStart=jack_last_frame_time(client);
+    event_count=jack_midi_get_event_count(in_port_buf);
+    for (i=0; i<event_count; i++)
+    {
+        jack_midi_event_get(&in_event, in_port_buf, i);
+        if (in_event.size==0) continue;
+        EventsReceived++;
+
+        if (EventLogPos+sizeof(Time)+sizeof(Size)+in_event.size>EventLogSize)
+        {
+            EventsLost++;
+            continue;
+        }
+        Time=jack_frames_to_time(client, PeriodStart+in_event.time);
+        Size=(uint32_t)in_event.size;
+        memcpy (&EventLog[EventLogPos], &Time, sizeof(Time));
+        memcpy (&EventLog[EventLogPos+sizeof(Time)], &Size, sizeof(Size));
+        memcpy (&EventLog[EventLogPos+sizeof(Time)+sizeof(Size)], in_event.buffer, Size);
+        EventLogPos+=sizeof(Time)+sizeof(Size)+Size;
+    }
+    return 0;
+}  // jack_process
+//-----------------------------------------------------------------------------
+
+bool OpenJACK (void)
+{
+    char PortName[128];
+
+    client=jack_client_open ("jackrtpmidireplay", JackNullOption, NULL);
+    if (client==0)
+    {
+        fprintf (stderr, "jackrtpmidireplay : JACK server not running\n");
+        return false;
+    }
+
+    jack_set_process_callback (client, jack_process, 0);
+    input_port=jack_port_register (client, "in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    if (input_port==0)
+    {
+        fprintf (stderr, "jackrtpmidireplay : can not register JACK port\n");
+        return false;
+    }
+
+    if (jack_activate (client))
+    {
+        fprintf (stderr, "jackrtpmidireplay : can not activate JACK client\n");
+        return false;
+    }
+
+    snprintf (PortName, sizeof(PortName), "%s:rtpmidi_out", DaemonClient);
+    if (jack_connect (client, PortName, jack_port_name (input_port))!=0)
+    {
+        fprintf (stderr, "jackrtpmidireplay : can not connect to %s\n", PortName);
+        return false;
+    }
+    return true;
+}  // OpenJACK
+//-----------------------------------------------------------------------------
+
+// Writes the events received from JACK (JACK client must be deactivated). Times are given from StartTime
+bool WriteOutput (const char* FileName, uint64_t StartTime)
+{
+    FILE* Output;
+    size_t Pos=0;
+    uint64_t Time;
+    uint32_t Size;
+
+    Output=fopen (FileName, "w");
+    if (Output==0)
+    {
+        fprintf (stderr, "jackrtpmidireplay : can not create %s\n", FileName);
+        return false;
+    }
+
+    while (Pos<EventLogPos)
+    {
+        memcpy (&Time, &EventLog[Pos], sizeof(Time));
+        memcpy (&Size, &EventLog[Pos+sizeof(Time)], sizeof(Size));
+        if (PrintTimes) fprintf (Output, "%12.3f", (Time>StartTime) ? (Time-StartTime)/1000.0 : 0.0);
+        PrintBytes (Output, &EventLog[Pos+sizeof(Time)+sizeof(Size)], Size);
+        Pos+=sizeof(Time)+sizeof(Size)+Size;
+    }
+    fclose (Output);
+    return true;
+}  // WriteOutput
+//-----------------------------------------------------------------------------
+
+// ---------------------------------------------------------------------------
+// Network side (RTP-MIDI peer)
+// ---------------------------------------------------------------------------
+
+// RTP-MIDI time of a jack_get_time() time
+uint32_t RTPTime (uint64_t Time)
+{
+    return (uint32_t)((Time*RTP_TIMESTAMP_RATE)/1000000);
+}  // RTPTime
+//-----------------------------------------------------------------------------
+
+void Write16 (unsigned char* Buffer, uint16_t Value)
+{
+    Buffer[0]=Value>>8;
+    Buffer[1]=Value&0xFF;
+}  // Write16
+//-----------------------------------------------------------------------------
+
+void Write32 (unsigned char* Buffer, uint32_t Value)
+{
+    Write16 (Buffer, Value>>16);
+    Write16 (&Buffer[2], Value&0xFFFF);
+}  // Write32
+//-----------------------------------------------------------------------------
+
+void Write64 (unsigned char* Buffer, uint64_t Value)
+{
+    Write32 (Buffer, (uint32_t)(Value>>32));
+    Write32 (&Buffer[4], (uint32_t)Value);
+}  // Write64
+//-----------------------------------------------------------------------------
+
+uint32_t Read32 (const unsigned char* Buffer)
+{
+    return ((uint32_t)Buffer[0]<<24)|((uint32_t)Buffer[1]<<16)|((uint32_t)Buffer[2]<<8)|Buffer[3];
+}  // Read32
+//-----------------------------------------------------------------------------
+
+uint64_t Read64 (const unsigned char* Buffer)
+{
+    return ((uint64_t)Read32 (Buffer)<<32)|Read32 (&Buffer[4]);
+}  // Read64
+//-----------------------------------------------------------------------------
+
+// Sends an Apple session command (IN or BY) to the daemon
+void SendSessionCommand (int Socket, struct sockaddr_in* Dest, char C1, char C2)
+{
+    unsigned char Packet[64];
+    unsigned int Size=16;
+
+    Write16 (Packet, 0xFFFF);
+    Packet[2]=C1;
+    Packet[3]=C2;
+    Write32 (&Packet[4], 2);                    // Protocol version
+    Write32 (&Packet[8], 0x12345678);           // Initiator token
+    Write32 (&Packet[12], REPLAY_SSRC);
+    if (C1=='I')
+    {
+        strcpy ((char*)&Packet[16], "jackrtpmidireplay");
+        Size+=strlen ("jackrtpmidireplay")+1;
+    }
+    sendto (Socket, Packet, Size, 0, (struct sockaddr*)Dest, sizeof(struct sockaddr_in));
+}  // SendSessionCommand
+//-----------------------------------------------------------------------------
+
+// Sends a clock synchronization packet to a session. Timestamps not used are sent as 0
+void SendClockSync (TReplaySession* Session, uint8_t Count, uint64_t TS1, uint64_t TS2, uint64_t TS3)
+{
+    unsigned char Packet[36];
+
+    Write16 (Packet, 0xFFFF);
+    Packet[2]='C';
+    Packet[3]='K';
+    Write32 (&Packet[4], REPLAY_SSRC);
+    Packet[8]=Count;
+    Packet[9]=Packet[10]=Packet[11]=0;
+    Write64 (&Packet[12], TS1);
+    Write64 (&Packet[20], TS2);
+    Write64 (&Packet[28], TS3);
+    sendto (Session->DataSocket, Packet, sizeof(Packet), 0, (struct sockaddr*)&Session->DaemonData, sizeof(Session->DaemonData));
+}  // SendClockSync
+//-----------------------------------------------------------------------------
+
+// Reads all packets waiting on a socket of a session (MIDI sent by the daemon is ignored)
+// Returns true if an invitation has been accepted
+bool ReadSocket (TReplaySession* Session, int Socket)
+{
+    unsigned char Packet[2048];
+    ssize_t Size;
+    bool Accepted=false;
+
+    while ((Size=recv (Socket, Packet, sizeof(Packet), MSG_DONTWAIT))>0)
+    {
+        if ((Size<4)||(Packet[0]!=0xFF)||(Packet[1]!=0xFF)) continue;
+
+        if ((Packet[2]=='O')&&(Packet[3]=='K')) Accepted=true;
+        else if ((Packet[2]=='N')&&(Packet[3]=='O'))
+            fprintf (stderr, "jackrtpmidireplay : invitation rejected by the daemon\n");
+        else if ((Packet[2]=='C')&&(Packet[3]=='K')&&(Size>=36))
+        {  // Synchronization started by the daemon
+            if (Packet[8]==0) SendClockSync (Session, 1, Read64 (&Packet[12]), RTPTime (jack_get_time()), 0);
+            else if (Packet[8]==1) SendClockSync (Session, 2, Read64 (&Packet[12]), Read64 (&Packet[20]), RTPTime (jack_get_time()));
+        }
+    }
+    return Accepted;
+}  // ReadSocket
+//-----------------------------------------------------------------------------
+
+// Invites the daemon on one of its ports. Returns false if the daemon does not answer
+bool Invite (TReplaySession* Session, int Socket, struct sockaddr_in* Dest)
+{
+    struct pollfd PollFD;
+    unsigned int Attempt;
+
+    for (Attempt=0; Attempt<10; Attempt++)
+    {
+        SendSessionCommand (Socket, Dest, 'I', 'N');
+        PollFD.fd=Socket;
+        PollFD.events=POLLIN;
+        if (poll (&PollFD, 1, 500)>0)
+        {
+            if (ReadSocket (Session, Socket)) return true;
+        }
+    }
+    return false;
+}  // Invite
+//-----------------------------------------------------------------------------
+
+int CreateSocket (void)
+{
+    int Socket;
+    struct sockaddr_in Address;
+
+    Socket=socket (AF_INET, SOCK_DGRAM, 0);
+    if (Socket<0) return -1;
+
+    // The daemon answers to the source address of the invitations, so any local port can be used
+    memset (&Address, 0, sizeof(Address));
+    Address.sin_family=AF_INET;
+    Address.sin_addr.s_addr=htonl (INADDR_LOOPBACK);
+    Address.sin_port=0;
+    if (bind (Socket, (struct sockaddr*)&Address, sizeof(Address))!=0)
+    {
+        close (Socket);
+        return -1;
+    }
+    return Socket;
+}  // CreateSocket
+//-----------------------------------------------------------------------------
+
+// Invites all sessions which have datagrams to replay
+bool OpenSessions (void)
+{
+    unsigned int SessionNum;
+    unsigned short Port;
+    TReplaySession* Session;
+
+    for (SessionNum=0; SessionNum<Header->NumSessions; SessionNum++)
+    {
+        Session=&Sessions[SessionNum];
+        if (Session->Used==false) continue;
+
+        Port=(BasePort!=0) ? (unsigned short)(BasePort+2*SessionNum) : Header->ControlPorts[SessionNum];
+        memset (&Session->DaemonControl, 0, sizeof(Session->DaemonControl));
+        Session->DaemonControl.sin_family=AF_INET;
+        Session->DaemonControl.sin_addr.s_addr=htonl (INADDR_LOOPBACK);
+        Session->DaemonControl.sin_port=htons (Port);
+        Session->DaemonData=Session->DaemonControl;
+        Session->DaemonData.sin_port=htons (Port+1);
+
+        Session->ControlSocket=CreateSocket ();
+        Session->DataSocket=CreateSocket ();
+        if ((Session->ControlSocket<0)||(Session->DataSocket<0))
+        {
+            fprintf (stderr, "jackrtpmidireplay : can not create sockets\n");
+            return false;
+        }
+
+        if ((Invite (Session, Session->ControlSocket, &Session->DaemonControl)==false)||
+            (Invite (Session, Session->DataSocket, &Session->DaemonData)==false))
+        {
+            fprintf (stderr, "jackrtpmidireplay : no answer from the daemon on port %u (session %u)\n", Port, SessionNum+1);
+            return false;
+        }
+        SendClockSync (Session, 0, RTPTime (jack_get_time()), 0, 0);
+    }
+    return true;
+}  // OpenSessions
+//-----------------------------------------------------------------------------
+
+void CloseSessions (void)
+{
+    unsigned int SessionNum;
+    TReplaySession* Session;
+
+    for (SessionNum=0; SessionNum<CAPTURE_MAX_SESSIONS; SessionNum++)
+    {
+        Session=&Sessions[SessionNum];
+        if (Session->ControlSocket>=0)
+        {
+            SendSessionCommand (Session->ControlSocket, &Session->DaemonControl, 'B', 'Y');
+            close (Session->ControlSocket);
+            Session->ControlSocket=-1;
+        }
+        if (Session->DataSocket>=0)
+        {
+            close (Session->DataSocket);
+            Session->DataSocket=-1;
+        }
+    }
+}  // CloseSessions
+//-----------------------------------------------------------------------------
+
+// Sends a captured datagram. SSRC is replaced and the timestamp is moved to the replay clock
+void SendDatagram (TReplayRecord* Record, uint64_t SendTime)
+{
+    TReplaySession* Session=&Sessions[Record->Header.Source];
+    unsigned char* Packet=Record->Data;
+    uint32_t SSRC;
+    uint32_t Timestamp;
+    int32_t Elapsed;
+
+    SSRC=Read32 (&Packet[8]);
+    Timestamp=Read32 (&Packet[4]);
+    if ((Session->AnchorValid==false)||(SSRC!=Session->AnchorSSRC))
+    {  // New sender in the capture : its first packet gives the origin of its timestamps
+        Session->AnchorValid=true;
+        Session->AnchorSSRC=SSRC;
+        Session->AnchorTimestamp=Timestamp;
+        Session->AnchorRTP=RTPTime (SendTime);
+    }
+    Elapsed=(int32_t)(Timestamp-Session->AnchorTimestamp);
+    Write32 (&Packet[4], Session->AnchorRTP+(uint32_t)(int32_t)(Elapsed/Speed));
+    Write32 (&Packet[8], REPLAY_SSRC);
+
+    sendto (Session->DataSocket, Packet, Record->Header.Size, 0, (struct sockaddr*)&Session->DaemonData, sizeof(Session->DaemonData));
+    Session->Datagrams++;
+}  // SendDatagram
+//-----------------------------------------------------------------------------
+
+// Sends the datagrams at their captured time (divided by Speed) from StartTime, and answers the daemon until the end
+void RunReplay (uint64_t StartTime)
+{
+    struct pollfd PollFD[2*CAPTURE_MAX_SESSIONS];
+    TReplaySession* PollSession[2*CAPTURE_MAX_SESSIONS];
+    unsigned int NumFD=0;
+    unsigned int SessionNum;
+    unsigned int FDNum;
+    unsigned int Next=0;
+    struct timespec Timeout;
+    uint64_t Now;
+    uint64_t Wake;
+    uint64_t DueTime=StartTime;
+    uint64_t EndTime=0;
+    double NextSync=StartTime;
+    int64_t FirstTime;
+
+    for (SessionNum=0; SessionNum<CAPTURE_MAX_SESSIONS; SessionNum++)
+    {
+        if (Sessions[SessionNum].Used==false) continue;
+        PollFD[NumFD].fd=Sessions[SessionNum].ControlSocket;
+        PollFD[NumFD].events=POLLIN;
+        PollSession[NumFD++]=&Sessions[SessionNum];
+        PollFD[NumFD].fd=Sessions[SessionNum].DataSocket;
+        PollFD[NumFD].events=POLLIN;
+        PollSession[NumFD++]=&Sessions[SessionNum];
+    }
+
+    FirstTime=RecordTimes[Order[0]];
+    while (true)
+    {
+        Now=jack_get_time();
+        if (break_request) break;
+
+        while (Next<NumDatagrams)
+        {
+            DueTime=StartTime+(uint64_t)(((RecordTimes[Order[Next]]-FirstTime)*1000000.0)/(Header->SampleRate*Speed));
+            if (DueTime>Now) break;
+            SendDatagram (&Records[Order[Next]], DueTime);
+            Next++;
+        }
+        if ((Next==NumDatagrams)&&(EndTime==0)) EndTime=Now+DRAIN_MICROS;
+        if ((EndTime!=0)&&(Now>=EndTime)) break;
+
+        if (NextSync<=Now)
+        {  // Keeps the sessions alive
+            for (SessionNum=0; SessionNum<CAPTURE_MAX_SESSIONS; SessionNum++)
+            {
+                if (Sessions[SessionNum].Used) SendClockSync (&Sessions[SessionNum], 0, RTPTime (Now), 0, 0);
+            }
+            NextSync+=1000000.0;
+        }
+
+        Wake=(EndTime!=0) ? EndTime : DueTime;
+        if ((uint64_t)NextSync<Wake) Wake=(uint64_t)NextSync;
+        Now=jack_get_time();
+        if (Wake<Now) Wake=Now;
+        Timeout.tv_sec=(Wake-Now)/1000000;
+        Timeout.tv_nsec=((Wake-Now)%1000000)*1000;
+
+        if (ppoll (PollFD, NumFD, &Timeout, NULL)>0)
+        {
+            for (FDNum=0; FDNum<NumFD; FDNum++)
+            {
+                if (PollFD[FDNum].revents&POLLIN) ReadSocket (PollSession[FDNum], PollFD[FDNum].fd);
+            }
+        }
+    }
+}  // RunReplay
+//-----------------------------------------------------------------------------
+
+void sig_handler (int signo)
+{
+    if (signo==SIGINT) break_request=true;
+}  // sig_handler
+//-----------------------------------------------------------------------------
+
+void print_usage (void)
+{
+    fprintf (stderr, "Usage : jackrtpmidireplay capture_file [-speed factor] [-session number] [-baseport port] [-o output_file] [-notimes] [-client daemon JACK name]\n");
+    fprintf (stderr, "        jackrtpmidireplay capture_file -dump [-notimes]\n");
+}  // print_usage
+//-----------------------------------------------------------------------------
+
+int main (int argc, char** argv)
+{
+    int ArgNum;
+    unsigned int SessionNum;
+    uint64_t StartTime;
+    uint64_t ReplayTime;
+    uint64_t Bytes=0;
+    unsigned int DatagramNum;
+    double CaptureSeconds;
+
+    for (ArgNum=1; ArgNum<argc; ArgNum++)
+    {
+        if ((strcmp (argv[ArgNum], "-speed")==0)&&(ArgNum+1<argc)) Speed=atof (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-session")==0)&&(ArgNum+1<argc)) OnlySession=atoi (argv[++ArgNum])-1;
+        else if ((strcmp (argv[ArgNum], "-baseport")==0)&&(ArgNum+1<argc)) BasePort=(unsigned int)atoi (argv[++ArgNum]);
+        else if ((strcmp (argv[ArgNum], "-o")==0)&&(ArgNum+1<argc)) OutputFileName=argv[++ArgNum];
+        else if ((strcmp (argv[ArgNum], "-client")==0)&&(ArgNum+1<argc)) DaemonClient=argv[++ArgNum];
+        else if (strcmp (argv[ArgNum], "-notimes")==0) PrintTimes=false;
+        else if (strcmp (argv[ArgNum], "-dump")==0) DumpOnly=true;
+        else if ((argv[ArgNum][0]!='-')&&(CaptureFileName==0)) CaptureFileName=argv[ArgNum];
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+    if ((CaptureFileName==0)||(Speed<=0)||(BasePort>65534))
+    {
+        print_usage();
+        return 1;
+    }
+
+    for (SessionNum=0; SessionNum<CAPTURE_MAX_SESSIONS; SessionNum++)
+    {
+        memset (&Sessions[SessionNum], 0, sizeof(TReplaySession));
+        Sessions[SessionNum].ControlSocket=-1;
+        Sessions[SessionNum].DataSocket=-1;
+    }
+
+    if (LoadCapture (CaptureFileName)==false) return 1;
+    if (DumpOnly)
+    {
+        DumpCapture();
+        return 0;
+    }
+
+    SelectDatagrams();
+    if (NumDatagrams==0)
+    {
+        fprintf (stderr, "jackrtpmidireplay : no RTP-MIDI datagram to replay in %s\n", CaptureFileName);
+        return 1;
+    }
+
+    // Daemon can not deliver more bytes than received : twice the captured size leaves room for the event headers
+    for (DatagramNum=0; DatagramNum<NumDatagrams; DatagramNum++) Bytes+=Records[Order[DatagramNum]].Header.Size;
+    EventLogSize=(size_t)(2*Bytes);
+    if (EventLogSize<MIN_LOG_SIZE) EventLogSize=MIN_LOG_SIZE;
+    EventLog=new unsigned char[EventLogSize];
+
+    signal (SIGINT, sig_handler);
+
+    if (OpenJACK()==false) return 1;
+    if (OpenSessions()==false)
+    {
+        CloseSessions();
+        jack_client_close (client);
+        return 1;
+    }
+
+    CaptureSeconds=(RecordTimes[Order[NumDatagrams-1]]-RecordTimes[Order[0]])/(double)Header->SampleRate;
+    printf ("jackrtpmidireplay : %u datagrams (%llu bytes) captured during %.3f s, replayed at speed %g\n",
+            NumDatagrams, (unsigned long long)Bytes, CaptureSeconds, Speed);
+
+    // Sessions are left to settle before the first datagram
+    StartTime=jack_get_time()+SETTLE_MICROS;
+    while (jack_get_time()<StartTime)
+    {
+        for (SessionNum=0; SessionNum<CAPTURE_MAX_SESSIONS; SessionNum++)
+        {
+            if (Sessions[SessionNum].Used==false) continue;
+            ReadSocket (&Sessions[SessionNum], Sessions[SessionNum].ControlSocket);
+            ReadSocket (&Sessions[SessionNum], Sessions[SessionNum].DataSocket);
+        }
+        usleep (1000);
+    }
+    RunReplay (StartTime);
+    ReplayTime=jack_get_time()-StartTime;
+
+    // Event log is read once the JACK thread is stopped
+    jack_deactivate (client);
+    CloseSessions ();
+
+    for (SessionNum=0; SessionNum<CAPTURE_MAX_SESSIONS; SessionNum++)
+    {
+        if (Sessions[SessionNum].Used) printf ("Session %u : %llu datagrams sent\n", SessionNum+1, (unsigned long long)Sessions[SessionNum].Datagrams);
+    }
+    printf ("%llu events received from the daemon in %.3f s (%.0f events/s)", (unsigned long long)EventsReceived,
+            ReplayTime/1000000.0, ReplayTime>0 ? EventsReceived*1000000.0/ReplayTime : 0.0);
+    if (EventsLost>0) printf (", %llu not logged", (unsigned long long)EventsLost);
+    printf ("\n");
+
+    if (OutputFileName) WriteOutput (OutputFileName, StartTime);
+    jack_client_close (client);
+
+    delete[] EventLog;
+    delete[] Order;
+    delete[] RecordTimes;
+    delete[] Records;
+    delete[] CaptureData;
+    return 0;
+}  // main
+//-----------------------------------------------------------------------------
@@ -0,0 +1,168 @@
+/*
+ * File:   jackrtpmidistat.cpp
+ * Prints the counters published by jackrtpmidid
+ * Author: Benoit BOUCHEZ (BEB)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019-2024 bbouchez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ Build : g++ -O2 -o jackrtpmidistat jackrtpmidistat.cpp -lrt
+ Usage : jackrtpmidistat [-i seconds]   (-i : print again every n seconds)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../Statistics.h"
+
+static uint64_t Get (std::atomic<uint64_t>& Counter)
+{
+    return Counter.load (std::memory_order_relaxed);
+}  // Get
+//-----------------------------------------------------------------------------
+
+static void PrintTraffic (const char* Title, TTrafficCounters* Counters)
+{
+    printf ("  %-14s messages %-10llu bytes %-12llu drops %-8llu SYSEX rejected %-6llu filtered %llu\n", Title,
+            (unsigned long long)Get (Counters->Messages), (unsigned long long)Get (Counters->Bytes),
+            (unsigned long long)Get (Counters->Drops), (unsigned long long)Get (Counters->SysExRejects),
+            (unsigned long long)Get (Counters->Filtered));
+}  // PrintTraffic
+//-----------------------------------------------------------------------------
+
+static void PrintHistogram (std::atomic<uint64_t>* Buckets)
+{
+    unsigned int Bucket;
+    char Label[32];
+
+    for (Bucket=0; Bucket<STATS_LATENCY_BUCKETS; Bucket++)
+    {
+        if (Bucket==STATS_LATENCY_BUCKETS-1) snprintf (Label, sizeof(Label), ">= %u us", 1u<<(Bucket-1));
+        else snprintf (Label, sizeof(Label), "< %u us", 1u<<Bucket);
+        printf ("  %-14s %llu\n", Label, (unsigned long long)Get (Buckets[Bucket]));
+    }
+}  // PrintHistogram
+//-----------------------------------------------------------------------------
+
+static void PrintStats (TStatsBlock* Block)
+{
+    unsigned int Session;
+    TSessionStats* SessionStats;
+
+    printf ("JACK xruns : %llu\n", (unsigned long long)Get (Block->Xruns));
+    printf ("Realtime threads : %llu allocations, %llu page faults in RTP-MIDI thread\n",
+            (unsigned long long)Get (Block->RTAllocations), (unsigned long long)Get (Block->RTPageFaults));
+    if (Get (Block->RTAuditViolations)!=0)
+        printf ("Realtime audit : %llu forbidden calls in realtime threads\n", (unsigned long long)Get (Block->RTAuditViolations));
+    printf ("Queue RTP-MIDI -> JACK : max fill %u / %u bytes\n", Block->MaxFillToJACK.load (std::memory_order_relaxed), Block->QueueSize);
+    printf ("Queue JACK -> RTP-MIDI : max fill %u / %u bytes\n", Block->MaxFillToNetwork.load (std::memory_order_relaxed), Block->QueueSize);
+    PrintTraffic ("from JACK", &Block->FromJACK);
+
+    for (Session=0; (Session<Block->NumSessions)&&(Session<STATS_MAX_SESSIONS); Session++)
+    {
+        SessionStats=&Block->Sessions[Session];
+        printf ("Session %u : %s%s\n", Session+1, SessionStats->Name, SessionStats->Opened.load (std::memory_order_relaxed) ? "" : " (not opened)");
+        PrintTraffic ("from network", &SessionStats->FromNetwork);
+        PrintTraffic ("to network", &SessionStats->ToNetwork);
+        printf ("  %-14s packets sent %llu, packets lost %llu, commands recovered from journal %llu\n", "",
+                (unsigned long long)Get (SessionStats->PacketsSent), (unsigned long long)Get (SessionStats->PacketsLost),
+                (unsigned long long)Get (SessionStats->JournalRepairs));
+        if (Get (SessionStats->ParserDiscards)!=0)
+            printf ("  %-14s %llu bytes discarded (incomplete or invalid MIDI messages)\n", "", (unsigned long long)Get (SessionStats->ParserDiscards));
+        if (SessionStats->JitterDelayMicros.load (std::memory_order_relaxed)!=0)
+            printf ("  %-14s jitter buffer delay %u us\n", "", SessionStats->JitterDelayMicros.load (std::memory_order_relaxed));
+        if (SessionStats->ClockExchanges.load (std::memory_order_relaxed)!=0)
+            printf ("  %-14s clock sync : %u exchanges (%u rejected), error %u us, drift %d ppb, round trip %u us\n", "",
+                    SessionStats->ClockExchanges.load (std::memory_order_relaxed), SessionStats->ClockRejected.load (std::memory_order_relaxed),
+                    SessionStats->ClockErrorMicros.load (std::memory_order_relaxed), SessionStats->ClockDriftPPB.load (std::memory_order_relaxed),
+                    SessionStats->ClockRoundTripMicros.load (std::memory_order_relaxed));
+    }
+
+    printf ("Realtime thread wake up latency :\n");
+    PrintHistogram (&Block->WakeLatency[0]);
+
+    if (Block->TXDeadlineMicros>=0)
+        printf ("JACK to network latency (JACK period %u us, send deadline %d us) :\n", Block->JACKPeriodMicros.load (std::memory_order_relaxed), Block->TXDeadlineMicros);
+    else
+        printf ("JACK to network latency (JACK period %u us, sent after each period) :\n", Block->JACKPeriodMicros.load (std::memory_order_relaxed));
+    printf ("  %-14s %u us, %llu sent more than one period after deadline\n", "max", Block->MaxTXLatencyMicros.load (std::memory_order_relaxed),
+            (unsigned long long)Get (Block->TXLate));
+    PrintHistogram (&Block->TXLatency[0]);
+}  // PrintStats
+//-----------------------------------------------------------------------------
+
+int main (int argc, char** argv)
+{
+    int ShmFD;
+    void* Memory;
+    TStatsBlock* Block;
+    unsigned int Interval=0;
+
+    if ((argc==3)&&(strcmp (argv[1], "-i")==0)) Interval=(unsigned int)atoi (argv[2]);
+    else if (argc!=1)
+    {
+        fprintf (stderr, "Usage : jackrtpmidistat [-i seconds]\n");
+        return 1;
+    }
+
+    ShmFD=shm_open (STATS_SHM_NAME, O_RDONLY, 0);
+    if (ShmFD==-1)
+    {
+        fprintf (stderr, "jackrtpmidistat : jackrtpmidid is not running\n");
+        return 1;
+    }
+
+    Memory=mmap (0, sizeof(TStatsBlock), PROT_READ, MAP_SHARED, ShmFD, 0);
+    close (ShmFD);
+    if (Memory==MAP_FAILED)
+    {
+        fprintf (stderr, "jackrtpmidistat : can not map statistics\n");
+        return 1;
+    }
+    Block=(TStatsBlock*)Memory;
+
+    if ((Block->Magic!=STATS_MAGIC)||(Block->Version!=STATS_VERSION))
+    {
+        fprintf (stderr, "jackrtpmidistat : statistics version not supported\n");
+        munmap (Memory, sizeof(TStatsBlock));
+        return 1;
+    }
+
+    while (1)
+    {
+        PrintStats (Block);
+        if (Interval==0) break;
+        sleep (Interval);
+        printf ("\n");
+    }
+
+    munmap (Memory, sizeof(TStatsBlock));
+    return 0;
+}  // main
+//-----------------------------------------------------------------------------